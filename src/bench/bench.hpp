@@ -0,0 +1,52 @@
+#pragma once
+
+namespace nbte {
+
+// Runs each benchmark a fixed number of times and prints the median, so that runs on the same machine compare.
+class Bench {
+public:
+  Bench(int iterations, String const &only) : fIterations(std::max(iterations, 1)), fOnly(only) {}
+
+  bool enabled(String const &name) const {
+    return fOnly.empty() || name.find(fOnly) != String::npos;
+  }
+
+  // bytes and items are processed by each run of body, and reported per second. setup runs before each run, untimed.
+  void run(String const &name, uint64_t bytes, uint64_t items, char const *unit, std::function<void()> const &body, std::function<void()> const &setup = nullptr) {
+    using namespace std;
+    if (!enabled(name)) {
+      return;
+    }
+    vector<double> seconds;
+    for (int i = 0; i < fIterations; i++) {
+      if (setup) {
+        setup();
+      }
+      auto start = chrono::steady_clock::now();
+      body();
+      auto elapsed = chrono::steady_clock::now() - start;
+      seconds.push_back(chrono::duration<double>(elapsed).count());
+    }
+    sort(seconds.begin(), seconds.end());
+    double median = seconds[seconds.size() / 2];
+    double best = seconds.front();
+    printf("%-36s %10.3f ms %10.3f ms", (char const *)name.c_str(), median * 1000, best * 1000);
+    if (bytes > 0) {
+      printf(" %10.1f MB/s", bytes / median / (1024 * 1024));
+    } else {
+      printf(" %15s", "");
+    }
+    printf(" %14.0f %s/s\n", items / median, unit);
+    fflush(stdout);
+  }
+
+  static void PrintHeader() {
+    printf("%-36s %13s %13s %15s %s\n", "benchmark", "median", "best", "throughput", "rate");
+  }
+
+private:
+  int const fIterations;
+  String const fOnly;
+};
+
+} // namespace nbte
@@ -0,0 +1,271 @@
+#pragma once
+
+namespace nbte {
+
+static void PrintBenchError(String const &s) {
+  fprintf(stderr, "nbte-bench: %s\n", (char const *)s.c_str());
+}
+
+// Worlds of the benchmarks, with a small vocabulary of uniformly drawn names so that chunks deflate about as well as
+// real ones.
+static WorldGenerator BenchWorld(uint32_t seed, size_t chunks) {
+  WorldGenerator::Options options;
+  options.fSeed = seed;
+  options.fChunksPerRegion = chunks;
+  options.fVocabulary = 8;
+  options.fSkew = 1;
+  return WorldGenerator(options);
+}
+
+// Fills dir with empty directories, and empty files named like region files.
+static bool WriteEmptyFiles(Path const &dir, size_t files, size_t directories) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  for (size_t i = 0; i < directories; i++) {
+    if (!fs::create_directories(dir / (u8"dir" + ToString(i)), ec)) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < files; i++) {
+    FILE *fp = OpenFileStream(dir / (u8"r." + ToString(i % 100) + u8"." + ToString(i / 100) + u8".mca"), u8"wb");
+    if (!fp) {
+      return false;
+    }
+    fclose(fp);
+  }
+  return true;
+}
+
+// Throughput is of the decoded NBT. Formats are tried in the order ReadCompound tries them, so the later ones pay for the
+// failed attempts before them.
+static void BenchReadCompound(Bench &bench, Path const &dir, TaskQueue &pool) {
+  using namespace std;
+  // A large standalone file, like level.dat of a server with many players.
+  WorldGenerator::Options options;
+  options.fPlayers = 2000;
+  options.fItems = 36;
+  options.fVocabulary = 8;
+  options.fSkew = 1;
+  auto tag = WorldGenerator(options).level();
+  vector<uint8_t> raw;
+  mcfile::nbt::CompoundTag::Write(*tag, raw, mcfile::Endian::Big);
+  for (auto format : WorldGenerator::AllFormats()) {
+    String name = String(u8"ReadCompound/") + WorldGenerator::FormatName(format);
+    if (!bench.enabled(name)) {
+      continue;
+    }
+    Path file = dir / (String(WorldGenerator::FormatName(format)) + u8".dat");
+    if (auto err = Compound::Write(*tag, format, file, SaveProfile::Balanced, &pool); !err.empty()) {
+      PrintBenchError(name + u8": " + err);
+      continue;
+    }
+    bench.run(name, raw.size(), 1, "files", [&file]() {
+      Compound::Format read;
+      ReadCompound(file, &read);
+    });
+  }
+}
+
+static void BenchReadRegion(Bench &bench, Path const &dir, TaskQueue &pool) {
+  using namespace std;
+  for (auto [name, count] : {pair<String, size_t>{u8"ReadRegion/sparse", 64}, pair<String, size_t>{u8"ReadRegion/dense", 1024}}) {
+    if (!bench.enabled(name)) {
+      continue;
+    }
+    Path file = dir / (count == 1024 ? u8"r.0.0.mca" : u8"r.1.0.mca");
+    int rx = count == 1024 ? 0 : 1;
+    if (!BenchWorld(2, count).writeRegion(file, rx, 0, false)) {
+      PrintBenchError(name + u8": Can't write the fixture");
+      continue;
+    }
+    error_code ec;
+    uint64_t size = filesystem::file_size(file, ec);
+    auto owner = Node::FileUnopened(file, nullptr);
+    bench.run(name, size, count, "chunks", [&pool, &file, &owner, rx]() {
+      // Run by a worker, so that decoding spreads over the pool as it does in the editor.
+      pool.enqueue("ReadRegion", TaskPriority::High, [&pool, &file, &owner, rx]() { return ReadRegion(&pool, CancellationToken(), rx, 0, file, owner); }).fFuture.get();
+    });
+  }
+}
+
+// The region is written through SaveSnapshot as the editor saves it: dirty chunks are deflated again, the others copied.
+static void BenchSave(Bench &bench, Path const &dir, Session &session) {
+  using namespace std;
+  if (!bench.enabled(u8"Save/1-dirty") && !bench.enabled(u8"Save/all-dirty")) {
+    return;
+  }
+  Path file = dir / u8"r.0.0.mca";
+  if (!BenchWorld(3, 1024).writeRegion(file, 0, 0, false) || !session.open(file).empty()) {
+    PrintBenchError(u8"Save: Can't write the fixture");
+    return;
+  }
+  auto const &root = session.root();
+  session.wait(root);
+  auto const &chunks = get<0>(root->region()->fValue);
+  for (auto [name, dirty] : {pair<String, size_t>{u8"Save/1-dirty", 1}, pair<String, size_t>{u8"Save/all-dirty", chunks.size()}}) {
+    error_code ec;
+    uint64_t size = filesystem::file_size(file, ec);
+    bench.run(name, size, dirty, "dirty chunks", [&session, &root]() {
+      if (auto err = session.save(root, SaveProfile::Balanced); !err.empty()) {
+        PrintBenchError(err);
+      }
+    }, [&chunks, dirty]() {
+      for (size_t i = 0; i < dirty; i++) {
+        if (auto c = chunks[i] ? chunks[i]->compound() : nullptr; c) {
+          c->markEdited();
+        }
+      }
+    });
+  }
+}
+
+// Asks the cache about every compound and list of every chunk, as rendering a fully expanded region does. The term
+// matches nothing, so the cold runs visit every tag.
+template <FilterMode Mode>
+static void VisitFilterCache(Cache<Mode> &cache, std::vector<std::shared_ptr<Node>> const &chunks, FilterKey const &key) {
+  using Type = Tape::Type;
+  for (auto const &chunk : chunks) {
+    auto c = chunk ? chunk->compound() : nullptr;
+    if (!c || !c->fTape) {
+      continue;
+    }
+    Tape const &tape = *c->fTape;
+    for (uint32_t i = 0; i < tape.entries(); i++) {
+      if (Type type = tape.type(i); type == Type::Compound || type == Type::List) {
+        cache.containsSearchTerm(TapeEntry{&tape, i}, key);
+      }
+    }
+  }
+}
+
+template <FilterMode Mode>
+static void BenchFilterCache(Bench &bench, String const &name, std::vector<std::shared_ptr<Node>> const &chunks, uint64_t bytes) {
+  FilterKey key(u8"nbte-bench-absent", false);
+  bench.run(name + u8"-cold", bytes, chunks.size(), "chunks", [&chunks, &key]() {
+    Cache<Mode> cache;
+    VisitFilterCache(cache, chunks, key);
+  });
+  Cache<Mode> warm;
+  VisitFilterCache(warm, chunks, key);
+  bench.run(name + u8"-warm", bytes, chunks.size(), "chunks", [&warm, &chunks, &key]() {
+    VisitFilterCache(warm, chunks, key);
+  });
+}
+
+static void BenchFilter(Bench &bench, Path const &dir, Session &session) {
+  using namespace std;
+  if (!bench.enabled(u8"Filter/key-cold") && !bench.enabled(u8"Filter/key-warm") && !bench.enabled(u8"Filter/value-cold") && !bench.enabled(u8"Filter/value-warm")) {
+    return;
+  }
+  Path file = dir / u8"r.0.0.mca";
+  if (!BenchWorld(4, 1024).writeRegion(file, 0, 0, false) || !session.open(file).empty()) {
+    PrintBenchError(u8"Filter: Can't write the fixture");
+    return;
+  }
+  session.wait(session.root());
+  auto const &chunks = get<0>(session.root()->region()->fValue);
+  uint64_t bytes = 0;
+  for (auto const &chunk : chunks) {
+    if (auto c = chunk ? chunk->compound() : nullptr; c) {
+      bytes += c->fSize.fDecoded;
+    }
+  }
+  BenchFilterCache<FilterMode::Key>(bench, u8"Filter/key", chunks, bytes);
+  BenchFilterCache<FilterMode::Value>(bench, u8"Filter/value", chunks, bytes);
+}
+
+static void BenchDirectoryContents(Bench &bench, Path const &dir) {
+  String name = u8"DirectoryContents/10k";
+  if (!bench.enabled(name)) {
+    return;
+  }
+  constexpr size_t kFiles = 10000;
+  constexpr size_t kDirectories = 100;
+  if (!WriteEmptyFiles(dir, kFiles, kDirectories)) {
+    PrintBenchError(name + u8": Can't write the fixture");
+    return;
+  }
+  auto parent = Node::DirectoryUnopened(dir, nullptr);
+  bench.run(name, 0, kFiles + kDirectories, "entries", [&dir, &parent]() {
+    DirectoryContents contents(dir, parent);
+  });
+}
+
+// Deflates buffers around the block size with every container and profile, and inflates them back. The bytes are drawn
+// from a small alphabet, so that the dictionary carried over from the previous block matters.
+static bool VerifyParallelDeflate(TaskQueue &pool) {
+  using namespace std;
+  size_t const block = ParallelDeflate::kBlockSize;
+  mt19937 random(5);
+  for (size_t size : {size_t(0), block / 2, block, block * 4 + 1000}) {
+    vector<uint8_t> raw(size);
+    for (auto &b : raw) {
+      b = (uint8_t)('a' + random() % 8);
+    }
+    for (auto container : {ParallelDeflate::Container::Zlib, ParallelDeflate::Container::Gzip}) {
+      for (auto profile : {SaveProfile::Fast, SaveProfile::Balanced, SaveProfile::Smallest}) {
+        String name = u8"ParallelDeflate/" + String(container == ParallelDeflate::Container::Zlib ? u8"zlib" : u8"gzip") + u8"/" + ToString(size);
+        vector<uint8_t> compressed = raw;
+        if (!ParallelDeflate::Compress(compressed, container, ParallelDeflate::Level(profile), &pool)) {
+          PrintBenchError(name + u8": Can't deflate");
+          return false;
+        }
+        vector<uint8_t> inflated;
+        if (!Inflate(compressed, inflated)) {
+          PrintBenchError(name + u8": Can't inflate");
+          return false;
+        }
+        if (inflated != raw) {
+          PrintBenchError(name + u8": Inflated bytes differ");
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+static int RunBench(int argc, char *argv[]) {
+  using namespace std;
+  int iterations = 5;
+  String only;
+  for (int i = 1; i < argc; i++) {
+    String arg = ReinterpretAsU8String(argv[i]);
+    if (arg == u8"--iterations" && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (arg == u8"--only" && i + 1 < argc) {
+      only = ReinterpretAsU8String(argv[++i]);
+    } else {
+      fputs("Usage: nbte-bench [--iterations N] [--only NAME]\n", stderr);
+      return 2;
+    }
+  }
+
+  Bench bench(iterations, only);
+  TemporaryDirectory temp;
+  {
+    // Benchmarks of saving are meaningless when what is saved can't be read back.
+    Session session;
+    if (!VerifyParallelDeflate(session.pool())) {
+      return 1;
+    }
+  }
+  Bench::PrintHeader();
+  {
+    Session session;
+    BenchReadCompound(bench, temp.createTempChildDirectory(), session.pool());
+    BenchReadRegion(bench, temp.createTempChildDirectory(), session.pool());
+  }
+  {
+    Session session;
+    BenchSave(bench, temp.createTempChildDirectory(), session);
+  }
+  {
+    Session session;
+    BenchFilter(bench, temp.createTempChildDirectory(), session);
+  }
+  BenchDirectoryContents(bench, temp.createTempChildDirectory());
+  return 0;
+}
+
+} // namespace nbte
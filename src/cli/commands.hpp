@@ -0,0 +1,252 @@
+#pragma once
+
+namespace nbte {
+
+static char const *const kCliUsage = R"(Usage: nbte-cli <command> <path> [options]
+
+<path> is an NBT file, a region file, or a directory such as a world folder.
+
+Commands:
+  dump <path>                       Print every value, as <location>:<nbt-path> = <value>
+  search <path> <term>              Print the values under keys containing term
+    --value                         Match string values instead of keys
+    --case-sensitive                Match the case of term
+  set <path> <address> <value>      Set a value and save the file. address is
+                                    <location>:<nbt-path> as printed by dump, where
+                                    / and \ in keys are escaped with \
+  save <path>                       Save every file again, with the editor's encoder
+
+Options of set and save:
+  --compression fast|balanced|smallest
+)";
+
+static void Print(String const &s) {
+  fwrite(s.data(), 1, s.size(), stdout);
+}
+
+static void PrintError(String const &s) {
+  fprintf(stderr, "nbte-cli: %s\n", (char const *)s.c_str());
+}
+
+static String ChunkLocation(Session const &session, Compound const &chunk) {
+  return session.location(chunk.fRegionFile) + u8"@" + ToString(chunk.fChunkX) + u8"," + ToString(chunk.fChunkZ);
+}
+
+// Chunks of a region are printed by the pool, and written in the order of the region.
+template <FilterMode Mode>
+static void PrintNode(Session &session, std::shared_ptr<Node> const &node, FilterKey const *filter) {
+  using namespace std;
+  if (auto c = node->compound(); c && c->fTag) {
+    NbtPrinter<Mode> printer(session.location(get<1>(c->fName)), filter);
+    printer.print(c->fTag);
+    Print(printer.fOut);
+  } else if (auto r = node->region(); r && r->ready()) {
+    auto const &chunks = get<0>(r->fValue);
+    vector<String> out(chunks.size());
+    session.parallelFor(chunks.size(), [&session, &chunks, &out, filter](size_t i) {
+      auto c = chunks[i] ? chunks[i]->compound() : nullptr;
+      if (!c || !c->fTape) {
+        return;
+      }
+      NbtPrinter<Mode> printer(ChunkLocation(session, *c), filter);
+      printer.print(*c->fTape);
+      out[i].swap(printer.fOut);
+    });
+    for (auto const &it : out) {
+      Print(it);
+    }
+  }
+}
+
+template <FilterMode Mode>
+static int PrintAll(Path const &target, FilterKey const *filter) {
+  Session session;
+  if (auto err = session.open(target); !err.empty()) {
+    PrintError(err);
+    return 1;
+  }
+  session.forEachFile([&session, filter](std::shared_ptr<Node> const &node) {
+    PrintNode<Mode>(session, node, filter);
+  });
+  return 0;
+}
+
+static int SetValue(Path const &target, String const &address, String const &value, SaveProfile profile) {
+  using namespace std;
+  namespace fs = std::filesystem;
+
+  size_t separator = address.find(u8":/");
+  if (separator == String::npos) {
+    PrintError(u8"Address must be <location>:<nbt-path>: " + address);
+    return 2;
+  }
+  String location = address.substr(0, separator);
+  vector<String> path = SplitNbtPath(address.substr(separator + 1));
+  optional<mcfile::Pos2i> chunk;
+  if (size_t at = location.rfind(u8'@'); at != String::npos) {
+    String pos = location.substr(at + 1);
+    size_t comma = pos.find(u8',');
+    auto x = comma == String::npos ? nullopt : ParseNumber<int32_t>(pos.substr(0, comma), u8"");
+    auto z = comma == String::npos ? nullopt : ParseNumber<int32_t>(pos.substr(comma + 1), u8"");
+    if (!x || !z) {
+      PrintError(u8"Chunk must be given as @<x>,<z>: " + location);
+      return 2;
+    }
+    chunk = mcfile::Pos2i(*x, *z);
+    location = location.substr(0, at);
+  }
+
+  error_code ec;
+  Path file = fs::is_directory(target, ec) ? target / Path(location) : target;
+  Session session;
+  if (auto err = session.open(file); !err.empty()) {
+    PrintError(err);
+    return 1;
+  }
+  auto const &node = session.root();
+  session.wait(node);
+
+  EditJournal::Record r;
+  Compound *root = nullptr;
+  bool applied = false;
+  if (chunk) {
+    auto region = node->region();
+    if (!region) {
+      PrintError(u8"Not a region file: " + location);
+      return 1;
+    }
+    int localX = chunk->fX - region->fX * 32;
+    int localZ = chunk->fZ - region->fZ * 32;
+    if (localX < 0 || 32 <= localX || localZ < 0 || 32 <= localZ) {
+      PrintError(u8"The chunk is not in the region: " + location);
+      return 1;
+    }
+    auto const &c = get<0>(region->fValue)[Region::Index(localX, localZ)];
+    root = c ? c->compound() : nullptr;
+    if (!root || !root->fTape) {
+      PrintError(u8"The chunk is missing or broken");
+      return 1;
+    }
+    Tape &tape = *root->fTape;
+    if (auto index = ResolveNbtPath(tape, path, &r.fElement); index) {
+      r.fType = tape.type(*index);
+      if (!EncodeValue(value, r)) {
+        PrintError(u8"Not a valid value for the type: " + value);
+        return 1;
+      }
+      applied = ApplyJournalRecord(r, tape, *index);
+    }
+  } else {
+    root = node->compound();
+    if (!root || !root->fTag) {
+      PrintError(u8"Not an NBT file: " + location);
+      return 1;
+    }
+    if (auto tag = ResolveNbtPath(*root->fTag, path, &r.fElement); tag) {
+      r.fType = tag->type();
+      if (!EncodeValue(value, r)) {
+        PrintError(u8"Not a valid value for the type: " + value);
+        return 1;
+      }
+      applied = ApplyJournalRecord(r, *tag);
+    }
+  }
+  if (!applied) {
+    PrintError(u8"No such value: " + address);
+    return 1;
+  }
+  root->markEdited();
+  if (auto err = session.save(node, profile); !err.empty()) {
+    PrintError(err);
+    return 1;
+  }
+  return 0;
+}
+
+// Every file and chunk is marked as edited, so everything is encoded again with the profile.
+static int SaveAll(Path const &target, SaveProfile profile) {
+  Session session;
+  if (auto err = session.open(target); !err.empty()) {
+    PrintError(err);
+    return 1;
+  }
+  size_t saved = 0;
+  size_t failed = 0;
+  session.forEachFile([&](std::shared_ptr<Node> const &node) {
+    if (auto c = node->compound(); c && c->fTag) {
+      c->markEdited();
+    } else if (auto r = node->region(); r && r->ready()) {
+      for (auto const &chunk : std::get<0>(r->fValue)) {
+        if (auto c = chunk ? chunk->compound() : nullptr; c && c->fTape) {
+          c->markEdited();
+        }
+      }
+    } else {
+      return;
+    }
+    if (auto err = session.save(node, profile); !err.empty()) {
+      PrintError(session.location(*node->path()) + u8": " + err);
+      failed++;
+    } else {
+      saved++;
+    }
+  });
+  Print(u8"Saved " + ToString(saved) + u8" files\n");
+  return failed == 0 ? 0 : 1;
+}
+
+static int RunCli(int argc, char *argv[]) {
+  using namespace std;
+
+  vector<String> args;
+  bool caseSensitive = false;
+  FilterMode mode = FilterMode::Key;
+  SaveProfile profile = SaveProfile::Balanced;
+  for (int i = 1; i < argc; i++) {
+    String arg = ReinterpretAsU8String(argv[i]);
+    if (arg == u8"--value") {
+      mode = FilterMode::Value;
+    } else if (arg == u8"--case-sensitive") {
+      caseSensitive = true;
+    } else if (arg == u8"--compression" && i + 1 < argc) {
+      auto p = ParseSaveProfile(ReinterpretAsU8String(argv[++i]));
+      if (!p) {
+        fputs(kCliUsage, stderr);
+        return 2;
+      }
+      profile = *p;
+    } else if (arg == u8"--help" || arg == u8"-h") {
+      fputs(kCliUsage, stdout);
+      return 0;
+    } else if (arg == u8"--version") {
+      Print(String(kAppVersion) + u8"\n");
+      return 0;
+    } else {
+      args.push_back(arg);
+    }
+  }
+  if (args.size() < 2) {
+    fputs(kCliUsage, stderr);
+    return 2;
+  }
+  String const &command = args[0];
+  Path target(args[1]);
+  if (command == u8"dump" && args.size() == 2) {
+    return PrintAll<FilterMode::Key>(target, nullptr);
+  } else if (command == u8"search" && args.size() == 3 && !args[2].empty()) {
+    FilterKey key(args[2], caseSensitive);
+    if (mode == FilterMode::Key) {
+      return PrintAll<FilterMode::Key>(target, &key);
+    } else {
+      return PrintAll<FilterMode::Value>(target, &key);
+    }
+  } else if (command == u8"set" && args.size() == 4) {
+    return SetValue(target, args[2], args[3], profile);
+  } else if (command == u8"save" && args.size() == 2) {
+    return SaveAll(target, profile);
+  }
+  fputs(kCliUsage, stderr);
+  return 2;
+}
+
+} // namespace nbte
@@ -0,0 +1,66 @@
+// Command line tool built on the model of the editor, without any of its UI.
+
+#if defined(_MSC_VER)
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <minecraft-file.hpp>
+extern "C" {
+#include <uuid4.h>
+}
+#include <variant>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <thread>
+#include <list>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <fstream>
+#include <mutex>
+#include <ctime>
+#include <deque>
+#include <shared_mutex>
+#include <string_view>
+#include <charconv>
+
+#include "version.hpp"
+#include "string.hpp"
+#include "file-system.hpp"
+#include "temporary-directory.hpp"
+#include "tracer.hpp"
+#include "task-queue.hpp"
+#include "completion-queue.hpp"
+#include "deflate.hpp"
+#include "filter-key.hpp"
+#include "model/node-arena.hpp"
+#include "model/key-table.hpp"
+#include "model/blob-pool.hpp"
+#include "model/tape.hpp"
+#include "model/node-size.hpp"
+#include "model/node.hpp"
+#include "model/memory-budget.hpp"
+#include "model/edit-journal.hpp"
+#include "model/nbt-value.hpp"
+#include "model/region-file.hpp"
+#include "filter-cache.hpp"
+#include "model/node.impl.hpp"
+#include "model/directory-contents.impl.hpp"
+#include "model/compound.impl.hpp"
+#include "model/save-snapshot.hpp"
+#include "model/region.impl.hpp"
+#include "model/edit-journal.impl.hpp"
+#include "cli/session.hpp"
+#include "cli/nbt-text.hpp"
+#include "cli/nbt-printer.hpp"
+#include "cli/commands.hpp"
+
+int main(int argc, char *argv[]) {
+  return nbte::RunCli(argc, argv);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+namespace nbte {
+
+// Writes the values of a compound as lines of "<location>:<path> = <value>". With a filter, only the values matching it
+// are written: in key mode the values under a matching key, in value mode the matching strings. Subtrees without a
+// match are skipped with the filter cache, as the editor does.
+template <FilterMode Mode>
+class NbtPrinter {
+public:
+  NbtPrinter(String const &location, FilterKey const *filter) : fLocation(location), fFilter(filter) {}
+
+  void print(std::shared_ptr<mcfile::nbt::CompoundTag> const &tag) {
+    visitChildren(TagValue(tag), u8"", fFilter);
+  }
+
+  void print(Tape &tape) {
+    visitChildren(TapeValue(tape, 0), u8"", fFilter);
+  }
+
+  String fOut;
+
+private:
+  void line(String const &path, String const &value) {
+    fOut += fLocation + u8":" + path + u8" = " + value + u8"\n";
+  }
+
+  // name is null for items of a list.
+  template <class Value>
+  void visit(Value const &value, String const *name, String const &path, FilterKey const *filter) {
+    using Type = typename Value::Type;
+    bool keyMatched = filter && Mode == FilterMode::Key && name && value.matchKey(fCache, *name, *filter);
+    switch (value.type()) {
+    case Type::Compound:
+    case Type::List:
+      if (keyMatched) {
+        filter = nullptr;
+      }
+      if (filter && !fCache.containsSearchTerm(value.entry(), *filter)) {
+        return;
+      }
+      visitChildren(value, path, filter);
+      return;
+    case Type::String:
+      if (filter && !keyMatched && (Mode == FilterMode::Key || !filter->match(value.string()))) {
+        return;
+      }
+      break;
+    default:
+      if (filter && !keyMatched) {
+        return;
+      }
+      break;
+    }
+    line(path, FormatValue(value));
+  }
+
+  template <class Value>
+  void visitChildren(Value const &value, String const &path, FilterKey const *filter) {
+    if (value.size() == 0 && !filter) {
+      line(path, FormatValue(value));
+    }
+    value.forEachChild([&](uint32_t i, String const *name, Value const &child) {
+      visit(child, name, path + u8"/" + (name ? EscapeNbtKey(*name) : ToString(i)), filter);
+    });
+  }
+
+  String const fLocation;
+  FilterKey const *const fFilter;
+  Cache<Mode> fCache;
+};
+
+} // namespace nbte
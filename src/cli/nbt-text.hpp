@@ -0,0 +1,302 @@
+#pragma once
+
+namespace nbte {
+
+// Values are written in SNBT notation, and parsed back from it as well as from plain numbers and strings.
+
+template <class T>
+static String FormatNumber(T v) {
+  char buffer[64];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), v);
+  return String((char8_t const *)buffer, (char8_t const *)result.ptr);
+}
+
+static String QuoteString(String const &s) {
+  String ret = u8"\"";
+  for (char8_t c : s) {
+    switch (c) {
+    case u8'"':
+      ret += u8"\\\"";
+      break;
+    case u8'\\':
+      ret += u8"\\\\";
+      break;
+    case u8'\n':
+      ret += u8"\\n";
+      break;
+    case u8'\t':
+      ret += u8"\\t";
+      break;
+    default:
+      ret.push_back(c);
+      break;
+    }
+  }
+  ret += u8"\"";
+  return ret;
+}
+
+static String UnquoteString(String const &s) {
+  if (s.size() < 2 || s.front() != u8'"' || s.back() != u8'"') {
+    return s;
+  }
+  String ret;
+  for (size_t i = 1; i + 1 < s.size(); i++) {
+    char8_t c = s[i];
+    if (c == u8'\\' && i + 2 < s.size()) {
+      c = s[++i];
+      if (c == u8'n') {
+        c = u8'\n';
+      } else if (c == u8't') {
+        c = u8'\t';
+      }
+    }
+    ret.push_back(c);
+  }
+  return ret;
+}
+
+template <class T, class Value>
+static String FormatArray(char8_t prefix, Value const &value) {
+  String ret = u8"[";
+  ret.push_back(prefix);
+  ret += u8";";
+  for (uint32_t i = 0; i < value.size(); i++) {
+    ret += (i == 0 ? u8" " : u8", ") + FormatNumber(value.template element<T>(i));
+  }
+  ret += u8"]";
+  return ret;
+}
+
+// Formats a TagValue or TapeValue. Bytes are shown unsigned, as the editor does.
+template <class Value>
+static String FormatValue(Value const &value) {
+  using Type = typename Value::Type;
+  switch (value.type()) {
+  case Type::Byte:
+    return FormatNumber(value.template scalar<uint8_t>()) + u8"b";
+  case Type::Short:
+    return FormatNumber(value.template scalar<int16_t>()) + u8"s";
+  case Type::Int:
+    return FormatNumber(value.template scalar<int32_t>());
+  case Type::Long:
+    return FormatNumber(value.template scalar<int64_t>()) + u8"L";
+  case Type::Float:
+    return FormatNumber(value.template scalar<float>()) + u8"f";
+  case Type::Double:
+    return FormatNumber(value.template scalar<double>()) + u8"d";
+  case Type::String:
+    return QuoteString(value.string());
+  case Type::ByteArray:
+    return FormatArray<uint8_t>(u8'B', value);
+  case Type::IntArray:
+    return FormatArray<int32_t>(u8'I', value);
+  case Type::LongArray:
+    return FormatArray<int64_t>(u8'L', value);
+  case Type::Compound:
+    return u8"{}";
+  case Type::List:
+    return u8"[]";
+  default:
+    return u8"";
+  }
+}
+
+template <class T>
+static std::optional<T> ParseNumber(String const &text, String const &suffixes) {
+  String s = text;
+  if (!s.empty() && suffixes.find(s.back()) != String::npos) {
+    s.pop_back();
+  }
+  char const *begin = (char const *)s.data();
+  char const *end = begin + s.size();
+  if (begin != end && *begin == '+') {
+    begin++;
+  }
+  T v;
+  auto result = std::from_chars(begin, end, v);
+  if (result.ec != std::errc() || result.ptr != end) {
+    return std::nullopt;
+  }
+  return v;
+}
+
+template <class T>
+static bool EncodeNumber(String const &text, String const &suffixes, EditJournal::Record &r) {
+  auto v = ParseNumber<T>(text, suffixes);
+  if (!v) {
+    return false;
+  }
+  r.fValue.resize(sizeof(T));
+  memcpy(r.fValue.data(), &*v, sizeof(T));
+  return true;
+}
+
+// Fills fValue of the record from text, for a value or an array element of fType. Bytes take -128 to 255.
+static bool EncodeValue(String const &text, EditJournal::Record &r) {
+  using Type = Tape::Type;
+  bool element = r.fElement != EditJournal::kNoElement;
+  switch (r.fType) {
+  case Type::Byte:
+  case Type::ByteArray: {
+    if (element != (r.fType == Type::ByteArray)) {
+      return false;
+    }
+    auto v = ParseNumber<int32_t>(text, u8"bB");
+    if (!v || *v < -128 || 255 < *v) {
+      return false;
+    }
+    r.fValue.assign(1, (uint8_t)*v);
+    return true;
+  }
+  case Type::Short:
+    return !element && EncodeNumber<int16_t>(text, u8"sS", r);
+  case Type::Int:
+    return !element && EncodeNumber<int32_t>(text, u8"", r);
+  case Type::IntArray:
+    return element && EncodeNumber<int32_t>(text, u8"", r);
+  case Type::Long:
+    return !element && EncodeNumber<int64_t>(text, u8"lL", r);
+  case Type::LongArray:
+    return element && EncodeNumber<int64_t>(text, u8"lL", r);
+  case Type::Float:
+    return !element && EncodeNumber<float>(text, u8"fF", r);
+  case Type::Double:
+    return !element && EncodeNumber<double>(text, u8"dD", r);
+  case Type::String: {
+    if (element) {
+      return false;
+    }
+    String v = UnquoteString(text);
+    r.fValue.assign(v.begin(), v.end());
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+// Escapes a key as a step of an NBT path, so that keys containing a slash can be named.
+static String EscapeNbtKey(String const &key) {
+  String ret;
+  for (char8_t c : key) {
+    if (c == u8'/' || c == u8'\\') {
+      ret.push_back(u8'\\');
+    }
+    ret.push_back(c);
+  }
+  return ret;
+}
+
+// Splits "/Data/Player/Pos/0" into its keys and indices, unescaping them. Empty keys are kept, as in "/a//b".
+static std::vector<String> SplitNbtPath(String const &path) {
+  std::vector<String> ret;
+  if (path.empty()) {
+    return ret;
+  }
+  String step;
+  for (size_t i = path.front() == u8'/' ? 1 : 0; i < path.size(); i++) {
+    char8_t c = path[i];
+    if (c == u8'\\' && i + 1 < path.size()) {
+      step.push_back(path[++i]);
+    } else if (c == u8'/') {
+      ret.push_back(step);
+      step.clear();
+    } else {
+      step.push_back(c);
+    }
+  }
+  ret.push_back(step);
+  return ret;
+}
+
+// Resolves the path in a file read as CompoundTag. The last step may be an index in an array, returned as element.
+static mcfile::nbt::Tag *ResolveNbtPath(mcfile::nbt::CompoundTag &root, std::vector<String> const &path, uint32_t *element) {
+  using namespace mcfile::nbt;
+  *element = EditJournal::kNoElement;
+  Tag *current = &root;
+  for (size_t i = 0; i < path.size(); i++) {
+    String const &step = path[i];
+    switch (current->type()) {
+    case Tag::Type::Compound: {
+      auto &compound = static_cast<CompoundTag &>(*current);
+      auto found = compound.fValue.find(step);
+      if (found == compound.fValue.end() || !found->second) {
+        return nullptr;
+      }
+      current = found->second.get();
+      break;
+    }
+    case Tag::Type::List: {
+      auto &list = static_cast<ListTag &>(*current);
+      auto index = ParseNumber<uint32_t>(step, u8"");
+      if (!index || *index >= list.fValue.size() || !list.fValue[*index]) {
+        return nullptr;
+      }
+      current = list.fValue[*index].get();
+      break;
+    }
+    case Tag::Type::ByteArray:
+    case Tag::Type::IntArray:
+    case Tag::Type::LongArray: {
+      auto index = ParseNumber<uint32_t>(step, u8"");
+      if (!index || i + 1 != path.size()) {
+        return nullptr;
+      }
+      *element = *index;
+      return current;
+    }
+    default:
+      return nullptr;
+    }
+  }
+  return current;
+}
+
+static std::optional<uint32_t> ResolveNbtPath(Tape const &tape, std::vector<String> const &path, uint32_t *element) {
+  using Type = Tape::Type;
+  *element = EditJournal::kNoElement;
+  uint32_t current = 0;
+  for (size_t i = 0; i < path.size(); i++) {
+    String const &step = path[i];
+    switch (tape.type(current)) {
+    case Type::Compound: {
+      std::optional<uint32_t> found;
+      for (uint32_t j = 0; j < tape.size(current); j++) {
+        if (uint32_t child = tape.child(current, j); tape.name(child) == step) {
+          found = child;
+          break;
+        }
+      }
+      if (!found) {
+        return std::nullopt;
+      }
+      current = *found;
+      break;
+    }
+    case Type::List: {
+      auto index = ParseNumber<uint32_t>(step, u8"");
+      if (!index || *index >= tape.size(current)) {
+        return std::nullopt;
+      }
+      current = tape.child(current, *index);
+      break;
+    }
+    case Type::ByteArray:
+    case Type::IntArray:
+    case Type::LongArray: {
+      auto index = ParseNumber<uint32_t>(step, u8"");
+      if (!index || i + 1 != path.size()) {
+        return std::nullopt;
+      }
+      *element = *index;
+      return current;
+    }
+    default:
+      return std::nullopt;
+    }
+  }
+  return current;
+}
+
+} // namespace nbte
@@ -0,0 +1,121 @@
+#pragma once
+
+namespace nbte {
+
+// The model driven without the UI. Regions are loaded by the pool as in the editor, and the loaded ones are applied on
+// the calling thread while it waits for them, instead of once per frame.
+class Session {
+public:
+  Session() : fPool(new TaskQueue("pool", std::thread::hardware_concurrency())) {}
+
+  Session(Session const &) = delete;
+  Session &operator=(Session const &) = delete;
+
+  ~Session() {
+    if (fRoot) {
+      fRoot->cancel();
+    }
+  }
+
+  String open(Path const &target) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (fs::is_directory(target, ec)) {
+      fRoot = Node::OpenDirectory(target, *fPool, fCompletions);
+      fBase = target;
+    } else if (fs::is_regular_file(target, ec)) {
+      fRoot = Node::OpenFile(target, *fPool, fCompletions);
+      fBase = target.parent_path();
+    } else {
+      return u8"No such file or directory: " + target.u8string();
+    }
+    return u8"";
+  }
+
+  std::shared_ptr<Node> const &root() const {
+    return fRoot;
+  }
+
+  TaskQueue &pool() {
+    return *fPool;
+  }
+
+  // Calls fn for every file under the opened path, in the order the editor lists them. Regions are loaded before fn is
+  // called, with the next few files loading meanwhile. Files not edited by fn are closed again once it has returned.
+  void forEachFile(std::function<void(std::shared_ptr<Node> const &)> const &fn) {
+    using namespace std;
+    vector<shared_ptr<Node>> files;
+    collect(fRoot, files);
+    size_t loaded = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+      for (; loaded < files.size() && loaded < i + kPrefetch; loaded++) {
+        files[loaded]->load(*fPool, fCompletions);
+      }
+      wait(files[i]);
+      fn(files[i]);
+      files[i]->close();
+    }
+  }
+
+  // Waits until the region or file of node has been loaded. Does nothing for other nodes.
+  void wait(std::shared_ptr<Node> const &node) {
+    using namespace std;
+    while (node->loading()) {
+      size_t applied = fCompletions.drain([](RegionLoaded &&loaded) {
+        Node::Loaded(std::move(loaded), nullptr);
+      });
+      if (applied == 0) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+      }
+    }
+  }
+
+  // Runs f(i) for i in [0, count) on the pool, and returns once all of them have finished.
+  template <class F>
+  void parallelFor(size_t count, F const &f) {
+    TaskQueue &pool = *fPool;
+    pool.enqueue("ParallelFor", TaskPriority::High, [&pool, count, &f]() { pool.parallelFor(count, f); }).fFuture.wait();
+  }
+
+  // Writes the edited files under node with the same code the editor saves with.
+  String save(std::shared_ptr<Node> const &node, SaveProfile profile) {
+    auto snapshot = SaveSnapshot::Capture(node, profile);
+    if (snapshot->empty()) {
+      return u8"";
+    }
+    if (auto err = snapshot->write(*fPool); !err.empty()) {
+      return err;
+    }
+    snapshot->commit();
+    return u8"";
+  }
+
+  // Names the file relative to the opened directory, or the directory of the opened file.
+  String location(Path const &file) const {
+    return file.lexically_relative(fBase).generic_u8string();
+  }
+
+private:
+  static constexpr size_t kPrefetch = 2;
+
+  void collect(std::shared_ptr<Node> const &node, std::vector<std::shared_ptr<Node>> &files) {
+    if (node->directoryUnopened()) {
+      node->load(*fPool, fCompletions);
+    }
+    if (auto contents = node->directoryContents(); contents) {
+      for (auto const &child : contents->fValue) {
+        collect(child, files);
+      }
+    } else {
+      files.push_back(node);
+    }
+  }
+
+  // Declared before the pool, so that it outlives the workers.
+  RegionCompletions fCompletions;
+  std::unique_ptr<TaskQueue> fPool;
+  std::shared_ptr<Node> fRoot;
+  Path fBase;
+};
+
+} // namespace nbte
@@ -0,0 +1,54 @@
+#pragma once
+
+namespace nbte {
+
+// Results handed from background tasks to the UI thread. Any thread can push without taking a lock, and the UI thread
+// takes everything pushed so far at once, in the order it was pushed.
+template <class T>
+class CompletionQueue {
+  struct Item {
+    T fValue;
+    Item *fNext;
+  };
+
+public:
+  CompletionQueue() = default;
+  CompletionQueue(CompletionQueue const &) = delete;
+  CompletionQueue &operator=(CompletionQueue const &) = delete;
+
+  ~CompletionQueue() {
+    drain([](T &&) {});
+  }
+
+  void push(T &&value) {
+    Item *item = new Item{std::move(value), fHead.load(std::memory_order_relaxed)};
+    while (!fHead.compare_exchange_weak(item->fNext, item, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Only one thread may drain. The whole list is detached with one exchange, so pushing doesn't suffer from ABA.
+  template <class F>
+  size_t drain(F &&f) {
+    Item *head = fHead.exchange(nullptr, std::memory_order_acquire);
+    Item *ordered = nullptr;
+    while (head) {
+      Item *next = head->fNext;
+      head->fNext = ordered;
+      ordered = head;
+      head = next;
+    }
+    size_t count = 0;
+    while (ordered) {
+      std::unique_ptr<Item> item(ordered);
+      ordered = item->fNext;
+      f(std::move(item->fValue));
+      count++;
+    }
+    return count;
+  }
+
+private:
+  std::atomic<Item *> fHead = nullptr;
+};
+
+} // namespace nbte
@@ -0,0 +1,213 @@
+#pragma once
+
+namespace nbte {
+
+enum class SaveProfile : int {
+  Fast = 0,
+  Balanced,
+  Smallest,
+};
+
+// Names of the profiles on command lines.
+static std::optional<SaveProfile> ParseSaveProfile(String const &name) {
+  if (name == u8"fast") {
+    return SaveProfile::Fast;
+  } else if (name == u8"balanced") {
+    return SaveProfile::Balanced;
+  } else if (name == u8"smallest") {
+    return SaveProfile::Smallest;
+  }
+  return std::nullopt;
+}
+
+// Deflates large buffers in blocks on a TaskQueue, like pigz. Each block is deflated by its own stream, primed with the
+// 32 KiB preceding it as the dictionary, and ends on a byte boundary with a sync flush, so the blocks concatenated make
+// one standard zlib or gzip stream. Checksums of the blocks are computed in parallel as well and then combined.
+class ParallelDeflate {
+public:
+  enum class Container {
+    Zlib,
+    Gzip,
+  };
+
+  static constexpr size_t kBlockSize = 128 * 1024;
+  static constexpr size_t kDictionarySize = 32 * 1024;
+
+  static int Level(SaveProfile profile) {
+    switch (profile) {
+    case SaveProfile::Fast:
+      return 1;
+    case SaveProfile::Smallest:
+      return 9;
+    case SaveProfile::Balanced:
+    default:
+      return 6;
+    }
+  }
+
+  // Blocks are deflated on pool when it is given, otherwise on the calling thread.
+  static bool Compress(std::vector<uint8_t> &inout, Container container, int level, TaskQueue *pool) {
+    using namespace std;
+    size_t const count = max<size_t>(1, (inout.size() + kBlockSize - 1) / kBlockSize);
+    vector<Block> blocks(count);
+    auto deflateBlock = [&inout, &blocks, count, container, level](size_t i) {
+      blocks[i] = DeflateBlock(inout, i, i + 1 == count, container, level);
+    };
+    if (pool && count > 1) {
+      vector<future<void>> tasks;
+      tasks.reserve(count);
+      for (size_t i = 0; i < count; i++) {
+        tasks.push_back(pool->enqueue("Deflate", TaskPriority::High, deflateBlock, i).fFuture);
+      }
+      for (auto &task : tasks) {
+        task.wait();
+      }
+    } else {
+      for (size_t i = 0; i < count; i++) {
+        deflateBlock(i);
+      }
+    }
+
+    vector<uint8_t> out;
+    size_t size = container == Container::Gzip ? 18 : 6;
+    for (auto const &block : blocks) {
+      if (!block.fOk) {
+        return false;
+      }
+      size += block.fData.size();
+    }
+    out.reserve(size);
+    if (container == Container::Gzip) {
+      uint8_t const flags = level >= 9 ? 2 : (level <= 1 ? 4 : 0);
+      uint8_t const header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, flags, 0xff};
+      out.insert(out.end(), header, header + sizeof(header));
+    } else {
+      out.push_back(0x78);
+      out.push_back(ZlibFlags(level));
+    }
+    uint32_t checksum = blocks[0].fChecksum;
+    out.insert(out.end(), blocks[0].fData.begin(), blocks[0].fData.end());
+    for (size_t i = 1; i < count; i++) {
+      size_t length = BlockLength(inout.size(), i);
+      if (container == Container::Gzip) {
+        checksum = (uint32_t)crc32_combine(checksum, blocks[i].fChecksum, (z_off_t)length);
+      } else {
+        checksum = (uint32_t)adler32_combine(checksum, blocks[i].fChecksum, (z_off_t)length);
+      }
+      out.insert(out.end(), blocks[i].fData.begin(), blocks[i].fData.end());
+    }
+    if (container == Container::Gzip) {
+      PutLittleEndian(out, checksum);
+      PutLittleEndian(out, (uint32_t)inout.size());
+    } else {
+      for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back((uint8_t)(checksum >> shift));
+      }
+    }
+    inout.swap(out);
+    return true;
+  }
+
+private:
+  struct Block {
+    std::vector<uint8_t> fData;
+    uint32_t fChecksum = 0;
+    bool fOk = false;
+  };
+
+  static size_t BlockLength(size_t total, size_t index) {
+    return std::min(kBlockSize, total - index * kBlockSize);
+  }
+
+  static Block DeflateBlock(std::vector<uint8_t> const &in, size_t index, bool last, Container container, int level) {
+    Block ret;
+    size_t const offset = index * kBlockSize;
+    size_t const length = in.empty() ? 0 : BlockLength(in.size(), index);
+    uint8_t const *data = in.data() + offset;
+
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      return ret;
+    }
+    if (offset > 0) {
+      size_t dictionary = std::min(kDictionarySize, offset);
+      if (deflateSetDictionary(&z, data - dictionary, (uInt)dictionary) != Z_OK) {
+        deflateEnd(&z);
+        return ret;
+      }
+    }
+    // Room for the empty stored block a sync flush appends.
+    ret.fData.resize(deflateBound(&z, (uLong)length) + 16);
+    z.next_in = const_cast<Bytef *>(data);
+    z.avail_in = (uInt)length;
+    z.next_out = ret.fData.data();
+    z.avail_out = (uInt)ret.fData.size();
+    int err = deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+    bool ok = last ? err == Z_STREAM_END : (err == Z_OK && z.avail_out > 0);
+    ret.fData.resize(ret.fData.size() - z.avail_out);
+    deflateEnd(&z);
+    if (!ok || z.avail_in != 0) {
+      return ret;
+    }
+    if (container == Container::Gzip) {
+      ret.fChecksum = (uint32_t)crc32(0, data, (uInt)length);
+    } else {
+      ret.fChecksum = (uint32_t)adler32(1, data, (uInt)length);
+    }
+    ret.fOk = true;
+    return ret;
+  }
+
+  static uint8_t ZlibFlags(int level) {
+    uint8_t flags;
+    if (level <= 1) {
+      flags = 0;
+    } else if (level <= 5) {
+      flags = 1 << 6;
+    } else if (level == 6) {
+      flags = 2 << 6;
+    } else {
+      flags = 3 << 6;
+    }
+    // The header read as a big endian u16 must be a multiple of 31.
+    flags += 31 - ((0x78 << 8) + flags) % 31;
+    return flags;
+  }
+
+  static void PutLittleEndian(std::vector<uint8_t> &out, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+      out.push_back((uint8_t)(v >> (8 * i)));
+    }
+  }
+};
+
+// Inflates zlib and gzip streams alike.
+static bool Inflate(uint8_t const *in, size_t size, std::vector<uint8_t> &out) {
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  if (inflateInit2(&z, 15 + 32) != Z_OK) {
+    return false;
+  }
+  z.next_in = const_cast<Bytef *>(in);
+  z.avail_in = (uInt)size;
+  out.resize(std::max<size_t>(size * 4, 4096));
+  int err;
+  do {
+    if (z.total_out == out.size()) {
+      out.resize(out.size() * 2);
+    }
+    z.next_out = out.data() + z.total_out;
+    z.avail_out = (uInt)(out.size() - z.total_out);
+    err = inflate(&z, Z_NO_FLUSH);
+  } while (err == Z_OK);
+  out.resize(z.total_out);
+  inflateEnd(&z);
+  return err == Z_STREAM_END;
+}
+
+static bool Inflate(std::vector<uint8_t> const &in, std::vector<uint8_t> &out) {
+  return Inflate(in.data(), in.size(), out);
+}
+
+} // namespace nbte
@@ -0,0 +1,182 @@
+#pragma once
+
+namespace nbte {
+
+using Path = std::filesystem::path;
+
+static Path TemporaryDirectoryRoot() {
+#if defined(_MSC_VER)
+  wchar_t buffer[2048] = {0};
+  GetTempPathW(sizeof(buffer) / sizeof(buffer[0]), buffer);
+  return Path(buffer);
+#else
+  return std::filesystem::temp_directory_path();
+#endif
+}
+
+// Whether path is dir itself or inside it.
+static bool IsPathUnder(Path const &path, Path const &dir) {
+  auto relative = path.lexically_relative(dir);
+  return !relative.empty() && *relative.begin() != u8"..";
+}
+
+static FILE *OpenFileStream(Path const &file, String const &mode) {
+#if defined(_MSC_VER)
+  return _wfopen(file.wstring().c_str(), std::wstring(mode.begin(), mode.end()).c_str());
+#else
+  return fopen(file.c_str(), (char const *)mode.c_str());
+#endif
+}
+
+// Flushes the stream and makes the written bytes durable.
+static bool SyncFile(FILE *fp) {
+  if (fflush(fp) != 0) {
+    return false;
+  }
+#if defined(_MSC_VER)
+  return _commit(_fileno(fp)) == 0;
+#else
+  return fsync(fileno(fp)) == 0;
+#endif
+}
+
+static String UuidString() {
+  char data[37] = {0};
+  uuid4_generate(data);
+  String ret;
+  ret.assign(data, data + 36);
+  return ret;
+}
+
+// Where nbte keeps files of its own, like the edit journals of files opened alone. Inside the container of the app when
+// it runs in the App Sandbox.
+static Path ApplicationDataDirectory() {
+#if defined(_MSC_VER)
+  if (wchar_t const *local = _wgetenv(L"LOCALAPPDATA"); local && *local) {
+    return Path(local) / L"nbte";
+  }
+#elif defined(__APPLE__)
+  if (char const *home = getenv("HOME"); home && *home) {
+    return Path(home) / "Library" / "Application Support" / "nbte";
+  }
+#else
+  if (char const *data = getenv("XDG_DATA_HOME"); data && *data) {
+    return Path(data) / "nbte";
+  }
+  if (char const *home = getenv("HOME"); home && *home) {
+    return Path(home) / ".local" / "share" / "nbte";
+  }
+#endif
+  return TemporaryDirectoryRoot() / "nbte";
+}
+
+static constexpr char8_t kReplacementSuffix[] = u8".nbte-save";
+
+// Left behind by a crash while saving. Hidden from the tree.
+static bool IsReplacementFile(Path const &file) {
+  return file.filename().u8string().ends_with(kReplacementSuffix);
+}
+
+// Where the new contents of file are written before ReplaceWithSynced moves them over it. Next to file, so that the
+// rename doesn't cross file systems. The App Sandbox allows nothing next to a file opened alone, so it is in the
+// temporary directory then, and copied over file in place.
+static Path ReplacementFile(Path const &file) {
+  Path sibling = file;
+  sibling += kReplacementSuffix;
+  if (FILE *fp = OpenFileStream(sibling, u8"wb"); fp) {
+    fclose(fp);
+    return sibling;
+  }
+  return TemporaryDirectoryRoot() / (UuidString() + kReplacementSuffix);
+}
+
+// Makes a rename in dir durable.
+static bool SyncDirectory(Path const &dir) {
+#if defined(_MSC_VER)
+  // NTFS journals the rename itself.
+  return true;
+#else
+  int fd = open(dir.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = fsync(fd) == 0;
+  close(fd);
+  return ok;
+#endif
+}
+
+static bool CopyOver(Path const &from, Path const &to) {
+  using namespace std;
+  FILE *in = OpenFileStream(from, u8"rb");
+  if (!in) {
+    return false;
+  }
+  FILE *out = OpenFileStream(to, u8"wb");
+  if (!out) {
+    fclose(in);
+    return false;
+  }
+  vector<uint8_t> buffer(1024 * 1024);
+  bool ok = true;
+  while (ok) {
+    size_t read = fread(buffer.data(), 1, buffer.size(), in);
+    if (read == 0) {
+      ok = !ferror(in);
+      break;
+    }
+    ok = fwrite(buffer.data(), 1, read, out) == read;
+  }
+  ok = SyncFile(out) && ok;
+  fclose(out);
+  fclose(in);
+  return ok;
+}
+
+// Moves temp from ReplacementFile over file, and removes it when that fails. Next to file, temp is synced and renamed
+// over it, and the directory synced, so that a crash leaves either the old file or the new one. Otherwise it is copied
+// over file in place, which a crash can leave half written.
+static bool ReplaceWithSynced(Path const &temp, Path const &file) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  if (temp.parent_path() != file.parent_path()) {
+    bool ok = CopyOver(temp, file);
+    fs::remove(temp, ec);
+    return ok;
+  }
+  FILE *fp = OpenFileStream(temp, u8"ab");
+  bool ok = fp && SyncFile(fp);
+  if (fp) {
+    fclose(fp);
+  }
+  if (ok) {
+    fs::rename(temp, file, ec);
+    ok = !ec;
+  }
+  if (!ok) {
+    fs::remove(temp, ec);
+    return false;
+  }
+  return SyncDirectory(file.parent_path());
+}
+
+// Writes data over file the same way, through ReplacementFile and ReplaceWithSynced.
+static bool ReplaceWholeFile(Path const &file, std::vector<uint8_t> const &data) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  Path temp = ReplacementFile(file);
+  FILE *fp = OpenFileStream(temp, u8"wb");
+  if (!fp) {
+    fs::remove(temp, ec);
+    return false;
+  }
+  bool ok = data.empty() || fwrite(data.data(), 1, data.size(), fp) == data.size();
+  ok = fclose(fp) == 0 && ok;
+  if (!ok) {
+    fs::remove(temp, ec);
+    return false;
+  }
+  return ReplaceWithSynced(temp, file);
+}
+
+} // namespace nbte
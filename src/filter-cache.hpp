@@ -9,21 +9,28 @@ enum class FilterMode {
 
 template <FilterMode Mode>
 struct Cache {
-  bool containsSearchTerm(std::variant<std::shared_ptr<mcfile::nbt::Tag>, std::shared_ptr<Node>> const &tag, FilterKey const &key) {
+  bool containsSearchTerm(std::variant<std::shared_ptr<mcfile::nbt::Tag>, std::shared_ptr<Node>, TapeEntry> const &tag, FilterKey const &key) {
     intptr_t ptr;
     if (tag.index() == 0) {
       ptr = (intptr_t)std::get<0>(tag).get();
-    } else {
+    } else if (tag.index() == 1) {
       ptr = (intptr_t)std::get<1>(tag).get();
+    } else {
+      auto const &entry = std::get<2>(tag);
+      ptr = (intptr_t)entry.fTape->address(entry.fIndex);
     }
     if (auto found = fValue.find(ptr); found != fValue.end()) {
+      fHits++;
       return found->second;
     }
+    fMisses++;
     bool result;
     if (tag.index() == 0) {
       result = containsTerm(std::get<0>(tag), key);
-    } else {
+    } else if (tag.index() == 1) {
       result = containsTerm(std::get<1>(tag), key);
+    } else {
+      result = containsTerm(std::get<2>(tag), key);
     }
     fValue[ptr] = result;
     return result;
@@ -33,6 +40,29 @@ struct Cache {
     fValue.erase((intptr_t)node.get());
   }
 
+  // Whether the key with the id in KeyTable matches. Computed once per key, not once per occurrence.
+  bool matchKey(uint32_t id, FilterKey const &key) {
+    if (uint64_t generation = KeyTable::Shared().generation(); generation != fKeyGeneration) {
+      // Ids of dropped keys may mean other keys now.
+      fKeyMatches.clear();
+      fKeyGeneration = generation;
+    }
+    if (id >= fKeyMatches.size()) {
+      fKeyMatches.resize(id + 1, kKeyMatchUnknown);
+    }
+    if (fKeyMatches[id] == kKeyMatchUnknown) {
+      fKeyMatches[id] = key.match(KeyTable::Shared().key(id)) ? 1 : 0;
+    }
+    return fKeyMatches[id] == 1;
+  }
+
+  void takeStatistics(uint64_t *hits, uint64_t *misses) {
+    *hits += fHits;
+    *misses += fMisses;
+    fHits = 0;
+    fMisses = 0;
+  }
+
 private:
   bool containsTerm(std::shared_ptr<mcfile::nbt::Tag> const &tag, FilterKey const &key) {
     using namespace std;
@@ -55,8 +85,8 @@ private:
       if (auto v = dynamic_pointer_cast<CompoundTag>(tag); v) {
         for (auto const &it : *v) {
           if (Mode == FilterMode::Key) {
-            String name = it.first;
-            if ((key.fCaseSensitive ? name : ToLower(name)).find(key.fSearch) != String::npos) {
+            String const &name = it.first;
+            if (key.match(name)) {
               return true;
             }
           }
@@ -80,8 +110,7 @@ private:
         return false;
       } else {
         if (auto v = dynamic_pointer_cast<StringTag>(tag); v) {
-          String value = v->fValue;
-          return (key.fCaseSensitive ? ToLower(value) : value).find(key.fSearch) != String::npos;
+          return key.match(v->fValue);
         }
       }
       return false;
@@ -92,6 +121,43 @@ private:
     return false;
   }
 
+  bool containsTerm(TapeEntry const &entry, FilterKey const &key) {
+    using Type = Tape::Type;
+
+    assert(!key.fSearch.empty());
+
+    Tape const &tape = *entry.fTape;
+    switch (tape.type(entry.fIndex)) {
+    case Type::Compound:
+      for (uint32_t i = 0; i < tape.size(entry.fIndex); i++) {
+        uint32_t child = tape.child(entry.fIndex, i);
+        if (Mode == FilterMode::Key) {
+          if (matchKey(tape.key(child), key)) {
+            return true;
+          }
+        }
+        if (containsSearchTerm(TapeEntry{&tape, child}, key)) {
+          return true;
+        }
+      }
+      return false;
+    case Type::List:
+      for (uint32_t i = 0; i < tape.size(entry.fIndex); i++) {
+        if (containsSearchTerm(TapeEntry{&tape, tape.child(entry.fIndex, i)}, key)) {
+          return true;
+        }
+      }
+      return false;
+    case Type::String:
+      if (Mode == FilterMode::Key) {
+        return false;
+      }
+      return key.match(tape.string(entry.fIndex));
+    default:
+      return false;
+    }
+  }
+
   bool containsTerm(std::shared_ptr<Node> const &node, FilterKey const &key) {
     if (!node) {
       return false;
@@ -117,7 +183,19 @@ private:
       if (key.match(c->name())) {
         return true;
       }
-      return containsTerm(c->fTag, key);
+      if (c->fTape) {
+        return containsTerm(TapeEntry{c->fTape.get(), 0}, key);
+      }
+      if (c->fTag) {
+        return containsTerm(c->fTag, key);
+      }
+      // An evicted chunk is searched without decoding it for good. Results for its tags are cached only while the
+      // temporary tape is alive.
+      if (auto tape = c->decode(); tape) {
+        Cache<Mode> scratch;
+        return scratch.containsTerm(TapeEntry{tape.get(), 0}, key);
+      }
+      return false;
     }
     if (auto c = node->directoryContents(); c) {
       for (auto const &it : c->fValue) {
@@ -133,36 +211,32 @@ private:
     if (auto directory = node->directoryUnopened(); directory) {
       return key.match(directory->filename().u8string());
     }
+    if (auto broken = node->brokenChunk(); broken) {
+      return key.match(broken->fName);
+    }
     return false;
   }
 
 private:
+  static constexpr int8_t kKeyMatchUnknown = -1;
+
   std::unordered_map<intptr_t, bool> fValue;
+  std::vector<int8_t> fKeyMatches;
+  uint64_t fKeyGeneration = 0;
+  uint64_t fHits = 0;
+  uint64_t fMisses = 0;
 };
 
 template <FilterMode Mode, size_t Size>
 struct FilterLruCache {
   using ValueType = std::pair<FilterKey, std::shared_ptr<Cache<Mode>>>;
 
-  bool containsSearchTerm(std::variant<std::shared_ptr<mcfile::nbt::Tag>, std::shared_ptr<Node>> const &tag, FilterKey const &key) {
-    using namespace std;
-    auto found = find_if(fCache.begin(), fCache.end(), [key](auto const &item) { return item.first == key; });
-    if (found != fCache.end()) {
-      auto ret = found->second->containsSearchTerm(tag, key);
-      auto index = std::distance(fCache.begin(), found);
-      if (index + 1 != fCache.size()) {
-        ValueType copy = *found;
-        fCache.erase(found);
-        fCache.push_back(copy);
-      }
-      return ret;
-    }
-    auto cache = make_shared<Cache<Mode>>();
-    if (fCache.size() + 1 > Size) {
-      fCache.erase(fCache.begin());
-    }
-    fCache.push_back(make_pair(key, cache));
-    return cache->containsSearchTerm(tag, key);
+  bool containsSearchTerm(std::variant<std::shared_ptr<mcfile::nbt::Tag>, std::shared_ptr<Node>, TapeEntry> const &tag, FilterKey const &key) {
+    return cache(key).containsSearchTerm(tag, key);
+  }
+
+  bool matchKey(uint32_t id, FilterKey const &key) {
+    return cache(key).matchKey(id, key);
   }
 
   void invalidate() {
@@ -175,13 +249,33 @@ struct FilterLruCache {
     }
   }
 
+  void takeStatistics(uint64_t *hits, uint64_t *misses) {
+    for (auto &it : fCache) {
+      it.second->takeStatistics(hits, misses);
+    }
+  }
+
 private:
+  Cache<Mode> &cache(FilterKey const &key) {
+    using namespace std;
+    auto found = find_if(fCache.begin(), fCache.end(), [&key](auto const &item) { return item.first == key; });
+    if (found != fCache.end()) {
+      fCache.splice(fCache.end(), fCache, found);
+      return *fCache.back().second;
+    }
+    if (fCache.size() + 1 > Size) {
+      fCache.erase(fCache.begin());
+    }
+    fCache.push_back(make_pair(key, make_shared<Cache<Mode>>()));
+    return *fCache.back().second;
+  }
+
   std::list<ValueType> fCache;
 };
 
 template <size_t Size>
 struct FilterCacheSelector {
-  bool containsTerm(std::variant<std::shared_ptr<mcfile::nbt::Tag>, std::shared_ptr<Node>> const &tag, FilterKey const *key, FilterMode mode) {
+  bool containsTerm(std::variant<std::shared_ptr<mcfile::nbt::Tag>, std::shared_ptr<Node>, TapeEntry> const &tag, FilterKey const *key, FilterMode mode) {
     if (!key) {
       return true;
     }
@@ -193,6 +287,10 @@ struct FilterCacheSelector {
     }
   }
 
+  bool matchKey(uint32_t id, FilterKey const &key) {
+    return fKeyFilterCache.matchKey(id, key);
+  }
+
   void invalidate() {
     fKeyFilterCache.invalidate();
     fValueFilterCache.invalidate();
@@ -203,6 +301,11 @@ struct FilterCacheSelector {
     fValueFilterCache.revoke(node);
   }
 
+  void takeStatistics(uint64_t *hits, uint64_t *misses) {
+    fKeyFilterCache.takeStatistics(hits, misses);
+    fValueFilterCache.takeStatistics(hits, misses);
+  }
+
 private:
   FilterLruCache<FilterMode::Key, Size> fKeyFilterCache;
   FilterLruCache<FilterMode::Value, Size> fValueFilterCache;
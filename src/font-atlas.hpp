@@ -0,0 +1,54 @@
+#pragma once
+
+namespace nbte {
+
+// Builds the font atlas with the default glyph ranges only, and adds glyphs on demand as RequestGlyphs reports code points
+// that are about to be rendered. Rasterizing full CJK ranges up front took most of the startup time.
+class FontAtlas {
+public:
+  static constexpr float kFontSize = 15.0f;
+
+  void load(ImFontAtlas &atlas, TextureSet &textures) {
+    fFont = LoadNamedResource("UDEVGothic35_Regular.ttf");
+    fGlyphs.clear();
+    build(atlas, textures);
+  }
+
+  // Must be called between frames, before the renderer backend's NewFrame.
+  // Returns true when the atlas has been rebuilt, then the backend's font texture has to be recreated.
+  bool update(ImFontAtlas &atlas, TextureSet &textures) {
+    if (!TakeRequestedGlyphs(fGlyphs)) {
+      return false;
+    }
+    build(atlas, textures);
+    return true;
+  }
+
+private:
+  void build(ImFontAtlas &atlas, TextureSet &textures) {
+    atlas.Clear();
+
+    if (fFont) {
+      ImFontGlyphRangesBuilder builder;
+      builder.AddRanges(atlas.GetGlyphRangesDefault());
+      for (ImWchar c : fGlyphs) {
+        builder.AddChar(c);
+      }
+      fRanges.clear();
+      builder.BuildRanges(&fRanges);
+
+      ImFontConfig cfg;
+      cfg.FontDataOwnedByAtlas = false;
+      atlas.AddFontFromMemoryTTF(fFont->fData, (int)fFont->fSize, kFontSize, &cfg, fRanges.Data);
+    }
+    textures.addCustomRects(atlas);
+    atlas.Build();
+    textures.copyCustomRects(atlas);
+  }
+
+  std::unique_ptr<Resource> fFont;
+  std::vector<ImWchar> fGlyphs;
+  ImVector<ImWchar> fRanges;
+};
+
+} // namespace nbte
@@ -0,0 +1,47 @@
+#pragma once
+
+namespace nbte {
+
+struct AllocationCounts {
+  uint64_t fAllocations = 0;
+  uint64_t fBytes = 0;
+};
+
+// Counts the heap allocations of the threads that asked for it, so that frames are measured without the allocations of
+// the workers loading in the background. Fed by the replaced operator new and by the allocator functions of ImGui.
+class AllocationCounter {
+public:
+  // Counts the allocations of the calling thread from now on.
+  static void Track() {
+    sTracked = true;
+  }
+
+  static void Count(size_t size) {
+    if (sTracked) {
+      sCounts.fAllocations++;
+      sCounts.fBytes += size;
+    }
+  }
+
+  // Returns the counts of the calling thread since the last call.
+  static AllocationCounts Take() {
+    AllocationCounts ret = sCounts;
+    sCounts = AllocationCounts();
+    return ret;
+  }
+
+  static void *ImGuiAlloc(size_t size, void *) {
+    Count(size);
+    return malloc(size);
+  }
+
+  static void ImGuiFree(void *ptr, void *) {
+    free(ptr);
+  }
+
+private:
+  static inline thread_local bool sTracked = false;
+  static inline thread_local AllocationCounts sCounts;
+};
+
+} // namespace nbte
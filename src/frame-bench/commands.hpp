@@ -0,0 +1,135 @@
+#pragma once
+
+namespace nbte {
+
+static char const *const kFrameBenchUsage = R"(Usage: nbte-frame-bench [options]
+
+Runs the editor without a window on a generated world, and prints the time,
+heap allocations and vertices per frame of each phase of a scripted session.
+With --replay, runs a session recorded in the Profiler window of the editor
+instead, and prints the time from enqueueing to completion of its tasks as well.
+
+Options:
+  --regions N                       Generate N x N regions (default 1)
+  --chunks N                        Chunks in each region (default 256)
+  --expand N                        Rows to expand (default 200)
+  --frames N                        Frames of the idle, scroll and filter phases
+                                    (default 120)
+  --budget-ms X                     Fail when the 95th percentile frame of a phase
+                                    after opening takes longer
+  --replay FILE                     Replay a recorded session
+  --map FROM=TO                     Open the files the session opened under FROM
+                                    under TO instead. The files not mapped are
+                                    copied to a temporary directory and opened
+                                    there, so that the replay doesn't change them
+  --fast                            Run the replayed frames back to back instead
+                                    of at the times they were recorded
+)";
+
+static int RunReplay(Path const &file, Replay::Options const &options, double budget, NullBackend &backend, State &state, TaskLatencies &latencies) {
+  using namespace std;
+
+  auto session = InputRecorder::Read(file);
+  if (!session) {
+    fprintf(stderr, "nbte-frame-bench: Can't read session\n");
+    return 1;
+  }
+  state.fPool->setLatencies(&latencies);
+  state.fSaveQueue->setLatencies(&latencies);
+  auto result = Replay(backend, state, options).run(*session);
+  if (auto err = get_if<String>(&result); err) {
+    fprintf(stderr, "nbte-frame-bench: %s\n", (char const *)err->c_str());
+    return 1;
+  }
+  auto const &stats = get<FrameStats>(result);
+  FrameStats::PrintHeader();
+  stats.print(u8"replay");
+  printf("\n");
+  auto tasks = latencies.take();
+  Replay::PrintLatencies(tasks);
+  if (budget > 0 && stats.percentile(0.95) * 1000 > budget) {
+    fprintf(stderr, "nbte-frame-bench: The replay exceeded the budget of %.3f ms\n", budget);
+    return 1;
+  }
+  return 0;
+}
+
+static int RunFrameBench(int argc, char *argv[]) {
+  using namespace std;
+
+  WorldGenerator::Options world;
+  world.fChunksPerRegion = 256;
+  Scenario::Options scenario;
+  double budget = 0;
+  optional<Path> replay;
+  Replay::Options replayOptions;
+  for (int i = 1; i < argc; i++) {
+    String arg = ReinterpretAsU8String(argv[i]);
+    if (arg == u8"--regions" && i + 1 < argc) {
+      world.fRegions = max(atoi(argv[++i]), 1);
+    } else if (arg == u8"--chunks" && i + 1 < argc) {
+      world.fChunksPerRegion = (size_t)max(atoi(argv[++i]), 1);
+    } else if (arg == u8"--expand" && i + 1 < argc) {
+      scenario.fExpandSteps = (size_t)max(atoi(argv[++i]), 0);
+    } else if (arg == u8"--frames" && i + 1 < argc) {
+      scenario.fFrames = (size_t)max(atoi(argv[++i]), 1);
+    } else if (arg == u8"--budget-ms" && i + 1 < argc) {
+      budget = atof(argv[++i]);
+    } else if (arg == u8"--replay" && i + 1 < argc) {
+      replay = Path(ReinterpretAsU8String(argv[++i]));
+    } else if (arg == u8"--map" && i + 1 < argc) {
+      String mapping = ReinterpretAsU8String(argv[++i]);
+      auto separator = mapping.find(u8'=');
+      if (separator == String::npos) {
+        fputs(kFrameBenchUsage, stderr);
+        return 2;
+      }
+      replayOptions.fMappings.push_back(make_pair(mapping.substr(0, separator), mapping.substr(separator + 1)));
+    } else if (arg == u8"--fast") {
+      replayOptions.fFast = true;
+    } else if (arg == u8"--help" || arg == u8"-h") {
+      fputs(kFrameBenchUsage, stdout);
+      return 0;
+    } else {
+      fputs(kFrameBenchUsage, stderr);
+      return 2;
+    }
+  }
+
+  // Outlives the state, which writes its edit journal into the world.
+  TemporaryDirectory temp;
+  // Outlives the workers of the state, and is set before anything is enqueued.
+  TaskLatencies latencies;
+  NullBackend backend(ImVec2(1280, 720));
+  State state;
+  backend.init(state);
+  if (replay) {
+    replayOptions.fScratch = temp.createTempChildDirectory();
+    return RunReplay(*replay, replayOptions, budget, backend, state, latencies);
+  }
+  Path dir = temp.createTempChildDirectory();
+  if (auto err = WorldGenerator(world).generate(dir, state.fPool.get()); !err.empty()) {
+    fprintf(stderr, "nbte-frame-bench: %s\n", (char const *)err.c_str());
+    return 1;
+  }
+
+  auto result = Scenario(backend, state, scenario).run(dir);
+  if (auto err = get_if<String>(&result); err) {
+    fprintf(stderr, "nbte-frame-bench: %s\n", (char const *)err->c_str());
+    return 1;
+  }
+  FrameStats::PrintHeader();
+  int ret = 0;
+  for (auto const &[name, stats] : get<0>(result)) {
+    stats.print(name);
+    if (budget > 0 && name != u8"open" && stats.percentile(0.95) * 1000 > budget) {
+      ret = 1;
+    }
+  }
+  if (ret != 0) {
+    fprintf(stderr, "nbte-frame-bench: A phase exceeded the budget of %.3f ms\n", budget);
+  }
+  return ret;
+}
+
+} // namespace nbte
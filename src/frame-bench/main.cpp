@@ -0,0 +1,110 @@
+// Runs the editor without a window and without a GPU, and measures its frames.
+
+#include "imgui.h"
+#include "imgui_internal.h"
+#include "imgui_stdlib.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#if defined(_MSC_VER)
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <minecraft-file.hpp>
+extern "C" {
+#include <uuid4.h>
+}
+#include <variant>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <thread>
+#include <list>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <fstream>
+#include <mutex>
+#include <ctime>
+#include <deque>
+#include <shared_mutex>
+#include <string_view>
+#include <random>
+#include <cmath>
+
+#include "version.hpp"
+#include "string.hpp"
+#include "file-system.hpp"
+#include "texture.hpp"
+#include "platform.hpp"
+#include "texture-set.hpp"
+#include "temporary-directory.hpp"
+#include "tracer.hpp"
+#include "task-queue.hpp"
+#include "completion-queue.hpp"
+#include "deflate.hpp"
+#include "profiler.hpp"
+#include "filter-key.hpp"
+#include "imgui-ext.hpp"
+#include "font-atlas.hpp"
+#include "input-recorder.hpp"
+#include "model/node-arena.hpp"
+#include "model/key-table.hpp"
+#include "model/blob-pool.hpp"
+#include "model/tape.hpp"
+#include "model/node-size.hpp"
+#include "model/node.hpp"
+#include "model/memory-budget.hpp"
+#include "model/edit-journal.hpp"
+#include "model/nbt-value.hpp"
+#include "model/region-file.hpp"
+#include "model/region-compactor.hpp"
+#include "model/region-scanner.hpp"
+#include "filter-cache.hpp"
+#include "model/node.impl.hpp"
+#include "model/directory-contents.impl.hpp"
+#include "model/compound.impl.hpp"
+#include "model/save-snapshot.hpp"
+#include "model/state.hpp"
+#include "model/region.impl.hpp"
+#include "model/edit-journal.impl.hpp"
+#include "render/legal.hpp"
+#include "render/profiler.hpp"
+#include "render/largest-items.hpp"
+#include "render/compaction-report.hpp"
+#include "render/scan-report.hpp"
+#include "render/render.hpp"
+#include "generator/world-generator.hpp"
+#include "frame-bench/allocation-counter.hpp"
+#include "frame-bench/null-backend.hpp"
+#include "frame-bench/scenario.hpp"
+#include "frame-bench/replay.hpp"
+#include "frame-bench/commands.hpp"
+
+// Every allocation through new is counted, for the threads that track them.
+void *operator new(size_t size) {
+  nbte::AllocationCounter::Count(size);
+  if (void *p = malloc(size == 0 ? 1 : size); p) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+int main(int argc, char *argv[]) {
+  uuid4_init();
+  return nbte::RunFrameBench(argc, argv);
+}
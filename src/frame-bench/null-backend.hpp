@@ -0,0 +1,102 @@
+#pragma once
+
+namespace nbte {
+
+// Stands in for the platform and renderer backends of ImGui, so that Render runs without a window or a GPU. Input is
+// queued as a platform backend would queue it, and the draw data is left undrawn. Time advances by a fixed step per
+// frame unless a replayed session says otherwise, so that animations and double clicks behave the same on every run.
+class NullBackend {
+public:
+  static constexpr float kDeltaTime = 1.0f / 60.0f;
+
+  struct Frame {
+    double fSeconds = 0;
+    AllocationCounts fAllocations;
+    int fVertices = 0;
+  };
+
+  explicit NullBackend(ImVec2 displaySize) {
+    // Before the context is created, so that its own allocations are counted as well.
+    im::SetAllocatorFunctions(AllocationCounter::ImGuiAlloc, AllocationCounter::ImGuiFree, nullptr);
+    IMGUI_CHECKVERSION();
+    im::CreateContext();
+    ImGuiIO &io = im::GetIO();
+    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+    io.IniFilename = nullptr;
+    io.DisplaySize = displaySize;
+    io.DeltaTime = kDeltaTime;
+    im::StyleColorsLight();
+    AllocationCounter::Track();
+  }
+
+  NullBackend(NullBackend const &) = delete;
+  NullBackend &operator=(NullBackend const &) = delete;
+
+  ~NullBackend() {
+    im::DestroyContext();
+  }
+
+  // As main does before the first frame.
+  void init(State &s) {
+    s.loadTextures(*im::GetIO().Fonts);
+  }
+
+  // Runs a frame as main does, timing everything but the upload of the font texture, which has no cost here.
+  Frame frame(State &s, float deltaTime = kDeltaTime) {
+    using namespace std;
+    ImGuiIO &io = im::GetIO();
+    AllocationCounter::Take();
+    auto start = chrono::steady_clock::now();
+
+    s.updateTextures(*io.Fonts);
+    io.DeltaTime = deltaTime;
+    im::NewFrame();
+    s.fDisplaySize = io.DisplaySize;
+    Render(s);
+
+    Frame f;
+    f.fSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    f.fAllocations = AllocationCounter::Take();
+    if (ImDrawData *data = im::GetDrawData(); data) {
+      f.fVertices = data->TotalVtxCount;
+    }
+    return f;
+  }
+
+  // ImGui spreads events that can't be told apart within a frame, such as a press and a release of the same key, over
+  // the following frames.
+  void tap(ImGuiKey key) {
+    ImGuiIO &io = im::GetIO();
+    io.AddKeyEvent(key, true);
+    io.AddKeyEvent(key, false);
+  }
+
+  void key(ImGuiKey key, bool down) {
+    im::GetIO().AddKeyEvent(key, down);
+  }
+
+  void click(ImVec2 pos) {
+    ImGuiIO &io = im::GetIO();
+    io.AddMousePosEvent(pos.x, pos.y);
+    io.AddMouseButtonEvent(ImGuiMouseButton_Left, true);
+    io.AddMouseButtonEvent(ImGuiMouseButton_Left, false);
+  }
+
+  void mouseMove(ImVec2 pos) {
+    im::GetIO().AddMousePosEvent(pos.x, pos.y);
+  }
+
+  void wheel(float y) {
+    im::GetIO().AddMouseWheelEvent(0, y);
+  }
+
+  void resize(ImVec2 displaySize) {
+    im::GetIO().DisplaySize = displaySize;
+  }
+
+  void type(String const &text) {
+    im::GetIO().AddInputCharactersUTF8((char const *)text.c_str());
+  }
+};
+
+} // namespace nbte
@@ -0,0 +1,122 @@
+#pragma once
+
+namespace nbte {
+
+// Replays a session recorded in the Profiler window of the editor. Frames run at the times they were recorded, so that
+// loading in the background overlaps them as it did, and files chosen in dialogs are opened again, at the one the
+// recorded path is mapped to, or else at a copy of it. Edits and saves replayed never change the recorded files.
+class Replay {
+public:
+  struct Options {
+    // Prefixes of the recorded paths, and what they are replaced with.
+    std::vector<std::pair<String, String>> fMappings;
+    // Where the recorded files not mapped are copied to. Must outlive the state.
+    Path fScratch;
+    // Runs the frames back to back instead, which measures them the same but loads less in between.
+    bool fFast = false;
+  };
+
+  Replay(NullBackend &backend, State &s, Options const &options) : fBackend(backend), fState(s), fOptions(options) {}
+
+  // Returns the recorded frames, followed by the ones needed to finish loading and saving, or an error.
+  std::variant<FrameStats, String> run(InputRecorder::Session const &session) {
+    using namespace std;
+    // Recording starts and stops in the Profiler window.
+    fState.fDebugOpened = true;
+    for (auto const &[path, directory] : session.fOpened) {
+      if (auto err = open(path, directory); !err.empty()) {
+        return err;
+      }
+    }
+
+    FrameStats stats;
+    auto origin = chrono::steady_clock::now();
+    for (auto const &frame : session.fFrames) {
+      if (!fOptions.fFast) {
+        this_thread::sleep_until(origin + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(frame.fTime)));
+      }
+      fBackend.resize(frame.fDisplaySize);
+      ImGuiIO &io = im::GetIO();
+      for (auto const &e : frame.fEvents) {
+        InputRecorder::Feed(io, e);
+      }
+      stats.add(fBackend.frame(fState, frame.fDeltaTime > 0 ? frame.fDeltaTime : NullBackend::kDeltaTime));
+      for (auto const &[path, directory] : frame.fOpened) {
+        if (auto err = open(path, directory); !err.empty()) {
+          return err;
+        }
+      }
+    }
+    if (!Settle(fBackend, fState, stats)) {
+      return String(u8"Loading didn't finish");
+    }
+    return stats;
+  }
+
+  static void PrintLatencies(std::map<std::string, std::vector<double>> &latencies) {
+    using namespace std;
+    printf("%-24s %7s %9s %9s %9s\n", "task", "count", "p50 ms", "p95 ms", "max ms");
+    for (auto &[name, seconds] : latencies) {
+      sort(seconds.begin(), seconds.end());
+      auto at = [&seconds](double p) {
+        return seconds[min(seconds.size() - 1, (size_t)(p * seconds.size()))] * 1000;
+      };
+      printf("%-24s %7zu %9.3f %9.3f %9.3f\n", name.c_str(), seconds.size(), at(0.5), at(0.95), at(1));
+    }
+  }
+
+private:
+  String open(Path const &recorded, bool directory) {
+    Path path;
+    if (auto mapped = remap(recorded); mapped) {
+      path = *mapped;
+    } else if (auto copied = copy(recorded); copied) {
+      path = *copied;
+    } else {
+      return String(u8"Can't copy: ") + recorded.u8string();
+    }
+    fState.openChosen(path, directory);
+    if (!fState.fError.empty()) {
+      return fState.fError + u8": " + path.u8string();
+    }
+    return {};
+  }
+
+  std::optional<Path> remap(Path const &path) const {
+    String s = path.u8string();
+    for (auto const &[from, to] : fOptions.fMappings) {
+      if (s.starts_with(from)) {
+        return Path(to + s.substr(from.size()));
+      }
+    }
+    return std::nullopt;
+  }
+
+  // A path opened again is opened at the same copy, so that it has the edits saved before.
+  std::optional<Path> copy(Path const &path) {
+    using namespace std;
+    namespace fs = std::filesystem;
+    if (auto found = fCopies.find(path); found != fCopies.end()) {
+      return found->second;
+    }
+    Path dir = fOptions.fScratch / ToString(fCopies.size());
+    error_code ec;
+    if (!fs::create_directories(dir, ec)) {
+      return nullopt;
+    }
+    Path to = dir / path.filename();
+    fs::copy(path, to, fs::copy_options::recursive, ec);
+    if (ec) {
+      return nullopt;
+    }
+    fCopies[path] = to;
+    return to;
+  }
+
+  NullBackend &fBackend;
+  State &fState;
+  Options const fOptions;
+  std::map<Path, Path> fCopies;
+};
+
+} // namespace nbte
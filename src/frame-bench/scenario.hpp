@@ -0,0 +1,189 @@
+#pragma once
+
+namespace nbte {
+
+class FrameStats {
+public:
+  void add(NullBackend::Frame const &frame) {
+    fFrames.push_back(frame);
+  }
+
+  // Seconds of the frame at the fraction p of the frames sorted by time.
+  double percentile(double p) const {
+    using namespace std;
+    if (fFrames.empty()) {
+      return 0;
+    }
+    vector<double> seconds;
+    for (auto const &frame : fFrames) {
+      seconds.push_back(frame.fSeconds);
+    }
+    sort(seconds.begin(), seconds.end());
+    return seconds[min(seconds.size() - 1, (size_t)(p * seconds.size()))];
+  }
+
+  void print(String const &name) const {
+    double allocations = 0;
+    double bytes = 0;
+    double vertices = 0;
+    for (auto const &frame : fFrames) {
+      allocations += frame.fAllocations.fAllocations;
+      bytes += frame.fAllocations.fBytes;
+      vertices += frame.fVertices;
+    }
+    double n = (double)std::max<size_t>(fFrames.size(), 1);
+    printf("%-16s %7zu %9.3f %9.3f %9.3f %9.3f %10.1f %10.1f %10.0f\n", (char const *)name.c_str(), fFrames.size(), percentile(0.5) * 1000, percentile(0.95) * 1000, percentile(0.99) * 1000, percentile(1) * 1000, allocations / n, bytes / n / 1024, vertices / n);
+  }
+
+  static void PrintHeader() {
+    printf("%-16s %7s %9s %9s %9s %9s %10s %10s %10s\n", "phase", "frames", "p50 ms", "p95 ms", "p99 ms", "max ms", "allocs", "KiB", "vertices");
+  }
+
+private:
+  std::vector<NullBackend::Frame> fFrames;
+};
+
+// Runs frames at the rate of the display until nothing is left to load or to save. Returns false when it takes too long.
+static bool Settle(NullBackend &backend, State &s, FrameStats &stats) {
+  using namespace std;
+  constexpr size_t kMaxFrames = 60 * 60 * 5;
+  size_t idle = 0;
+  for (size_t i = 0; i < kMaxFrames; i++) {
+    auto frame = backend.frame(s);
+    stats.add(frame);
+    // Twice, so that the completions of the last tasks have been applied by a frame.
+    if (s.fPool->queued() == 0 && s.fPool->running() == 0 && s.fSaveQueue->queued() == 0 && s.fSaveQueue->running() == 0) {
+      if (++idle == 2) {
+        return true;
+      }
+    } else {
+      idle = 0;
+    }
+    if (frame.fSeconds < NullBackend::kDeltaTime) {
+      this_thread::sleep_for(chrono::duration<double>(NullBackend::kDeltaTime - frame.fSeconds));
+    }
+  }
+  return false;
+}
+
+// Drives the editor through the interactions that have been slow on large worlds, with input events only, as a user
+// would: expanding the tree with the keyboard, scrolling it with the wheel, and filtering it by key and by value. Each
+// phase is measured separately.
+class Scenario {
+public:
+  struct Options {
+    // Frames of the idle, filter phases, and of each direction of scrolling.
+    size_t fFrames = 120;
+    // Each step opens the focused row and moves to the next one, so the tree is expanded depth first.
+    size_t fExpandSteps = 200;
+    String fKeyTerm = u8"Name";
+    String fValueTerm = u8"minecraft:block_1";
+  };
+
+  Scenario(NullBackend &backend, State &s, Options const &options) : fBackend(backend), fState(s), fOptions(options) {}
+
+  // Returns the phases in the order they ran, or an error.
+  std::variant<std::vector<std::pair<String, FrameStats>>, String> run(Path const &world) {
+    using namespace std;
+    vector<pair<String, FrameStats>> phases;
+
+    FrameStats open;
+    fState.openDirectory(world);
+    if (!fState.fOpened) {
+      return fState.fError;
+    }
+    if (!Settle(fBackend, fState, open)) {
+      return String(u8"Loading didn't finish");
+    }
+    phases.push_back(make_pair(u8"open", open));
+
+    FrameStats expand;
+    ImGuiWindow *editor = EditorWindow();
+    if (!editor) {
+      return String(u8"The tree is not rendered");
+    }
+    float frameHeight = im::GetFrameHeight();
+    ImVec2 origin = editor->DC.CursorStartPos;
+    // Clicking the first row focuses it, so that the arrow keys navigate from there.
+    fBackend.click(ImVec2(origin.x + frameHeight * 2, origin.y + frameHeight * 0.5f));
+    frames(expand, 3);
+    for (size_t i = 0; i < fOptions.fExpandSteps; i++) {
+      fBackend.tap(ImGuiKey_RightArrow);
+      frames(expand, 1);
+      fBackend.tap(ImGuiKey_DownArrow);
+      frames(expand, 1);
+    }
+    // Regions opened on the way are loaded in the background.
+    if (!Settle(fBackend, fState, expand)) {
+      return String(u8"Loading didn't finish");
+    }
+    phases.push_back(make_pair(u8"expand", expand));
+
+    FrameStats idle;
+    frames(idle, fOptions.fFrames);
+    phases.push_back(make_pair(u8"idle", idle));
+
+    FrameStats scroll;
+    editor = EditorWindow();
+    if (editor) {
+      fBackend.mouseMove(editor->Rect().GetCenter());
+    }
+    for (float direction : {-1.0f, 1.0f}) {
+      for (size_t i = 0; i < fOptions.fFrames; i++) {
+        fBackend.wheel(direction);
+        frames(scroll, 1);
+      }
+    }
+    phases.push_back(make_pair(u8"scroll", scroll));
+
+    phases.push_back(make_pair(u8"filter-key", filter(FilterMode::Key, fOptions.fKeyTerm)));
+    phases.push_back(make_pair(u8"filter-value", filter(FilterMode::Value, fOptions.fValueTerm)));
+    return phases;
+  }
+
+private:
+  // The tree is drawn in a child window of the main window, named by ImGui after both.
+  static ImGuiWindow *EditorWindow() {
+    ImGuiContext &g = *GImGui;
+    for (ImGuiWindow *window : g.Windows) {
+      if (strstr(window->Name, "/editor_")) {
+        return window;
+      }
+    }
+    return nullptr;
+  }
+
+  void frames(FrameStats &stats, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      stats.add(fBackend.frame(fState));
+    }
+  }
+
+  FrameStats filter(FilterMode mode, String const &term) {
+    auto ctrl = (ImGuiKey)GetModCtrlKeyIndex();
+    FrameStats stats;
+    fState.fFilterMode = mode;
+    fBackend.key(ctrl, true);
+    fBackend.key(ImGuiKey_F, true);
+    frames(stats, 1);
+    fBackend.key(ImGuiKey_F, false);
+    fBackend.key(ctrl, false);
+    // The text field takes the focus a frame after the bar opens, and characters typed before that are dropped.
+    frames(stats, 2);
+    fBackend.type(term);
+    frames(stats, fOptions.fFrames);
+    fBackend.tap(ImGuiKey_Escape);
+    frames(stats, 2);
+    // Escape only reaches the filter bar while its text field has the focus.
+    fState.fFilterBarOpened = false;
+    fState.fFilterMode = FilterMode::Key;
+    frames(stats, 1);
+    return stats;
+  }
+
+  NullBackend &fBackend;
+  State &fState;
+  Options const fOptions;
+};
+
+} // namespace nbte
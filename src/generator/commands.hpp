@@ -0,0 +1,112 @@
+#pragma once
+
+namespace nbte {
+
+static char const *const kGeneratorUsage = R"(Usage: nbte-gen <directory> [options]
+
+Writes level.dat, playerdata/, region/, entities/, and formats/ with level.dat in
+each NBT format, under <directory>. The same options write the same bytes.
+
+Options:
+  --seed N                          Seed of everything generated (default 1)
+  --regions N                       Write N x N regions (default 1)
+  --chunks N                        Chunks in each region, up to 1024 (default 1024)
+  --sections N                      Sections in each chunk (default 24)
+  --palette N                       Most blocks in the palette of a section (default 8)
+  --entities N                      Most entities in a chunk (default 8)
+  --block-entities N                Most block entities in a chunk (default 4)
+  --items N                         Most items in a container (default 27)
+  --players N                       Players in level.dat and playerdata/ (default 4)
+  --strings N                       Names drawn by string values (default 64)
+  --skew X                          1 draws names uniformly, larger favor the first
+                                    ones (default 2)
+  --compression fast|balanced|smallest
+  --formats F,...                   Formats of formats/: raw-le, raw-be, deflated-le,
+                                    deflated-be, gzipped-le, gzipped-be (default all)
+)";
+
+static void PrintGeneratorError(String const &s) {
+  fprintf(stderr, "nbte-gen: %s\n", (char const *)s.c_str());
+}
+
+static int RunGenerator(int argc, char *argv[]) {
+  using namespace std;
+
+  WorldGenerator::Options options;
+  optional<Path> dir;
+  bool ok = true;
+  for (int i = 1; i < argc && ok; i++) {
+    String arg = ReinterpretAsU8String(argv[i]);
+    if (arg == u8"--help" || arg == u8"-h") {
+      fputs(kGeneratorUsage, stdout);
+      return 0;
+    } else if (!arg.starts_with(u8"--")) {
+      ok = !dir;
+      dir = Path(arg);
+      continue;
+    } else if (i + 1 >= argc) {
+      ok = false;
+      break;
+    }
+    String value = ReinterpretAsU8String(argv[++i]);
+    auto count = ParseNumber<uint64_t>(value, u8"");
+    if (arg == u8"--seed" && count) {
+      options.fSeed = (uint32_t)*count;
+    } else if (arg == u8"--regions" && count) {
+      options.fRegions = (int)min<uint64_t>(*count, 64);
+    } else if (arg == u8"--chunks" && count) {
+      options.fChunksPerRegion = (size_t)*count;
+    } else if (arg == u8"--sections" && count) {
+      options.fSections = (int)min<uint64_t>(*count, 64);
+    } else if (arg == u8"--palette" && count) {
+      options.fPaletteSize = (size_t)*count;
+    } else if (arg == u8"--entities" && count) {
+      options.fEntities = (size_t)*count;
+    } else if (arg == u8"--block-entities" && count) {
+      options.fBlockEntities = (size_t)*count;
+    } else if (arg == u8"--items" && count) {
+      options.fItems = (size_t)min<uint64_t>(*count, 256);
+    } else if (arg == u8"--players" && count) {
+      options.fPlayers = (size_t)*count;
+    } else if (arg == u8"--strings" && count) {
+      options.fVocabulary = (size_t)*count;
+    } else if (arg == u8"--skew") {
+      auto skew = ParseNumber<double>(value, u8"");
+      ok = skew && *skew > 0;
+      options.fSkew = skew.value_or(1);
+    } else if (arg == u8"--compression") {
+      auto profile = ParseSaveProfile(value);
+      ok = profile.has_value();
+      options.fProfile = profile.value_or(SaveProfile::Balanced);
+    } else if (arg == u8"--formats") {
+      options.fFormats.clear();
+      for (size_t begin = 0; begin <= value.size() && ok;) {
+        size_t end = min(value.find(u8',', begin), value.size());
+        auto format = WorldGenerator::ParseFormat(value.substr(begin, end - begin));
+        ok = format.has_value();
+        if (format) {
+          options.fFormats.push_back(*format);
+        }
+        begin = end + 1;
+      }
+    } else {
+      ok = false;
+    }
+  }
+  if (!ok || !dir) {
+    fputs(kGeneratorUsage, stderr);
+    return 2;
+  }
+
+  TaskQueue pool("pool", thread::hardware_concurrency());
+  auto start = chrono::steady_clock::now();
+  if (auto err = WorldGenerator(options).generate(*dir, &pool); !err.empty()) {
+    PrintGeneratorError(err);
+    return 1;
+  }
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  printf("Wrote %d regions in %.3f s\n", options.fRegions * options.fRegions, seconds);
+  return 0;
+}
+
+} // namespace nbte
@@ -0,0 +1,358 @@
+#pragma once
+
+namespace nbte {
+
+// Writes worlds of generated data, laid out like the ones of recent versions of Minecraft, for benchmarks and stress
+// tests. Everything is derived from the seed: each region and file has a random engine of its own seeded from it, so the
+// output is the same whatever order or thread it is written in.
+class WorldGenerator {
+public:
+  struct Options {
+    uint32_t fSeed = 1;
+    // Regions of a square of this size are written, centered on region 0 0.
+    int fRegions = 1;
+    size_t fChunksPerRegion = 1024;
+    int fSections = 24;
+    // Upper bound of the block palette of each section. 1 makes sections of a single block without data.
+    size_t fPaletteSize = 8;
+    // Upper bounds of the lists in each chunk.
+    size_t fEntities = 8;
+    size_t fBlockEntities = 4;
+    size_t fItems = 27;
+    size_t fPlayers = 4;
+    // String values are drawn from this many names. A skew of 1 draws them uniformly, larger ones favor the first ones,
+    // as real worlds are mostly made of a few blocks.
+    size_t fVocabulary = 64;
+    double fSkew = 2;
+    SaveProfile fProfile = SaveProfile::Balanced;
+    // A standalone file is written in each of the formats.
+    std::vector<Compound::Format> fFormats = AllFormats();
+  };
+
+  explicit WorldGenerator(Options const &options) : fOptions(options) {}
+
+  static std::vector<Compound::Format> AllFormats() {
+    return {
+        Compound::Format::RawLittleEndian,
+        Compound::Format::RawBigEndian,
+        Compound::Format::DeflatedLittleEndian,
+        Compound::Format::DeflatedBigEndian,
+        Compound::Format::GzippedLittleEndian,
+        Compound::Format::GzippedBigEndian,
+    };
+  }
+
+  static char8_t const *FormatName(Compound::Format format) {
+    switch (format) {
+    case Compound::Format::RawLittleEndian:
+      return u8"raw-le";
+    case Compound::Format::RawBigEndian:
+      return u8"raw-be";
+    case Compound::Format::DeflatedLittleEndian:
+      return u8"deflated-le";
+    case Compound::Format::DeflatedBigEndian:
+      return u8"deflated-be";
+    case Compound::Format::GzippedLittleEndian:
+      return u8"gzipped-le";
+    case Compound::Format::GzippedBigEndian:
+      return u8"gzipped-be";
+    default:
+      return u8"unknown";
+    }
+  }
+
+  static std::optional<Compound::Format> ParseFormat(String const &name) {
+    for (auto format : AllFormats()) {
+      if (name == FormatName(format)) {
+        return format;
+      }
+    }
+    return std::nullopt;
+  }
+
+  // Writes level.dat, player data, the terrain and entity regions, and a standalone file per format under dir. Regions
+  // are written by the pool when it is given.
+  String generate(Path const &dir, TaskQueue *pool) const {
+    using namespace std;
+    namespace fs = std::filesystem;
+    error_code ec;
+    for (auto sub : {u8"region", u8"entities", u8"playerdata", u8"formats"}) {
+      fs::create_directories(dir / sub, ec);
+      if (ec) {
+        return u8"Can't create directory: " + (dir / sub).u8string();
+      }
+    }
+    if (auto err = writeFile(dir / u8"level.dat", level(), Compound::Format::GzippedBigEndian, pool); !err.empty()) {
+      return err;
+    }
+    for (size_t i = 0; i < fOptions.fPlayers; i++) {
+      auto random = engine(kPlayerStream, (int)i, 0);
+      auto tag = player(random, i);
+      if (auto err = writeFile(dir / u8"playerdata" / (u8"player" + ToString(i) + u8".dat"), tag, Compound::Format::GzippedBigEndian, pool); !err.empty()) {
+        return err;
+      }
+    }
+    for (auto format : fOptions.fFormats) {
+      Path file = dir / u8"formats" / (String(u8"level.") + FormatName(format) + u8".dat");
+      if (auto err = writeFile(file, level(), format, pool); !err.empty()) {
+        return err;
+      }
+    }
+
+    int begin = -fOptions.fRegions / 2;
+    int end = begin + fOptions.fRegions;
+    vector<function<bool()>> jobs;
+    for (int rz = begin; rz < end; rz++) {
+      for (int rx = begin; rx < end; rx++) {
+        String name = ReinterpretAsU8String(mcfile::je::Region::GetDefaultRegionFileName(rx, rz));
+        jobs.push_back([this, file = dir / u8"region" / name, rx, rz]() { return writeRegion(file, rx, rz, false); });
+        jobs.push_back([this, file = dir / u8"entities" / name, rx, rz]() { return writeRegion(file, rx, rz, true); });
+      }
+    }
+    bool ok = true;
+    if (pool) {
+      vector<future<bool>> tasks;
+      for (auto const &job : jobs) {
+        tasks.push_back(pool->enqueue("GenerateRegion", TaskPriority::Normal, job).fFuture);
+      }
+      for (auto &task : tasks) {
+        ok = task.get() && ok;
+      }
+    } else {
+      for (auto const &job : jobs) {
+        ok = job() && ok;
+      }
+    }
+    return ok ? u8"" : u8"Can't write the regions";
+  }
+
+  // Writes fChunksPerRegion chunks spread over the region, or the entities of them when entities is set.
+  bool writeRegion(Path const &file, int rx, int rz, bool entities) const {
+    using namespace std;
+    auto random = engine(entities ? kEntityStream : kChunkStream, rx, rz);
+    size_t count = min<size_t>(fOptions.fChunksPerRegion, 1024);
+    vector<bool> present(1024, false);
+    for (size_t i = 0; i < count; i++) {
+      present[i * 1024 / count] = true;
+    }
+    int level = ParallelDeflate::Level(fOptions.fProfile);
+    auto out = make_shared<mcfile::stream::FileOutputStream>(file);
+    return mcfile::je::Region::SquashChunksAsMca(*out, [&](int x, int z, mcfile::stream::OutputStream &output, bool &stop) {
+      if (!present[Region::Index(x, z)]) {
+        return;
+      }
+      int cx = rx * 32 + x;
+      int cz = rz * 32 + z;
+      auto tag = entities ? entityChunk(random, cx, cz) : chunk(random, cx, cz);
+      vector<uint8_t> buffer;
+      if (!mcfile::nbt::CompoundTag::Write(*tag, buffer, mcfile::Endian::Big) || !ParallelDeflate::Compress(buffer, ParallelDeflate::Container::Zlib, level, nullptr) || !output.write(buffer.data(), buffer.size())) {
+        stop = true;
+      }
+    });
+  }
+
+  std::shared_ptr<mcfile::nbt::CompoundTag> chunk(std::mt19937 &random, int cx, int cz) const {
+    using namespace std;
+    using namespace mcfile::nbt;
+
+    auto chunk = make_shared<CompoundTag>();
+    chunk->set(u8"DataVersion", make_shared<IntTag>(kDataVersion));
+    chunk->set(u8"xPos", make_shared<IntTag>(cx));
+    chunk->set(u8"zPos", make_shared<IntTag>(cz));
+    chunk->set(u8"yPos", make_shared<IntTag>(-4));
+    chunk->set(u8"Status", make_shared<StringTag>(u8"minecraft:full"));
+    chunk->set(u8"LastUpdate", make_shared<LongTag>((int64_t)random()));
+    chunk->set(u8"InhabitedTime", make_shared<LongTag>((int64_t)(random() % 100000)));
+
+    auto sections = make_shared<ListTag>(Tag::Type::Compound);
+    for (int i = 0; i < fOptions.fSections; i++) {
+      auto section = make_shared<CompoundTag>();
+      section->set(u8"Y", make_shared<ByteTag>((uint8_t)(int8_t)(i - 4)));
+
+      size_t paletteSize = 1 + random() % max<size_t>(fOptions.fPaletteSize, 1);
+      auto palette = make_shared<ListTag>(Tag::Type::Compound);
+      for (size_t j = 0; j < paletteSize; j++) {
+        auto block = make_shared<CompoundTag>();
+        block->set(u8"Name", make_shared<StringTag>(name(random, u8"minecraft:block_")));
+        palette->push_back(block);
+      }
+      auto blockStates = make_shared<CompoundTag>();
+      blockStates->set(u8"palette", palette);
+      if (paletteSize > 1) {
+        blockStates->set(u8"data", LongArray(random, 256, paletteSize));
+      }
+      section->set(u8"block_states", blockStates);
+
+      auto biomePalette = make_shared<ListTag>(Tag::Type::String);
+      biomePalette->push_back(make_shared<StringTag>(name(random, u8"minecraft:biome_")));
+      auto biomes = make_shared<CompoundTag>();
+      biomes->set(u8"palette", biomePalette);
+      section->set(u8"biomes", biomes);
+
+      section->set(u8"BlockLight", ByteArray(random, 2048, 0x00));
+      section->set(u8"SkyLight", ByteArray(random, 2048, 0xff));
+      sections->push_back(section);
+    }
+    chunk->set(u8"sections", sections);
+
+    auto heightmaps = make_shared<CompoundTag>();
+    for (auto key : {u8"MOTION_BLOCKING", u8"MOTION_BLOCKING_NO_LEAVES", u8"OCEAN_FLOOR", u8"WORLD_SURFACE"}) {
+      heightmaps->set(key, LongArray(random, 37, 16));
+    }
+    chunk->set(u8"Heightmaps", heightmaps);
+
+    auto blockEntities = make_shared<ListTag>(Tag::Type::Compound);
+    for (size_t i = 0, count = random() % (fOptions.fBlockEntities + 1); i < count; i++) {
+      auto entity = make_shared<CompoundTag>();
+      entity->set(u8"id", make_shared<StringTag>(u8"minecraft:chest"));
+      entity->set(u8"x", make_shared<IntTag>(cx * 16 + (int)(random() % 16)));
+      entity->set(u8"y", make_shared<IntTag>((int)(random() % 64)));
+      entity->set(u8"z", make_shared<IntTag>(cz * 16 + (int)(random() % 16)));
+      entity->set(u8"Items", items(random, random() % (fOptions.fItems + 1)));
+      blockEntities->push_back(entity);
+    }
+    chunk->set(u8"block_entities", blockEntities);
+    return chunk;
+  }
+
+  // A chunk of the entities/ regions.
+  std::shared_ptr<mcfile::nbt::CompoundTag> entityChunk(std::mt19937 &random, int cx, int cz) const {
+    using namespace std;
+    using namespace mcfile::nbt;
+    auto chunk = make_shared<CompoundTag>();
+    chunk->set(u8"DataVersion", make_shared<IntTag>(kDataVersion));
+    auto position = make_shared<IntArrayTag>();
+    position->fValue = {cx, cz};
+    chunk->set(u8"Position", position);
+    auto entities = make_shared<ListTag>(Tag::Type::Compound);
+    for (size_t i = 0, count = random() % (fOptions.fEntities + 1); i < count; i++) {
+      auto entity = make_shared<CompoundTag>();
+      entity->set(u8"id", make_shared<StringTag>(name(random, u8"minecraft:entity_")));
+      entity->set(u8"Pos", DoubleList(random, {cx * 16.0, 64.0, cz * 16.0}, 16));
+      entity->set(u8"Motion", DoubleList(random, {0, 0, 0}, 1));
+      auto rotation = make_shared<ListTag>(Tag::Type::Float);
+      rotation->push_back(make_shared<FloatTag>((float)(random() % 360)));
+      rotation->push_back(make_shared<FloatTag>((float)(random() % 180) - 90));
+      entity->set(u8"Rotation", rotation);
+      entity->set(u8"Health", make_shared<FloatTag>((float)(1 + random() % 20)));
+      entity->set(u8"OnGround", make_shared<ByteTag>((uint8_t)(random() % 2)));
+      auto uuid = make_shared<IntArrayTag>();
+      uuid->fValue = {(int32_t)random(), (int32_t)random(), (int32_t)random(), (int32_t)random()};
+      entity->set(u8"UUID", uuid);
+      entities->push_back(entity);
+    }
+    chunk->set(u8"Entities", entities);
+    return chunk;
+  }
+
+  std::shared_ptr<mcfile::nbt::CompoundTag> level() const {
+    using namespace std;
+    using namespace mcfile::nbt;
+    auto random = engine(kLevelStream, 0, 0);
+    auto data = make_shared<CompoundTag>();
+    data->set(u8"LevelName", make_shared<StringTag>(u8"generated"));
+    data->set(u8"DataVersion", make_shared<IntTag>(kDataVersion));
+    data->set(u8"RandomSeed", make_shared<LongTag>((int64_t)fOptions.fSeed));
+    data->set(u8"Time", make_shared<LongTag>((int64_t)random()));
+    auto players = make_shared<ListTag>(Tag::Type::Compound);
+    for (size_t i = 0; i < fOptions.fPlayers; i++) {
+      players->push_back(player(random, i));
+    }
+    data->set(u8"Players", players);
+    auto root = make_shared<CompoundTag>();
+    root->set(u8"Data", data);
+    return root;
+  }
+
+  std::shared_ptr<mcfile::nbt::CompoundTag> player(std::mt19937 &random, size_t index) const {
+    using namespace std;
+    using namespace mcfile::nbt;
+    auto player = make_shared<CompoundTag>();
+    player->set(u8"Name", make_shared<StringTag>(u8"player" + ToString(index)));
+    player->set(u8"Pos", DoubleList(random, {0, 64, 0}, 10000));
+    player->set(u8"Health", make_shared<FloatTag>((float)(random() % 20)));
+    player->set(u8"Inventory", items(random, fOptions.fItems));
+    player->set(u8"EnderItems", items(random, fOptions.fItems));
+    return player;
+  }
+
+private:
+  static constexpr int kDataVersion = 3465;
+
+  // Separates the random engines of different kinds of data at the same coordinates.
+  enum Stream : uint32_t {
+    kChunkStream = 1,
+    kEntityStream,
+    kPlayerStream,
+    kLevelStream,
+  };
+
+  std::mt19937 engine(Stream stream, int x, int z) const {
+    std::seed_seq seq{fOptions.fSeed, (uint32_t)stream, (uint32_t)x, (uint32_t)z};
+    return std::mt19937(seq);
+  }
+
+  String name(std::mt19937 &random, String const &prefix) const {
+    size_t vocabulary = std::max<size_t>(fOptions.fVocabulary, 1);
+    double u = (double)random() / ((double)std::mt19937::max() + 1);
+    size_t index = std::min(vocabulary - 1, (size_t)(vocabulary * std::pow(u, fOptions.fSkew)));
+    return prefix + ToString(index);
+  }
+
+  std::shared_ptr<mcfile::nbt::ListTag> items(std::mt19937 &random, size_t count) const {
+    using namespace std;
+    using namespace mcfile::nbt;
+    auto items = make_shared<ListTag>(Tag::Type::Compound);
+    for (size_t i = 0; i < count; i++) {
+      auto item = make_shared<CompoundTag>();
+      item->set(u8"Slot", make_shared<ByteTag>((uint8_t)i));
+      item->set(u8"id", make_shared<StringTag>(name(random, u8"minecraft:item_")));
+      item->set(u8"Count", make_shared<ByteTag>((uint8_t)(1 + random() % 64)));
+      items->push_back(item);
+    }
+    return items;
+  }
+
+  // Packs 4 bit entries, each below alphabet.
+  static std::shared_ptr<mcfile::nbt::LongArrayTag> LongArray(std::mt19937 &random, size_t size, size_t alphabet) {
+    auto ret = std::make_shared<mcfile::nbt::LongArrayTag>();
+    ret->fValue.resize(size);
+    for (auto &v : ret->fValue) {
+      uint64_t packed = 0;
+      for (int shift = 0; shift < 64; shift += 4) {
+        packed |= (uint64_t)(random() % std::min<size_t>(alphabet, 16)) << shift;
+      }
+      v = (int64_t)packed;
+    }
+    return ret;
+  }
+
+  // Mostly fill, with a few random bytes.
+  static std::shared_ptr<mcfile::nbt::ByteArrayTag> ByteArray(std::mt19937 &random, size_t size, uint8_t fill) {
+    auto ret = std::make_shared<mcfile::nbt::ByteArrayTag>();
+    ret->fValue.assign(size, fill);
+    for (size_t i = 0; i < size / 16; i++) {
+      ret->fValue[random() % size] = (uint8_t)random();
+    }
+    return ret;
+  }
+
+  static std::shared_ptr<mcfile::nbt::ListTag> DoubleList(std::mt19937 &random, std::array<double, 3> const &center, int spread) {
+    auto ret = std::make_shared<mcfile::nbt::ListTag>(mcfile::nbt::Tag::Type::Double);
+    for (double v : center) {
+      ret->push_back(std::make_shared<mcfile::nbt::DoubleTag>(v + (double)(int)(random() % (2 * spread + 1)) - spread));
+    }
+    return ret;
+  }
+
+  String writeFile(Path const &file, std::shared_ptr<mcfile::nbt::CompoundTag> const &tag, Compound::Format format, TaskQueue *pool) const {
+    if (auto err = Compound::Write(*tag, format, file, fOptions.fProfile, pool); !err.empty()) {
+      return file.u8string() + u8": " + err;
+    }
+    return u8"";
+  }
+
+  Options const fOptions;
+};
+
+} // namespace nbte
@@ -3,6 +3,10 @@
 #include <optional>
 #include <string>
 #include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
 #include "texture.hpp"
 #include "string.hpp"
 #include "filter-key.hpp"
@@ -10,26 +14,118 @@
 
 namespace nbte {
 
+// Match spans of a label against the current filter key, as horizontal pixel ranges relative to the text origin.
+class HighlightCache {
+public:
+  static constexpr size_t kMaxEntries = 64 * 1024;
+
+  std::vector<std::pair<float, float>> const &spans(String const &text, FilterKey const &key) {
+    ImGuiContext &g = *GImGui;
+    if (!(fKey == key) || fFont != g.Font || fFontSize != g.FontSize || fEntries.size() >= kMaxEntries) {
+      fEntries.clear();
+      fKey = key;
+      fFont = g.Font;
+      fFontSize = g.FontSize;
+    }
+    if (auto found = fEntries.find(text); found != fEntries.end()) {
+      return found->second;
+    }
+    auto &spans = fEntries[text];
+    String lowered;
+    if (!key.fCaseSensitive) {
+      lowered = ToLower(text);
+    }
+    String const &target = key.fCaseSensitive ? text : lowered;
+    char const *begin = (char const *)text.c_str();
+    size_t pivot = 0;
+    while (true) {
+      size_t found = target.find(key.fSearch, pivot);
+      if (found == String::npos) {
+        break;
+      }
+      // CalcTextSize rounds the width up, so widths of segments don't add up to the width of the text. Prefixes are
+      // measured instead, the same as the text is laid out from its start.
+      float start = im::CalcTextSize(begin, begin + found).x;
+      float end = im::CalcTextSize(begin, begin + found + key.fSearch.size()).x;
+      spans.push_back(std::make_pair(start, end));
+      pivot = found + key.fSearch.size();
+    }
+    return spans;
+  }
+
+  void invalidate() {
+    fEntries.clear();
+  }
+
+private:
+  FilterKey fKey = FilterKey({}, true);
+  ImFont *fFont = nullptr;
+  float fFontSize = 0;
+  std::unordered_map<String, std::vector<std::pair<float, float>>> fEntries;
+};
+
+static HighlightCache sHighlightCache;
+
+static std::vector<bool> sGlyphRequested(IM_UNICODE_CODEPOINT_MAX + 1, false);
+static std::vector<ImWchar> sRequestedGlyphs;
+
+void RequestGlyphs(char const *begin, char const *end) {
+  char const *p = begin;
+  while (p < end) {
+    // ASCII is always in the base glyph ranges.
+    if ((unsigned char)*p < 0x80) {
+      p++;
+      continue;
+    }
+    unsigned int c = 0;
+    int length = ImTextCharFromUtf8(&c, p, end);
+    p += length > 0 ? length : 1;
+    if (c > IM_UNICODE_CODEPOINT_MAX || sGlyphRequested[c]) {
+      continue;
+    }
+    // Code points the font doesn't have stay in sGlyphRequested, so they are never requested twice.
+    sGlyphRequested[c] = true;
+    if (ImFont *font = im::GetFont(); font && font->FindGlyphNoFallback((ImWchar)c)) {
+      continue;
+    }
+    sRequestedGlyphs.push_back((ImWchar)c);
+  }
+}
+
+void Text(char const *format, ...) {
+  char buffer[1024];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length < 0) {
+    return;
+  }
+  char const *end = buffer + std::min<size_t>((size_t)length, sizeof(buffer) - 1);
+  RequestGlyphs(buffer, end);
+  im::TextUnformatted(buffer, end);
+}
+
+bool TakeRequestedGlyphs(std::vector<ImWchar> &out) {
+  if (sRequestedGlyphs.empty()) {
+    return false;
+  }
+  out.insert(out.end(), sRequestedGlyphs.begin(), sRequestedGlyphs.end());
+  sRequestedGlyphs.clear();
+  // The atlas is about to be rebuilt with new glyphs, which changes text widths.
+  sHighlightCache.invalidate();
+  return true;
+}
+
 static void RenderTextHighlighted(ImVec2 textPos, String const &text, FilterKey const *key) {
   ImGuiContext &g = *GImGui;
   ImGuiWindow *window = g.CurrentWindow;
   ImGuiStyle const &style = g.Style;
 
   if (key) {
-    String target = key->fCaseSensitive ? text : ToLower(text);
-    auto cursor = window->DC.CursorPos;
     auto color = im::GetColorU32(ImGuiCol_Button);
-    size_t pivot = 0;
-    while (true) {
-      size_t found = target.find(key->fSearch, pivot);
-      if (found == String::npos) {
-        break;
-      } else {
-        auto leading = CalcTextSize(text.substr(0, found));
-        auto trailing = CalcTextSize(text.substr(0, found + key->fSearch.size()));
-        window->DrawList->AddRectFilled(ImVec2(textPos.x + leading.x, textPos.y + style.FramePadding.y), ImVec2(textPos.x + trailing.x, textPos.y + style.FramePadding.y + trailing.y), color, 2.0f);
-        pivot = found + key->fSearch.size();
-      }
+    for (auto const &span : sHighlightCache.spans(text, *key)) {
+      window->DrawList->AddRectFilled(ImVec2(textPos.x + span.first, textPos.y + style.FramePadding.y), ImVec2(textPos.x + span.second, textPos.y + style.FramePadding.y + g.FontSize), color, 2.0f);
     }
   }
   RenderText(textPos, text);
@@ -56,6 +152,7 @@ TreeNodeResult TreeNode(String const &label, ImGuiTreeNodeFlags flags, TreeNodeO
   TreeNodeResult r;
   r.opened = true;
   r.buttonActivated = false;
+  r.contextMenuRequested = false;
 
   if (opt.disable) {
     r.opened = false;
@@ -88,6 +185,7 @@ TreeNodeResult TreeNode(String const &label, ImGuiTreeNodeFlags flags, TreeNodeO
       hovered = false;
       held = false;
     }
+    r.contextMenuRequested = hovered && im::IsMouseReleased(ImGuiMouseButton_Right);
     if (toggled && !opt.openIgnoringStorage) {
       r.opened = !r.opened;
       window->DC.StateStorage->SetInt(id, r.opened ? 1 : 0);
@@ -132,7 +230,7 @@ TreeNodeResult TreeNode(String const &label, ImGuiTreeNodeFlags flags, TreeNodeO
     if (opt.icon) {
       ImVec2 iconSize(opt.icon->fWidth, opt.icon->fHeight);
       ImVec2 p(pos.x + labelSpacing, pos.y + frameHeight * 0.5f - iconSize.y * 0.5f);
-      window->DrawList->AddImage((ImTextureID)(intptr_t)opt.icon->fTexture, p, p + iconSize);
+      window->DrawList->AddImage(im::GetIO().Fonts->TexID, p, p + iconSize, opt.icon->fUv0, opt.icon->fUv1);
       window->DC.CursorPos = ImVec2(pos.x + iconSize.x + style.FramePadding.x, pos.y);
       textPos = ImVec2(pos.x + labelSpacing + iconSize.x + padding.x, pos.y + padding.y);
     } else {
@@ -141,6 +239,13 @@ TreeNodeResult TreeNode(String const &label, ImGuiTreeNodeFlags flags, TreeNodeO
 
     RenderTextHighlighted(textPos, label, opt.filter);
 
+    if (opt.badge) {
+      auto badgeSize = CalcTextSize(*opt.badge);
+      im::PushStyleColor(ImGuiCol_Text, style.Colors[ImGuiCol_TextDisabled]);
+      RenderText(ImVec2(bb.Max.x - badgeSize.x - padding.x, pos.y + padding.y), *opt.badge);
+      im::PopStyleColor();
+    }
+
     if (opt.button) {
       window->DC.CursorPos = ImVec2(pos.x + regionAvail.x - buttonWidthWithPadding + padding.x, pos.y);
       r.buttonActivated = Button(*opt.button, ImVec2(buttonWidthWithPadding - padding.x, frameHeight));
@@ -167,7 +272,7 @@ void InlineImage(Texture const &image) {
   float const frameHeight = im::GetFrameHeight();
   ImVec2 imagePos(pos.x, pos.y + frameHeight * 0.5f - image.fHeight * 0.5f);
   ImVec2 imageSize(image.fWidth, image.fHeight);
-  window->DrawList->AddImage((ImTextureID)(intptr_t)image.fTexture, imagePos, imagePos + imageSize);
+  window->DrawList->AddImage(im::GetIO().Fonts->TexID, imagePos, imagePos + imageSize, image.fUv0, image.fUv1);
   window->DC.CursorPos = ImVec2(pos.x + image.fWidth, pos.y);
 }
 
@@ -200,6 +305,7 @@ void IconLabel(String const &label, std::optional<Texture> icon) {
 }
 
 void RenderText(ImVec2 pos, String const &text, bool hide_text_after_hash) {
+  RequestGlyphs(text);
   return im::RenderText(pos, (char const *)text.c_str(), 0, hide_text_after_hash);
 }
 
@@ -222,7 +328,9 @@ bool InputText(String const &label, String *text, ImGuiInputTextFlags flags) {
   IM_ASSERT((flags & ImGuiInputTextFlags_CallbackResize) == 0);
   flags |= ImGuiInputTextFlags_CallbackResize;
 
-  return im::InputText((char const *)label.c_str(), (char *)text->c_str(), text->capacity() + 1, flags, InputTextCallback, text);
+  bool changed = im::InputText((char const *)label.c_str(), (char *)text->c_str(), text->capacity() + 1, flags, InputTextCallback, text);
+  RequestGlyphs(*text);
+  return changed;
 }
 
 void TextHighlighted(String const &text, FilterKey const *key) {
@@ -13,12 +13,15 @@ struct TreeNodeOptions {
   std::optional<Texture> icon = std::nullopt;
   FilterKey const *filter = nullptr;
   std::optional<String> button;
+  // Drawn right-aligned in the disabled text color.
+  std::optional<String> badge;
   std::optional<ImU32> headerBackground;
 };
 
 struct TreeNodeResult {
   bool opened;
   bool buttonActivated;
+  bool contextMenuRequested;
 };
 
 TreeNodeResult TreeNode(String const &label, ImGuiTreeNodeFlags flags, TreeNodeOptions options = {});
@@ -35,6 +38,19 @@ bool InputText(String const &label, String *text, ImGuiInputTextFlags flags = 0)
 
 void TextHighlighted(String const &text, FilterKey const *key);
 
+// The font atlas starts with a small set of glyphs. Text rendered through the wrappers below reports code points
+// missing from the atlas, and FontAtlas picks them up between frames with TakeRequestedGlyphs.
+void RequestGlyphs(char const *begin, char const *end);
+
+inline void RequestGlyphs(String const &text) {
+  RequestGlyphs((char const *)text.data(), (char const *)text.data() + text.size());
+}
+
+bool TakeRequestedGlyphs(std::vector<ImWchar> &out);
+
+// Formatted like im::Text. Longer text is cut at 1 KiB.
+void Text(char const *format, ...) IM_FMTARGS(1);
+
 inline ImVec2 CalcTextSize(String const &t) {
   return im::CalcTextSize((char const *)t.c_str());
 }
@@ -44,6 +60,7 @@ inline void TreePush(String const &label) {
 }
 
 inline void TextUnformatted(String const &text) {
+  RequestGlyphs(text);
   im::TextUnformatted((char const *)text.c_str());
 }
 
@@ -52,26 +69,42 @@ inline void OpenPopup(String const &id) {
 }
 
 inline bool BeginPopupModal(String const &id, bool *open, ImGuiWindowFlags flags = 0) {
+  RequestGlyphs(id);
   return im::BeginPopupModal((char const *)id.c_str(), open, flags);
 }
 
+inline bool BeginPopup(String const &id, ImGuiWindowFlags flags = 0) {
+  return im::BeginPopup((char const *)id.c_str(), flags);
+}
+
 inline void TextWrapped(String const &s) {
+  RequestGlyphs(s);
   im::TextWrapped("%s", (char const *)s.c_str());
 }
 
 inline bool BeginMenu(String const &id, bool enable = true) {
+  RequestGlyphs(id);
   return im::BeginMenu((char const *)id.c_str(), enable);
 }
 
 inline bool MenuItem(String const &label, String const &shortcut, bool *p_selected, bool enabled = true) {
+  RequestGlyphs(label);
+  RequestGlyphs(shortcut);
   return im::MenuItem((char const *)label.c_str(), shortcut.empty() ? 0 : (char const *)shortcut.c_str(), p_selected, enabled);
 }
 
+inline bool Selectable(String const &label, bool selected = false, ImGuiSelectableFlags flags = 0) {
+  RequestGlyphs(label);
+  return im::Selectable((char const *)label.c_str(), selected, flags);
+}
+
 inline bool Button(String const &id, ImVec2 size = ImVec2(0, 0)) {
+  RequestGlyphs(id);
   return im::Button((char const *)id.c_str(), size);
 }
 
 inline bool InputInt(String const &label, int *v, ImGuiInputTextFlags flags = 0) {
+  RequestGlyphs(label);
   return im::InputInt((char const *)label.c_str(), v, 1, 100, flags);
 }
 
@@ -80,18 +113,22 @@ inline void PushID(String const &id) {
 }
 
 inline bool InputFloat(String const &label, float *v) {
+  RequestGlyphs(label);
   return im::InputFloat((char const *)label.c_str(), v);
 }
 
 inline bool InputDouble(String const &label, double *v) {
+  RequestGlyphs(label);
   return im::InputDouble((char const *)label.c_str(), v);
 }
 
 inline void SetTooltip(String const &label) {
+  RequestGlyphs(label);
   im::SetTooltip("%s", (char const *)label.c_str());
 }
 
 inline bool Begin(String const &label, bool *p_open = 0, ImGuiWindowFlags flags = 0) {
+  RequestGlyphs(label);
   return im::Begin((char const *)label.c_str(), p_open, flags);
 }
 
@@ -100,7 +137,23 @@ inline bool BeginChild(String const &label, ImVec2 size = ImVec2(0, 0), bool bor
 }
 
 inline void BulletText(String const &text) {
+  RequestGlyphs(text);
   im::BulletText("%s", (char const *)text.c_str());
 }
 
+inline bool Checkbox(String const &label, bool *v) {
+  RequestGlyphs(label);
+  return im::Checkbox((char const *)label.c_str(), v);
+}
+
+inline bool RadioButton(String const &label, int *v, int button) {
+  RequestGlyphs(label);
+  return im::RadioButton((char const *)label.c_str(), v, button);
+}
+
+inline void TableSetupColumn(String const &label, ImGuiTableColumnFlags flags = 0) {
+  RequestGlyphs(label);
+  im::TableSetupColumn((char const *)label.c_str(), flags);
+}
+
 } // namespace nbte
@@ -0,0 +1,223 @@
+#pragma once
+
+namespace nbte {
+
+// Records the input events fed to ImGui frame by frame, and the files opened outside of ImGui in dialogs or by the OS, so
+// that a session can be replayed without a window by nbte-frame-bench. Sessions are text, a line per frame followed by a
+// line per event. Key codes are the ImGuiKey values of the build that recorded them.
+class InputRecorder {
+public:
+  static constexpr size_t kMaxLines = 4 * 1024 * 1024;
+
+  struct Frame {
+    // Seconds since the recording started.
+    double fTime = 0;
+    float fDeltaTime = 0;
+    ImVec2 fDisplaySize;
+    std::vector<ImGuiInputEvent> fEvents;
+    // Opened during the frame, after the events.
+    std::vector<std::pair<Path, bool>> fOpened;
+  };
+
+  struct Session {
+    // Opened when the recording started.
+    std::vector<std::pair<Path, bool>> fOpened;
+    std::vector<Frame> fFrames;
+  };
+
+  bool enabled() const {
+    return fEnabled;
+  }
+
+  // Called during a frame, when the events of the frame have been taken by ImGui already.
+  void start() {
+    fLines.clear();
+    fFrames = 0;
+    fOrigin = std::chrono::steady_clock::now();
+    fTaken = GImGui->InputEventsQueue.Size;
+    fEnabled = true;
+  }
+
+  void stop() {
+    fEnabled = false;
+  }
+
+  size_t frames() const {
+    return fFrames;
+  }
+
+  // Must be called right before ImGui::NewFrame, once the backends have queued the events of the frame.
+  void capture() {
+    using namespace std;
+    if (!fEnabled) {
+      return;
+    }
+    ImGuiContext &g = *GImGui;
+    char line[128];
+    double time = chrono::duration<double>(chrono::steady_clock::now() - fOrigin).count();
+    snprintf(line, sizeof(line), "frame %.6f %.6f %.1f %.1f", time, g.IO.DeltaTime, g.IO.DisplaySize.x, g.IO.DisplaySize.y);
+    add(line);
+    fFrames++;
+    // Events spread over the next frames by ImGui are left in the queue, and were recorded with the frame they came in.
+    for (int i = std::min(fTaken, g.InputEventsQueue.Size); i < g.InputEventsQueue.Size; i++) {
+      ImGuiInputEvent const &e = g.InputEventsQueue[i];
+      switch (e.Type) {
+      case ImGuiInputEventType_MousePos:
+        snprintf(line, sizeof(line), "mouse-pos %.1f %.1f", e.MousePos.PosX, e.MousePos.PosY);
+        break;
+      case ImGuiInputEventType_MouseWheel:
+        snprintf(line, sizeof(line), "mouse-wheel %.3f %.3f", e.MouseWheel.WheelX, e.MouseWheel.WheelY);
+        break;
+      case ImGuiInputEventType_MouseButton:
+        snprintf(line, sizeof(line), "mouse-button %d %d", e.MouseButton.Button, e.MouseButton.Down ? 1 : 0);
+        break;
+      case ImGuiInputEventType_Key:
+        snprintf(line, sizeof(line), "key %d %d %.3f", (int)e.Key.Key, e.Key.Down ? 1 : 0, e.Key.AnalogValue);
+        break;
+      case ImGuiInputEventType_Text:
+        snprintf(line, sizeof(line), "text %u", e.Text.Char);
+        break;
+      case ImGuiInputEventType_Focus:
+        snprintf(line, sizeof(line), "focus %d", e.AppFocused.Focused ? 1 : 0);
+        break;
+      default:
+        continue;
+      }
+      add(line);
+    }
+  }
+
+  // Must be called right after ImGui::NewFrame.
+  void captured() {
+    fTaken = GImGui->InputEventsQueue.Size;
+  }
+
+  void opened(Path const &path, bool directory) {
+    if (fEnabled) {
+      add((directory ? "open-directory " : "open ") + std::string((char const *)path.u8string().c_str()));
+    }
+  }
+
+  bool write(Path const &file) const {
+    FILE *fp = OpenFileStream(file, u8"wb");
+    if (!fp) {
+      return false;
+    }
+    fputs("nbte-session 1\n", fp);
+    for (auto const &line : fLines) {
+      fputs(line.c_str(), fp);
+      fputc('\n', fp);
+    }
+    return fclose(fp) == 0;
+  }
+
+  static std::optional<Session> Read(Path const &file) {
+    using namespace std;
+    ifstream in(file, ios::binary);
+    string line;
+    if (!getline(in, line) || line != "nbte-session 1") {
+      return nullopt;
+    }
+    Session session;
+    auto &frames = session.fFrames;
+    while (getline(in, line)) {
+      size_t space = line.find(' ');
+      string type = line.substr(0, space);
+      string rest = space == string::npos ? string() : line.substr(space + 1);
+      if (type == "frame") {
+        Frame frame;
+        if (sscanf(rest.c_str(), "%lf %f %f %f", &frame.fTime, &frame.fDeltaTime, &frame.fDisplaySize.x, &frame.fDisplaySize.y) != 4) {
+          return nullopt;
+        }
+        frames.push_back(std::move(frame));
+        continue;
+      }
+      if (type == "open" || type == "open-directory") {
+        auto &opened = frames.empty() ? session.fOpened : frames.back().fOpened;
+        opened.push_back(make_pair(Path(ReinterpretAsU8String(rest)), type == "open-directory"));
+        continue;
+      }
+      if (frames.empty()) {
+        return nullopt;
+      }
+      Frame &frame = frames.back();
+      ImGuiInputEvent e{};
+      int a = 0;
+      int b = 0;
+      int matched = 0;
+      if (type == "mouse-pos") {
+        e.Type = ImGuiInputEventType_MousePos;
+        matched = sscanf(rest.c_str(), "%f %f", &e.MousePos.PosX, &e.MousePos.PosY) == 2;
+      } else if (type == "mouse-wheel") {
+        e.Type = ImGuiInputEventType_MouseWheel;
+        matched = sscanf(rest.c_str(), "%f %f", &e.MouseWheel.WheelX, &e.MouseWheel.WheelY) == 2;
+      } else if (type == "mouse-button") {
+        e.Type = ImGuiInputEventType_MouseButton;
+        matched = sscanf(rest.c_str(), "%d %d", &a, &b) == 2;
+        e.MouseButton.Button = a;
+        e.MouseButton.Down = b != 0;
+      } else if (type == "key") {
+        e.Type = ImGuiInputEventType_Key;
+        matched = sscanf(rest.c_str(), "%d %d %f", &a, &b, &e.Key.AnalogValue) == 3;
+        e.Key.Key = (ImGuiKey)a;
+        e.Key.Down = b != 0;
+      } else if (type == "text") {
+        e.Type = ImGuiInputEventType_Text;
+        matched = sscanf(rest.c_str(), "%u", &e.Text.Char) == 1;
+      } else if (type == "focus") {
+        e.Type = ImGuiInputEventType_Focus;
+        matched = sscanf(rest.c_str(), "%d", &a) == 1;
+        e.AppFocused.Focused = a != 0;
+      }
+      if (!matched) {
+        return nullopt;
+      }
+      frame.fEvents.push_back(e);
+    }
+    return session;
+  }
+
+  // Queues a recorded event as the backend queued it.
+  static void Feed(ImGuiIO &io, ImGuiInputEvent const &e) {
+    switch (e.Type) {
+    case ImGuiInputEventType_MousePos:
+      io.AddMousePosEvent(e.MousePos.PosX, e.MousePos.PosY);
+      break;
+    case ImGuiInputEventType_MouseWheel:
+      io.AddMouseWheelEvent(e.MouseWheel.WheelX, e.MouseWheel.WheelY);
+      break;
+    case ImGuiInputEventType_MouseButton:
+      io.AddMouseButtonEvent(e.MouseButton.Button, e.MouseButton.Down);
+      break;
+    case ImGuiInputEventType_Key:
+      io.AddKeyAnalogEvent(e.Key.Key, e.Key.Down, e.Key.AnalogValue);
+      break;
+    case ImGuiInputEventType_Text:
+      io.AddInputCharacter(e.Text.Char);
+      break;
+    case ImGuiInputEventType_Focus:
+      io.AddFocusEvent(e.AppFocused.Focused);
+      break;
+    default:
+      break;
+    }
+  }
+
+private:
+  void add(std::string const &line) {
+    if (fLines.size() >= kMaxLines) {
+      // Stops by itself, like the tracer.
+      fEnabled = false;
+      return;
+    }
+    fLines.push_back(line);
+  }
+
+  bool fEnabled = false;
+  std::chrono::steady_clock::time_point fOrigin;
+  std::vector<std::string> fLines;
+  size_t fFrames = 0;
+  int fTaken = 0;
+};
+
+} // namespace nbte
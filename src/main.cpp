@@ -7,6 +7,7 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include "imgui_stdlib.h"
+#include "imgui_internal.h"
 #include <stdio.h>
 #if defined(IMGUI_IMPL_OPENGL_ES2)
 #include <GLES2/gl2.h>
@@ -19,32 +20,70 @@
 #define NOMINMAX
 #include <windows.h>
 #include <shlobj_core.h>
+#include <io.h>
 
-#include <hwm/task/task_queue.hpp>
 #include <minecraft-file.hpp>
 #include <nfd.h>
 extern "C" {
 #include <uuid4.h>
 }
 #include <variant>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <thread>
 #include <list>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <fstream>
+#include <mutex>
+#include <ctime>
+#include <deque>
+#include <shared_mutex>
+#include <string_view>
 
 #include "version.hpp"
 #include "string.hpp"
+#include "file-system.hpp"
 #include "texture.hpp"
 #include "platform.hpp"
 #include "texture-set.hpp"
 #include "temporary-directory.hpp"
+#include "tracer.hpp"
+#include "task-queue.hpp"
+#include "completion-queue.hpp"
+#include "deflate.hpp"
+#include "profiler.hpp"
 #include "filter-key.hpp"
+#include "imgui-ext.hpp"
+#include "font-atlas.hpp"
+#include "input-recorder.hpp"
+#include "model/node-arena.hpp"
+#include "model/key-table.hpp"
+#include "model/blob-pool.hpp"
+#include "model/tape.hpp"
+#include "model/node-size.hpp"
 #include "model/node.hpp"
+#include "model/memory-budget.hpp"
+#include "model/edit-journal.hpp"
+#include "model/nbt-value.hpp"
+#include "model/region-file.hpp"
+#include "model/region-compactor.hpp"
+#include "model/region-scanner.hpp"
 #include "filter-cache.hpp"
 #include "model/node.impl.hpp"
 #include "model/directory-contents.impl.hpp"
 #include "model/compound.impl.hpp"
+#include "model/save-snapshot.hpp"
 #include "model/state.hpp"
 #include "model/region.impl.hpp"
-#include "imgui-ext.hpp"
+#include "model/edit-journal.impl.hpp"
 #include "render/legal.hpp"
+#include "render/profiler.hpp"
+#include "render/largest-items.hpp"
+#include "render/compaction-report.hpp"
+#include "render/scan-report.hpp"
 #include "render/render.hpp"
 
 #pragma comment(lib, "opengl32.lib")
@@ -129,26 +168,6 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 
   NFD_Init();
 
-  if (auto udevFont = nbte::LoadNamedResource("UDEVGothic35_Regular.ttf"); udevFont) {
-    ImFontConfig cfg;
-    cfg.FontDataOwnedByAtlas = false;
-    assert(udevFont->fSystemOwned);
-
-    ImVector<ImWchar> ranges;
-    ImFontGlyphRangesBuilder builder;
-    builder.AddRanges(io.Fonts->GetGlyphRangesKorean());
-    builder.AddRanges(io.Fonts->GetGlyphRangesJapanese());
-    builder.AddRanges(io.Fonts->GetGlyphRangesChineseFull());
-    builder.AddRanges(io.Fonts->GetGlyphRangesChineseSimplifiedCommon());
-    builder.AddRanges(io.Fonts->GetGlyphRangesCyrillic());
-    builder.AddRanges(io.Fonts->GetGlyphRangesThai());
-    builder.AddRanges(io.Fonts->GetGlyphRangesVietnamese());
-    builder.BuildRanges(&ranges);
-
-    ImFont *font = io.Fonts->AddFontFromMemoryTTF(udevFont->fData, udevFont->fSize, 15.0f, &cfg, ranges.Data);
-    io.Fonts->Build();
-  }
-
   uuid4_init();
 
   nbte::State state;
@@ -162,7 +181,7 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     }
   }
 
-  state.loadTextures(nullptr);
+  state.loadTextures(*io.Fonts);
 
   // Main loop
   bool done = false;
@@ -175,10 +194,17 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     glfwPollEvents();
     glfwSetWindowTitle(window, (char const *)state.winowTitle().c_str());
 
+    if (state.updateTextures(*io.Fonts)) {
+      ImGui_ImplOpenGL3_DestroyFontsTexture();
+      ImGui_ImplOpenGL3_CreateFontsTexture();
+    }
+
     // Start the Dear ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
+    state.fRecorder.capture();
     ImGui::NewFrame();
+    state.fRecorder.captured();
 
     int display_w, display_h;
     glfwGetFramebufferSize(window, &display_w, &display_h);
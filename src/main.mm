@@ -12,35 +12,76 @@
 #include "imgui_impl_metal.h"
 #include "imgui_impl_osx.h"
 #include "imgui_stdlib.h"
+#include "imgui_internal.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#include <hwm/task/task_queue.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <minecraft-file.hpp>
 #include <nfd.h>
 extern "C" {
 #include <uuid4.h>
 }
 #include <variant>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <thread>
 #include <list>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <fstream>
+#include <mutex>
+#include <ctime>
+#include <deque>
+#include <shared_mutex>
+#include <string_view>
 
 #include "version.hpp"
 #include "string.hpp"
+#include "file-system.hpp"
 #include "texture.hpp"
 #include "platform.hpp"
 #include "texture-set.hpp"
 #include "temporary-directory.hpp"
+#include "tracer.hpp"
+#include "task-queue.hpp"
+#include "completion-queue.hpp"
+#include "deflate.hpp"
+#include "profiler.hpp"
 #include "filter-key.hpp"
+#include "imgui-ext.hpp"
+#include "font-atlas.hpp"
+#include "input-recorder.hpp"
+#include "model/node-arena.hpp"
+#include "model/key-table.hpp"
+#include "model/blob-pool.hpp"
+#include "model/tape.hpp"
+#include "model/node-size.hpp"
 #include "model/node.hpp"
+#include "model/memory-budget.hpp"
+#include "model/edit-journal.hpp"
+#include "model/nbt-value.hpp"
+#include "model/region-file.hpp"
+#include "model/region-compactor.hpp"
+#include "model/region-scanner.hpp"
 #include "filter-cache.hpp"
 #include "model/node.impl.hpp"
 #include "model/directory-contents.impl.hpp"
 #include "model/compound.impl.hpp"
+#include "model/save-snapshot.hpp"
 #include "model/state.hpp"
 #include "model/region.impl.hpp"
-#include "imgui-ext.hpp"
+#include "model/edit-journal.impl.hpp"
 #include "render/legal.hpp"
+#include "render/profiler.hpp"
+#include "render/largest-items.hpp"
+#include "render/compaction-report.hpp"
+#include "render/scan-report.hpp"
 #include "render/render.hpp"
 
 //MARK: -
@@ -66,8 +107,6 @@ extern "C" {
     abort();
   }
 
-  state.loadTextures((__bridge void *)_device);
-
   // Setup Dear ImGui context
   // FIXME: This example doesn't have proper cleanup...
   IMGUI_CHECKVERSION();
@@ -79,24 +118,7 @@ extern "C" {
   // Setup Dear ImGui style
   ImGui::StyleColorsLight();
 
-  if (auto udevFont = nbte::LoadNamedResource("UDEVGothic35_Regular.ttf"); udevFont) {
-    void *data = malloc(udevFont->fSize);
-    memcpy(data, udevFont->fData, udevFont->fSize);
-
-    ImVector<ImWchar> ranges;
-    ImFontGlyphRangesBuilder builder;
-    builder.AddRanges(io.Fonts->GetGlyphRangesKorean());
-    builder.AddRanges(io.Fonts->GetGlyphRangesJapanese());
-    builder.AddRanges(io.Fonts->GetGlyphRangesChineseFull());
-    builder.AddRanges(io.Fonts->GetGlyphRangesChineseSimplifiedCommon());
-    builder.AddRanges(io.Fonts->GetGlyphRangesCyrillic());
-    builder.AddRanges(io.Fonts->GetGlyphRangesThai());
-    builder.AddRanges(io.Fonts->GetGlyphRangesVietnamese());
-    builder.BuildRanges(&ranges);
-
-    ImFont *font = io.Fonts->AddFontFromMemoryTTF(data, udevFont->fSize, 15.0f, nullptr, ranges.Data);
-    io.Fonts->Build();
-  }
+  state.loadTextures(*io.Fonts);
 
   // Setup Renderer backend
   ImGui_ImplMetal_Init(_device);
@@ -146,11 +168,18 @@ extern "C" {
     return;
   }
 
+  if (state.updateTextures(*io.Fonts)) {
+    ImGui_ImplMetal_DestroyFontsTexture();
+    ImGui_ImplMetal_CreateFontsTexture(self.device);
+  }
+
   // Start the Dear ImGui frame
   ImGui_ImplMetal_NewFrame(renderPassDescriptor);
   ImGui_ImplOSX_NewFrame(view);
 
+  state.fRecorder.capture();
   ImGui::NewFrame();
+  state.fRecorder.captured();
 
   state.fDisplaySize = io.DisplaySize;
   nbte::Render(state);
@@ -250,10 +279,10 @@ extern "C" {
     return NO;
   }
   if (fs::is_regular_file(filePath)) {
-    state.open(filePath);
+    state.openChosen(filePath, false);
     return YES;
   } else if (fs::is_directory(filePath)) {
-    state.openDirectory(filePath);
+    state.openChosen(filePath, true);
     return YES;
   } else {
     return NO;
@@ -0,0 +1,75 @@
+#pragma once
+
+namespace nbte {
+
+// Hash-consing of large, immutable byte ranges shared between chunk tapes. Chunks repeat the same light arrays,
+// heightmaps and block state data over and over, identical ones are held only once. The pool keeps weak references, so a
+// blob goes away with the last tape using it.
+class BlobPool {
+public:
+  using Blob = std::vector<uint8_t>;
+
+  // Arrays smaller than this are left inline in the tape.
+  static constexpr size_t kMinBlobSize = 256;
+
+  static BlobPool &Shared() {
+    static BlobPool sPool;
+    return sPool;
+  }
+
+  bool enabled() const {
+    return fEnabled.load(std::memory_order_relaxed);
+  }
+
+  void setEnabled(bool enabled) {
+    fEnabled.store(enabled, std::memory_order_relaxed);
+  }
+
+  std::shared_ptr<Blob const> intern(uint8_t const *data, size_t size) {
+    using namespace std;
+    size_t hash = std::hash<string_view>()(string_view((char const *)data, size));
+    lock_guard<mutex> lock(fMutex);
+    auto &bucket = fBlobs[hash];
+    for (auto it = bucket.begin(); it != bucket.end();) {
+      auto blob = it->lock();
+      if (!blob) {
+        it = bucket.erase(it);
+        continue;
+      }
+      if (blob->size() == size && memcmp(blob->data(), data, size) == 0) {
+        return blob;
+      }
+      it++;
+    }
+    shared_ptr<Blob const> blob = make_shared<Blob>(data, data + size);
+    bucket.push_back(blob);
+    if (++fInserted >= fBlobs.size() * 2) {
+      sweep();
+    }
+    return blob;
+  }
+
+private:
+  BlobPool() = default;
+
+  void sweep() {
+    using namespace std;
+    for (auto it = fBlobs.begin(); it != fBlobs.end();) {
+      auto &bucket = it->second;
+      bucket.erase(remove_if(bucket.begin(), bucket.end(), [](auto const &blob) { return blob.expired(); }), bucket.end());
+      if (bucket.empty()) {
+        it = fBlobs.erase(it);
+      } else {
+        it++;
+      }
+    }
+    fInserted = 0;
+  }
+
+  std::atomic<bool> fEnabled = true;
+  std::mutex fMutex;
+  std::unordered_map<size_t, std::vector<std::weak_ptr<Blob const>>> fBlobs;
+  size_t fInserted = 0;
+};
+
+} // namespace nbte
@@ -12,15 +12,7 @@ String Compound::name() const {
   }
 }
 
-String Compound::save() {
-  if (fName.index() != 1) {
-    return u8"";
-  }
-  Path const &path = std::get<1>(fName);
-  return save(path);
-}
-
-String Compound::save(Path const &file) {
+String Compound::Write(mcfile::nbt::CompoundTag const &tag, Format format, Path const &file, SaveProfile profile, TaskQueue *pool) {
   using namespace std;
   using namespace mcfile;
   using namespace mcfile::stream;
@@ -28,45 +20,103 @@ String Compound::save(Path const &file) {
   namespace fs = std::filesystem;
 
   Endian endian = Endian::Big;
-  switch (fFormat) {
+  ParallelDeflate::Container container = ParallelDeflate::Container::Zlib;
+  switch (format) {
   case Compound::Format::RawLittleEndian:
     endian = Endian::Little;
     [[fallthrough]];
   case Compound::Format::RawBigEndian: {
-    auto stream = make_shared<FileOutputStream>(file);
-    OutputStreamWriter writer(stream, endian);
-    if (!CompoundTag::Write(*fTag, writer)) {
+    Path temp = ReplacementFile(file);
+    bool ok;
+    {
+      auto stream = make_shared<FileOutputStream>(temp);
+      OutputStreamWriter writer(stream, endian);
+      ok = CompoundTag::Write(tag, writer);
+    }
+    if (!ok) {
+      error_code ec;
+      fs::remove(temp, ec);
       return u8"IO Error";
     }
-    break;
+    if (!ReplaceWithSynced(temp, file)) {
+      return u8"IO Error";
+    }
+    return u8"";
   }
   case Compound::Format::DeflatedLittleEndian:
     endian = Endian::Little;
-    [[fallthrough]];
-  case Compound::Format::DeflatedBigEndian: {
-    auto stream = make_shared<FileOutputStream>(file);
-    if (!CompoundTag::WriteCompressed(*fTag, *stream, endian)) {
-      return u8"IO Error";
-    }
     break;
-  }
+  case Compound::Format::DeflatedBigEndian:
+    break;
   case Compound::Format::GzippedLittleEndian:
     endian = Endian::Little;
     [[fallthrough]];
-  case Compound::Format::GzippedBigEndian: {
-    auto stream = make_shared<GzFileOutputStream>(file);
-    OutputStreamWriter writer(stream, endian);
-    if (!CompoundTag::Write(*fTag, writer)) {
-      return u8"IO Error";
-    }
+  case Compound::Format::GzippedBigEndian:
+    container = ParallelDeflate::Container::Gzip;
     break;
-  }
   default:
     return u8"Unknown compound tag format";
   }
+
+  vector<uint8_t> buffer;
+  if (!CompoundTag::Write(tag, buffer, endian)) {
+    return u8"IO Error";
+  }
+  if (!ParallelDeflate::Compress(buffer, container, ParallelDeflate::Level(profile), pool)) {
+    return u8"Compression failed";
+  }
+  Path temp = ReplacementFile(file);
+  FILE *fp = OpenFileStream(temp, u8"wb");
+  if (!fp) {
+    return u8"IO Error";
+  }
+  bool ok = fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size();
+  fclose(fp);
+  if (!ok) {
+    error_code ec;
+    fs::remove(temp, ec);
+    return u8"IO Error";
+  }
+  if (!ReplaceWithSynced(temp, file)) {
+    return u8"IO Error";
+  }
   return u8"";
 }
 
+std::shared_ptr<Tape> Compound::decode() const {
+  using namespace std;
+  if (fCompressed.empty()) {
+    return nullptr;
+  }
+  vector<uint8_t> buffer = fCompressed;
+  if (!mcfile::Compression::Decompress(buffer)) {
+    return nullptr;
+  }
+  BlobPool &pool = BlobPool::Shared();
+  return Tape::Parse(std::move(buffer), mcfile::Endian::Big, pool.enabled() ? &pool : nullptr);
+}
+
+bool Compound::materialize() {
+  if (fTag || fTape) {
+    return true;
+  }
+  fTape = decode();
+  if (!fTape) {
+    return false;
+  }
+  std::vector<uint8_t>().swap(fCompressed);
+  return true;
+}
+
+bool Compound::dematerialize(std::vector<uint8_t> &&compressed, uint64_t revision) {
+  if (!fTape || fEdited || fRevision != revision || compressed.empty()) {
+    return false;
+  }
+  fCompressed = std::move(compressed);
+  fTape.reset();
+  return true;
+}
+
 std::optional<Path> Compound::filePathIfEdited() const {
   if (fName.index() != 1) {
     return std::nullopt;
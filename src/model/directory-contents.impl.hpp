@@ -16,7 +16,7 @@ DirectoryContents::DirectoryContents(Path const &dir, std::shared_ptr<Node> pare
     Path p = it.path();
     if (it.is_directory()) {
       directories[p.filename().u8string()] = p;
-    } else if (it.is_regular_file()) {
+    } else if (it.is_regular_file() && !EditJournal::IsJournalFile(p) && !IsReplacementFile(p)) {
       files[p.filename().u8string()] = p;
     }
   }
@@ -28,20 +28,11 @@ DirectoryContents::DirectoryContents(Path const &dir, std::shared_ptr<Node> pare
   }
 }
 
-String DirectoryContents::save(TemporaryDirectory &temp) {
-  for (auto &it : fValue) {
-    auto err = it->save(temp);
-    if (!err.empty()) {
-      return err;
-    }
-  }
-  return u8"";
-}
-
 bool DirectoryContents::dirtyFiles(std::vector<Path> *buffer) const {
   bool dirty = false;
   for (auto &it : fValue) {
-    dirty = dirty || it->dirtyFiles(buffer);
+    // Every child is visited when the files are collected.
+    dirty = it->dirtyFiles(buffer) || dirty;
     if (dirty && !buffer) {
       return true;
     }
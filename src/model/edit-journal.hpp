@@ -0,0 +1,649 @@
+#pragma once
+
+namespace nbte {
+
+// Append-only log of the edits not saved yet, kept in the opened directory, or for a file opened alone in the application
+// data directory, as the App Sandbox allows nothing next to it. Every edit appends the path of the value and its new
+// value, so a crash loses nothing, and the log left by a crashed session can be applied to the files when they are
+// opened again. Records appended during a frame are written and synced at once by flush.
+//
+// An edit is durable once its record is flushed, for the cost of one small append. Saving still rewrites the regions
+// and files holding edits, as Minecraft reads nothing else, and folds the journal into them: SaveSnapshot replaces each
+// file at once, so after a crash while saving the journal applies to either the old file or the saved one.
+//
+// The file starts with kMagic, followed by records of: u32 size, u32 crc32 of the payload, payload. Numbers are in host
+// byte order. A record failing its checksum ends the journal, as the write was cut by a crash.
+class EditJournal {
+public:
+  static constexpr uint32_t kNoElement = std::numeric_limits<uint32_t>::max();
+
+  // A child of a compound by key, or an item of a list by index.
+  struct Step {
+    std::optional<String> fKey;
+    uint32_t fIndex = 0;
+  };
+
+  struct Record {
+    // Relative to the root of the journal.
+    String fFile;
+    std::optional<mcfile::Pos2i> fChunk;
+    std::vector<Step> fPath;
+    // Index in an array, or kNoElement for the value itself.
+    uint32_t fElement = kNoElement;
+    Tape::Type fType = Tape::Type::End;
+    std::vector<uint8_t> fValue;
+  };
+
+  EditJournal() = default;
+  EditJournal(EditJournal const &) = delete;
+  EditJournal &operator=(EditJournal const &) = delete;
+
+  ~EditJournal() {
+    close();
+  }
+
+  static Path JournalFile(Path const &opened) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (fs::is_directory(opened, ec)) {
+      return opened / kFileName;
+    }
+    // Keyed by the absolute path, as files of the same name are opened from many places.
+    String key = fs::absolute(opened, ec).generic_u8string();
+    uint64_t hash = 14695981039346656037ull;
+    for (char8_t c : key) {
+      hash = (hash ^ (uint8_t)c) * 1099511628211ull;
+    }
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    return ApplicationDataDirectory() / u8"journals" / (opened.filename().u8string() + u8"-" + ReinterpretAsU8String(hex) + kFileName);
+  }
+
+  static bool IsJournalFile(Path const &file) {
+    return file.filename().u8string().ends_with(kFileName);
+  }
+
+  // Starts journaling the edits of the opened file or directory. Returns the records left by a previous session.
+  std::vector<Record> open(Path const &opened) {
+    using namespace std;
+    namespace fs = std::filesystem;
+    close();
+    fFile = JournalFile(opened);
+    error_code ec;
+    fs::create_directories(fFile.parent_path(), ec);
+    fRoot = fs::is_directory(opened, ec) ? opened : opened.parent_path();
+    fRecords = read(fFile);
+    return fRecords;
+  }
+
+  void close() {
+    flush();
+    if (fStream) {
+      fclose(fStream);
+      fStream = nullptr;
+    }
+    fFile.clear();
+    fRoot.clear();
+    fRecords.clear();
+    fPending.clear();
+    fCachePath.clear();
+  }
+
+  // Drops every record, as the edits have been saved or discarded.
+  void clear() {
+    namespace fs = std::filesystem;
+    if (fStream) {
+      fclose(fStream);
+      fStream = nullptr;
+    }
+    fRecords.clear();
+    fPending.clear();
+    if (!fFile.empty()) {
+      std::error_code ec;
+      fs::remove(fFile, ec);
+    }
+  }
+
+  void record(Compound const &root, mcfile::nbt::Tag const &tag, uint32_t element = kNoElement) {
+    using namespace std;
+    if (fFile.empty() || root.fName.index() != 1 || !root.fTag) {
+      return;
+    }
+    Record r;
+    r.fFile = relative(get<1>(root.fName));
+    if (ResolveTag(*root.fTag, fCachePath) != &tag) {
+      fCachePath.clear();
+      if (!FindTag(*root.fTag, &tag, fCachePath)) {
+        return;
+      }
+    }
+    r.fPath = fCachePath;
+    r.fElement = element;
+    if (!EncodeTag(tag, element, r)) {
+      return;
+    }
+    append(std::move(r));
+  }
+
+  void record(Compound const &root, Tape const &tape, uint32_t index, uint32_t element = kNoElement) {
+    if (fFile.empty() || root.fRegionFile.empty()) {
+      return;
+    }
+    Record r;
+    r.fFile = relative(root.fRegionFile);
+    r.fChunk = mcfile::Pos2i(root.fChunkX, root.fChunkZ);
+    if (ResolveTape(tape, fCachePath) != index) {
+      fCachePath = TapePath(tape, index);
+    }
+    r.fPath = fCachePath;
+    r.fElement = element;
+    if (!EncodeTape(tape, index, element, r)) {
+      return;
+    }
+    append(std::move(r));
+  }
+
+  // Writes and syncs the records appended since the last call. Returns false on an IO error, after which the journal
+  // stops recording.
+  bool flush() {
+    using namespace std;
+    if (fPending.empty()) {
+      return true;
+    }
+    vector<uint8_t> pending;
+    pending.swap(fPending);
+    if (!fStream) {
+      error_code ec;
+      bool exists = filesystem::exists(fFile, ec);
+      fStream = OpenFileStream(fFile, u8"ab");
+      if (!fStream) {
+        fFile.clear();
+        return false;
+      }
+      if (!exists && fwrite(kMagic, 1, sizeof(kMagic), fStream) != sizeof(kMagic)) {
+        fFile.clear();
+        return false;
+      }
+    }
+    if (fwrite(pending.data(), 1, pending.size(), fStream) != pending.size() || !SyncFile(fStream)) {
+      fFile.clear();
+      return false;
+    }
+    return true;
+  }
+
+  // Rewrites the journal with only the last record of each value, for the files still not saved.
+  void compact(std::vector<Path> const &dirtyFiles) {
+    using namespace std;
+    namespace fs = std::filesystem;
+    if (fFile.empty()) {
+      return;
+    }
+    flush();
+    set<String> dirty;
+    for (auto const &file : dirtyFiles) {
+      dirty.insert(relative(file));
+    }
+    map<vector<uint8_t>, size_t> latest;
+    for (size_t i = 0; i < fRecords.size(); i++) {
+      if (dirty.count(fRecords[i].fFile) > 0) {
+        latest[Target(fRecords[i])] = i;
+      }
+    }
+    if (latest.size() == fRecords.size()) {
+      return;
+    }
+    if (latest.empty()) {
+      clear();
+      return;
+    }
+    vector<size_t> keep;
+    for (auto const &it : latest) {
+      keep.push_back(it.second);
+    }
+    sort(keep.begin(), keep.end());
+    vector<Record> records;
+    vector<uint8_t> buffer(kMagic, kMagic + sizeof(kMagic));
+    for (size_t i : keep) {
+      Frame(fRecords[i], buffer);
+      records.push_back(std::move(fRecords[i]));
+    }
+    fRecords.swap(records);
+
+    // Replaced at once, so a crash leaves either the old journal or the new one.
+    Path temp = ReplacementFile(fFile);
+    FILE *fp = OpenFileStream(temp, u8"wb");
+    if (!fp) {
+      return;
+    }
+    bool ok = fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size();
+    fclose(fp);
+    error_code ec;
+    if (!ok) {
+      fs::remove(temp, ec);
+      return;
+    }
+    if (fStream) {
+      fclose(fStream);
+      fStream = nullptr;
+    }
+    ReplaceWithSynced(temp, fFile);
+  }
+
+  // Applies the records to the files under root, on the save queue. Records which don't match the files anymore are
+  // skipped.
+  static String Apply(Path const &root, std::vector<Record> const &records, SaveProfile profile, TaskQueue &pool);
+
+private:
+  static constexpr char8_t kFileName[] = u8".nbte-journal";
+  static constexpr uint8_t kMagic[8] = {'N', 'B', 'T', 'E', 'J', 'N', 'L', '1'};
+
+  String relative(Path const &file) const {
+    return file.lexically_relative(fRoot).generic_u8string();
+  }
+
+  void append(Record &&r) {
+    Frame(r, fPending);
+    fRecords.push_back(std::move(r));
+  }
+
+  static bool FindTag(mcfile::nbt::Tag const &current, mcfile::nbt::Tag const *target, std::vector<Step> &path) {
+    using namespace std;
+    using namespace mcfile::nbt;
+    if (&current == target) {
+      return true;
+    }
+    if (current.type() == Tag::Type::Compound) {
+      for (auto const &it : static_cast<CompoundTag const &>(current).fValue) {
+        if (!it.second) {
+          continue;
+        }
+        path.push_back(Step{it.first, 0});
+        if (FindTag(*it.second, target, path)) {
+          return true;
+        }
+        path.pop_back();
+      }
+    } else if (current.type() == Tag::Type::List) {
+      auto const &list = static_cast<ListTag const &>(current);
+      for (size_t i = 0; i < list.fValue.size(); i++) {
+        if (!list.fValue[i]) {
+          continue;
+        }
+        path.push_back(Step{nullopt, (uint32_t)i});
+        if (FindTag(*list.fValue[i], target, path)) {
+          return true;
+        }
+        path.pop_back();
+      }
+    }
+    return false;
+  }
+
+  static mcfile::nbt::Tag *ResolveTag(mcfile::nbt::CompoundTag &root, std::vector<Step> const &path) {
+    using namespace mcfile::nbt;
+    Tag *current = &root;
+    for (auto const &step : path) {
+      if (step.fKey) {
+        if (current->type() != Tag::Type::Compound) {
+          return nullptr;
+        }
+        auto &compound = static_cast<CompoundTag &>(*current);
+        auto found = compound.fValue.find(*step.fKey);
+        if (found == compound.fValue.end() || !found->second) {
+          return nullptr;
+        }
+        current = found->second.get();
+      } else {
+        if (current->type() != Tag::Type::List) {
+          return nullptr;
+        }
+        auto &list = static_cast<ListTag &>(*current);
+        if (step.fIndex >= list.fValue.size() || !list.fValue[step.fIndex]) {
+          return nullptr;
+        }
+        current = list.fValue[step.fIndex].get();
+      }
+    }
+    return current;
+  }
+
+  static std::optional<uint32_t> ResolveTape(Tape const &tape, std::vector<Step> const &path) {
+    uint32_t current = 0;
+    for (auto const &step : path) {
+      if (step.fKey) {
+        if (tape.type(current) != Tape::Type::Compound) {
+          return std::nullopt;
+        }
+        std::optional<uint32_t> found;
+        for (uint32_t i = 0; i < tape.size(current); i++) {
+          if (uint32_t child = tape.child(current, i); tape.name(child) == *step.fKey) {
+            found = child;
+            break;
+          }
+        }
+        if (!found) {
+          return std::nullopt;
+        }
+        current = *found;
+      } else {
+        if (tape.type(current) != Tape::Type::List || step.fIndex >= tape.size(current)) {
+          return std::nullopt;
+        }
+        current = tape.child(current, step.fIndex);
+      }
+    }
+    return current;
+  }
+
+  static std::vector<Step> TapePath(Tape const &tape, uint32_t index) {
+    using namespace std;
+    // Entries are in pre-order, so the ancestors of index all come before it.
+    vector<uint32_t> parents(index + 1, 0);
+    vector<uint32_t> positions(index + 1, 0);
+    for (uint32_t i = 0; i < index; i++) {
+      Tape::Type type = tape.type(i);
+      if (type != Tape::Type::Compound && type != Tape::Type::List) {
+        continue;
+      }
+      for (uint32_t j = 0; j < tape.size(i); j++) {
+        uint32_t child = tape.child(i, j);
+        if (child > index) {
+          break;
+        }
+        parents[child] = i;
+        positions[child] = j;
+      }
+    }
+    vector<Step> path;
+    for (uint32_t i = index; i != 0; i = parents[i]) {
+      if (tape.type(parents[i]) == Tape::Type::List) {
+        path.push_back(Step{nullopt, positions[i]});
+      } else {
+        path.push_back(Step{tape.name(i), 0});
+      }
+    }
+    reverse(path.begin(), path.end());
+    return path;
+  }
+
+  template <class T>
+  static void SetValue(Record &r, T v) {
+    r.fValue.resize(sizeof(T));
+    memcpy(r.fValue.data(), &v, sizeof(T));
+  }
+
+  static bool EncodeTag(mcfile::nbt::Tag const &tag, uint32_t element, Record &r) {
+    using namespace mcfile::nbt;
+    r.fType = tag.type();
+    switch (tag.type()) {
+    case Tag::Type::Byte:
+      SetValue(r, static_cast<ByteTag const &>(tag).fValue);
+      return true;
+    case Tag::Type::Short:
+      SetValue(r, static_cast<ShortTag const &>(tag).fValue);
+      return true;
+    case Tag::Type::Int:
+      SetValue(r, static_cast<IntTag const &>(tag).fValue);
+      return true;
+    case Tag::Type::Long:
+      SetValue(r, static_cast<LongTag const &>(tag).fValue);
+      return true;
+    case Tag::Type::Float:
+      SetValue(r, static_cast<FloatTag const &>(tag).fValue);
+      return true;
+    case Tag::Type::Double:
+      SetValue(r, static_cast<DoubleTag const &>(tag).fValue);
+      return true;
+    case Tag::Type::String: {
+      auto const &v = static_cast<StringTag const &>(tag).fValue;
+      r.fValue.assign(v.begin(), v.end());
+      return true;
+    }
+    case Tag::Type::ByteArray:
+      if (auto const &v = static_cast<ByteArrayTag const &>(tag).fValue; element < v.size()) {
+        SetValue(r, v[element]);
+        return true;
+      }
+      return false;
+    case Tag::Type::IntArray:
+      if (auto const &v = static_cast<IntArrayTag const &>(tag).fValue; element < v.size()) {
+        SetValue(r, v[element]);
+        return true;
+      }
+      return false;
+    case Tag::Type::LongArray:
+      if (auto const &v = static_cast<LongArrayTag const &>(tag).fValue; element < v.size()) {
+        SetValue(r, v[element]);
+        return true;
+      }
+      return false;
+    default:
+      return false;
+    }
+  }
+
+  static bool EncodeTape(Tape const &tape, uint32_t index, uint32_t element, Record &r) {
+    using Type = Tape::Type;
+    r.fType = tape.type(index);
+    switch (r.fType) {
+    case Type::Byte:
+      SetValue(r, tape.scalar<uint8_t>(index));
+      return true;
+    case Type::Short:
+      SetValue(r, tape.scalar<int16_t>(index));
+      return true;
+    case Type::Int:
+      SetValue(r, tape.scalar<int32_t>(index));
+      return true;
+    case Type::Long:
+      SetValue(r, tape.scalar<int64_t>(index));
+      return true;
+    case Type::Float:
+      SetValue(r, tape.scalar<float>(index));
+      return true;
+    case Type::Double:
+      SetValue(r, tape.scalar<double>(index));
+      return true;
+    case Type::String: {
+      String v = tape.string(index);
+      r.fValue.assign(v.begin(), v.end());
+      return true;
+    }
+    case Type::ByteArray:
+    case Type::IntArray:
+    case Type::LongArray:
+      if (element >= tape.size(index)) {
+        return false;
+      }
+      if (r.fType == Type::ByteArray) {
+        SetValue(r, tape.element<uint8_t>(index, element));
+      } else if (r.fType == Type::IntArray) {
+        SetValue(r, tape.element<int32_t>(index, element));
+      } else {
+        SetValue(r, tape.element<int64_t>(index, element));
+      }
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  template <class T>
+  static void Put(std::vector<uint8_t> &out, T v) {
+    size_t offset = out.size();
+    out.resize(offset + sizeof(T));
+    memcpy(out.data() + offset, &v, sizeof(T));
+  }
+
+  static void PutString(std::vector<uint8_t> &out, String const &s) {
+    Put<uint32_t>(out, (uint32_t)s.size());
+    out.insert(out.end(), s.begin(), s.end());
+  }
+
+  // Identifies the value a record sets, regardless of the new value.
+  static std::vector<uint8_t> Target(Record const &r) {
+    std::vector<uint8_t> out;
+    PutString(out, r.fFile);
+    Put<uint8_t>(out, r.fChunk ? 1 : 0);
+    if (r.fChunk) {
+      Put<int32_t>(out, r.fChunk->fX);
+      Put<int32_t>(out, r.fChunk->fZ);
+    }
+    Put<uint32_t>(out, (uint32_t)r.fPath.size());
+    for (auto const &step : r.fPath) {
+      Put<uint8_t>(out, step.fKey ? 1 : 0);
+      if (step.fKey) {
+        PutString(out, *step.fKey);
+      } else {
+        Put<uint32_t>(out, step.fIndex);
+      }
+    }
+    Put<uint32_t>(out, r.fElement);
+    return out;
+  }
+
+  static void Frame(Record const &r, std::vector<uint8_t> &out) {
+    std::vector<uint8_t> payload = Target(r);
+    Put<uint8_t>(payload, (uint8_t)r.fType);
+    Put<uint32_t>(payload, (uint32_t)r.fValue.size());
+    payload.insert(payload.end(), r.fValue.begin(), r.fValue.end());
+    Put<uint32_t>(out, (uint32_t)payload.size());
+    Put<uint32_t>(out, (uint32_t)crc32(0, payload.data(), (unsigned int)payload.size()));
+    out.insert(out.end(), payload.begin(), payload.end());
+  }
+
+  class Reader {
+  public:
+    Reader(uint8_t const *data, size_t size) : fData(data), fSize(size) {}
+
+    template <class T>
+    bool get(T &v) {
+      if (fSize - fPos < sizeof(T)) {
+        return false;
+      }
+      memcpy(&v, fData + fPos, sizeof(T));
+      fPos += sizeof(T);
+      return true;
+    }
+
+    bool getBytes(std::vector<uint8_t> &v) {
+      uint32_t size;
+      if (!get(size) || fSize - fPos < size) {
+        return false;
+      }
+      v.assign(fData + fPos, fData + fPos + size);
+      fPos += size;
+      return true;
+    }
+
+    bool getString(String &s) {
+      std::vector<uint8_t> v;
+      if (!getBytes(v)) {
+        return false;
+      }
+      s.assign(v.begin(), v.end());
+      return true;
+    }
+
+    bool atEnd() const {
+      return fPos == fSize;
+    }
+
+  private:
+    uint8_t const *fData;
+    size_t fSize;
+    size_t fPos = 0;
+  };
+
+  static std::optional<Record> Parse(uint8_t const *data, size_t size) {
+    Reader reader(data, size);
+    Record r;
+    uint8_t hasChunk;
+    if (!reader.getString(r.fFile) || !reader.get(hasChunk)) {
+      return std::nullopt;
+    }
+    if (hasChunk) {
+      int32_t x, z;
+      if (!reader.get(x) || !reader.get(z)) {
+        return std::nullopt;
+      }
+      r.fChunk = mcfile::Pos2i(x, z);
+    }
+    uint32_t steps;
+    if (!reader.get(steps)) {
+      return std::nullopt;
+    }
+    for (uint32_t i = 0; i < steps; i++) {
+      Step step;
+      uint8_t isKey;
+      if (!reader.get(isKey)) {
+        return std::nullopt;
+      }
+      if (isKey) {
+        String key;
+        if (!reader.getString(key)) {
+          return std::nullopt;
+        }
+        step.fKey = key;
+      } else if (!reader.get(step.fIndex)) {
+        return std::nullopt;
+      }
+      r.fPath.push_back(step);
+    }
+    uint8_t type;
+    if (!reader.get(r.fElement) || !reader.get(type) || !reader.getBytes(r.fValue) || !reader.atEnd()) {
+      return std::nullopt;
+    }
+    r.fType = (Tape::Type)type;
+    return r;
+  }
+
+  static std::vector<Record> read(Path const &file) {
+    using namespace std;
+    vector<Record> records;
+    FILE *fp = OpenFileStream(file, u8"rb");
+    if (!fp) {
+      return records;
+    }
+    vector<uint8_t> bytes;
+    uint8_t buffer[4096];
+    while (size_t read = fread(buffer, 1, sizeof(buffer), fp)) {
+      bytes.insert(bytes.end(), buffer, buffer + read);
+    }
+    fclose(fp);
+    if (bytes.size() < sizeof(kMagic) || memcmp(bytes.data(), kMagic, sizeof(kMagic)) != 0) {
+      return records;
+    }
+    size_t pos = sizeof(kMagic);
+    while (bytes.size() - pos >= 2 * sizeof(uint32_t)) {
+      uint32_t size, checksum;
+      memcpy(&size, bytes.data() + pos, sizeof(size));
+      memcpy(&checksum, bytes.data() + pos + sizeof(size), sizeof(checksum));
+      pos += 2 * sizeof(uint32_t);
+      if (bytes.size() - pos < size || crc32(0, bytes.data() + pos, size) != checksum) {
+        break;
+      }
+      auto record = Parse(bytes.data() + pos, size);
+      if (!record) {
+        break;
+      }
+      records.push_back(std::move(*record));
+      pos += size;
+    }
+    return records;
+  }
+
+  Path fFile;
+  Path fRoot;
+  FILE *fStream = nullptr;
+  // Every record of the session, for compaction.
+  std::vector<Record> fRecords;
+  // Framed records not written yet.
+  std::vector<uint8_t> fPending;
+  // Path of the value edited last. An edit is usually followed by more edits of the same value, and following a path is
+  // much cheaper than searching for the value.
+  std::vector<Step> fCachePath;
+};
+
+} // namespace nbte
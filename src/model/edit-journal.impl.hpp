@@ -0,0 +1,184 @@
+#pragma once
+
+namespace nbte {
+
+template <class T>
+static bool JournalValue(EditJournal::Record const &r, T *v) {
+  if (r.fValue.size() != sizeof(T)) {
+    return false;
+  }
+  memcpy(v, r.fValue.data(), sizeof(T));
+  return true;
+}
+
+template <class T>
+static bool ApplyJournalScalar(EditJournal::Record const &r, mcfile::nbt::Tag &tag) {
+  return JournalValue(r, &static_cast<T &>(tag).fValue);
+}
+
+template <class T>
+static bool ApplyJournalElement(EditJournal::Record const &r, mcfile::nbt::Tag &tag) {
+  auto &values = static_cast<T &>(tag).fValue;
+  return r.fElement < values.size() && JournalValue(r, &values[r.fElement]);
+}
+
+static bool ApplyJournalRecord(EditJournal::Record const &r, mcfile::nbt::Tag &tag) {
+  using namespace mcfile::nbt;
+  if (tag.type() != r.fType) {
+    return false;
+  }
+  switch (r.fType) {
+  case Tag::Type::Byte:
+    return ApplyJournalScalar<ByteTag>(r, tag);
+  case Tag::Type::Short:
+    return ApplyJournalScalar<ShortTag>(r, tag);
+  case Tag::Type::Int:
+    return ApplyJournalScalar<IntTag>(r, tag);
+  case Tag::Type::Long:
+    return ApplyJournalScalar<LongTag>(r, tag);
+  case Tag::Type::Float:
+    return ApplyJournalScalar<FloatTag>(r, tag);
+  case Tag::Type::Double:
+    return ApplyJournalScalar<DoubleTag>(r, tag);
+  case Tag::Type::String:
+    static_cast<StringTag &>(tag).fValue.assign(r.fValue.begin(), r.fValue.end());
+    return true;
+  case Tag::Type::ByteArray:
+    return ApplyJournalElement<ByteArrayTag>(r, tag);
+  case Tag::Type::IntArray:
+    return ApplyJournalElement<IntArrayTag>(r, tag);
+  case Tag::Type::LongArray:
+    return ApplyJournalElement<LongArrayTag>(r, tag);
+  default:
+    return false;
+  }
+}
+
+template <class T>
+static bool ApplyJournalRecord(EditJournal::Record const &r, Tape &tape, uint32_t index) {
+  T v;
+  if (!JournalValue(r, &v)) {
+    return false;
+  }
+  if (r.fElement == EditJournal::kNoElement) {
+    tape.setScalar(index, v);
+    return true;
+  }
+  if (r.fElement >= tape.size(index)) {
+    return false;
+  }
+  tape.setElement(index, r.fElement, v);
+  return true;
+}
+
+static bool ApplyJournalRecord(EditJournal::Record const &r, Tape &tape, uint32_t index) {
+  using Type = Tape::Type;
+  if (tape.type(index) != r.fType) {
+    return false;
+  }
+  switch (r.fType) {
+  case Type::Byte:
+  case Type::ByteArray:
+    return ApplyJournalRecord<uint8_t>(r, tape, index);
+  case Type::Short:
+    return ApplyJournalRecord<int16_t>(r, tape, index);
+  case Type::Int:
+  case Type::IntArray:
+    return ApplyJournalRecord<int32_t>(r, tape, index);
+  case Type::Long:
+  case Type::LongArray:
+    return ApplyJournalRecord<int64_t>(r, tape, index);
+  case Type::Float:
+    return ApplyJournalRecord<float>(r, tape, index);
+  case Type::Double:
+    return ApplyJournalRecord<double>(r, tape, index);
+  case Type::String:
+    return tape.setString(index, String(r.fValue.begin(), r.fValue.end()));
+  default:
+    return false;
+  }
+}
+
+String EditJournal::Apply(Path const &root, std::vector<Record> const &records, SaveProfile profile, TaskQueue &pool) {
+  using namespace std;
+
+  struct File {
+    shared_ptr<mcfile::nbt::CompoundTag> fTag;
+    Compound::Format fFormat;
+  };
+  map<Path, File> files;
+  map<pair<Path, int>, shared_ptr<Tape>> chunks;
+  size_t skipped = 0;
+
+  for (auto const &r : records) {
+    Path file = root / Path(r.fFile);
+    if (!r.fChunk) {
+      auto found = files.find(file);
+      if (found == files.end()) {
+        File f;
+        f.fTag = ReadCompound(file, &f.fFormat);
+        found = files.insert(make_pair(file, f)).first;
+      }
+      mcfile::nbt::Tag *tag = found->second.fTag ? ResolveTag(*found->second.fTag, r.fPath) : nullptr;
+      if (!tag || !ApplyJournalRecord(r, *tag)) {
+        skipped++;
+      }
+      continue;
+    }
+
+    auto pos = mcfile::je::Region::RegionXZFromFile(file);
+    if (!pos) {
+      skipped++;
+      continue;
+    }
+    int localX = r.fChunk->fX - pos->fX * 32;
+    int localZ = r.fChunk->fZ - pos->fZ * 32;
+    if (localX < 0 || 32 <= localX || localZ < 0 || 32 <= localZ) {
+      skipped++;
+      continue;
+    }
+    int index = (int)Region::Index(localX, localZ);
+    auto key = make_pair(file, index);
+    auto found = chunks.find(key);
+    if (found == chunks.end()) {
+      shared_ptr<Tape> tape;
+      auto stream = make_shared<mcfile::stream::FileInputStream>(file);
+      mcfile::stream::InputStreamReader sr(stream, mcfile::Endian::Big);
+      vector<uint8_t> buffer;
+      uint64_t compressed = 0;
+      if (ReadChunk(sr, file, r.fChunk->fX, r.fChunk->fZ, index, buffer, compressed).empty() && !buffer.empty()) {
+        tape = Tape::Parse(std::move(buffer), mcfile::Endian::Big);
+      }
+      found = chunks.insert(make_pair(key, tape)).first;
+    }
+    auto const &tape = found->second;
+    auto entry = tape ? ResolveTape(*tape, r.fPath) : nullopt;
+    if (!entry || !ApplyJournalRecord(r, *tape, *entry)) {
+      skipped++;
+    }
+  }
+
+  SaveSnapshot snapshot(profile);
+  for (auto const &it : files) {
+    if (it.second.fTag) {
+      snapshot.addFile(it.first, it.second.fTag, it.second.fFormat);
+    }
+  }
+  for (auto const &it : chunks) {
+    if (!it.second) {
+      continue;
+    }
+    auto pos = mcfile::je::Region::RegionXZFromFile(it.first.first);
+    int index = it.first.second;
+    snapshot.addChunk(it.first.first, pos->fX, pos->fZ, index % 32, index / 32, it.second);
+  }
+  if (auto err = snapshot.write(pool); !err.empty()) {
+    return err;
+  }
+  if (skipped > 0) {
+    return ToString(skipped) + u8" edits could not be applied, as the files have changed since";
+  }
+  return u8"";
+}
+
+} // namespace nbte
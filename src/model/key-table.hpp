@@ -0,0 +1,149 @@
+#pragma once
+
+namespace nbte {
+
+// Process wide intern table of compound keys. A loaded world repeats the same few hundred keys millions of times, the
+// tape stores their ids instead. Keys are counted by the tapes using them, and the unused ones are dropped by prune once
+// a tree has been closed. The id of a dropped key is given to the next new key, so results computed per id can only be
+// cached while generation() stays the same.
+class KeyTable {
+public:
+  // The keys a tape holds ids of. Copied with the tape, and released when it is destroyed.
+  class References {
+  public:
+    References() = default;
+
+    References(References const &other) : fIds(other.fIds) {
+      KeyTable::Shared().retain(fIds);
+    }
+
+    References(References &&other) noexcept : fIds(std::move(other.fIds)) {
+      other.fIds.clear();
+    }
+
+    References &operator=(References other) {
+      fIds.swap(other.fIds);
+      return *this;
+    }
+
+    ~References() {
+      KeyTable::Shared().release(fIds);
+    }
+
+    // The id is taken over from intern, which counted it already.
+    void add(uint32_t id) {
+      fIds.push_back(id);
+    }
+
+  private:
+    std::vector<uint32_t> fIds;
+  };
+
+  static KeyTable &Shared() {
+    static KeyTable sTable;
+    return sTable;
+  }
+
+  // Returns the id of the key, counted once more. It is released with References.
+  uint32_t intern(std::u8string_view key) {
+    using namespace std;
+    {
+      shared_lock<shared_mutex> lock(fMutex);
+      if (auto found = fIds.find(key); found != fIds.end()) {
+        fReferences[found->second]++;
+        return found->second;
+      }
+    }
+    unique_lock<shared_mutex> lock(fMutex);
+    if (auto found = fIds.find(key); found != fIds.end()) {
+      fReferences[found->second]++;
+      return found->second;
+    }
+    uint32_t id;
+    if (fFree.empty()) {
+      id = (uint32_t)fKeys.size();
+      fKeys.emplace_back(key);
+      fReferences.emplace_back(1);
+    } else {
+      id = fFree.back();
+      fFree.pop_back();
+      fKeys[id] = String(key);
+      fReferences[id] = 1;
+    }
+    // Elements of a deque never move, the view stays valid.
+    fIds.insert(make_pair(u8string_view(fKeys[id]), id));
+    return id;
+  }
+
+  // Valid while a tape holding the id is alive.
+  String const &key(uint32_t id) const {
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    return fKeys[id];
+  }
+
+  // Drops the keys no tape uses anymore. Tapes of a closed tree still held elsewhere keep theirs until the next time.
+  void prune() {
+    using namespace std;
+    unique_lock<shared_mutex> lock(fMutex);
+    size_t pruned = 0;
+    for (uint32_t id = 0; id < fKeys.size(); id++) {
+      if (fReferences[id] != 0) {
+        continue;
+      }
+      auto found = fIds.find(u8string_view(fKeys[id]));
+      if (found == fIds.end() || found->second != id) {
+        // Dropped already.
+        continue;
+      }
+      fIds.erase(found);
+      String().swap(fKeys[id]);
+      fFree.push_back(id);
+      pruned++;
+    }
+    if (pruned > 0) {
+      fGeneration++;
+    }
+  }
+
+  // Changes whenever ids have been dropped, and may mean another key from then on.
+  uint64_t generation() const {
+    return fGeneration.load(std::memory_order_acquire);
+  }
+
+  // Keys in use.
+  size_t size() const {
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    return fIds.size();
+  }
+
+private:
+  KeyTable() = default;
+
+  void retain(std::vector<uint32_t> const &ids) {
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    for (uint32_t id : ids) {
+      fReferences[id]++;
+    }
+  }
+
+  void release(std::vector<uint32_t> const &ids) {
+    if (ids.empty()) {
+      return;
+    }
+    std::shared_lock<std::shared_mutex> lock(fMutex);
+    for (uint32_t id : ids) {
+      fReferences[id]--;
+    }
+  }
+
+  mutable std::shared_mutex fMutex;
+  std::deque<String> fKeys;
+  // Counted while the lock is shared, so atomic.
+  std::deque<std::atomic<uint32_t>> fReferences;
+  std::unordered_map<std::u8string_view, uint32_t> fIds;
+  // Ids of dropped keys.
+  std::vector<uint32_t> fFree;
+  std::atomic<uint64_t> fGeneration = 0;
+};
+
+} // namespace nbte
@@ -0,0 +1,198 @@
+#pragma once
+
+namespace nbte {
+
+// Pushed by the task deflating a chunk to be evicted, and applied by MemoryBudget::retrieve.
+struct ChunkDeflated {
+  std::weak_ptr<Node> fNode;
+  Node const *fKey;
+  uint64_t fRevision;
+  std::vector<uint8_t> fCompressed;
+};
+
+using DeflateCompletions = CompletionQueue<ChunkDeflated>;
+
+// Keeps the memory held by opened files and decoded chunks under a budget. Nodes are ordered from the least recently
+// rendered one, and evicted from there until the usage fits: chunks are deflated on the pool and dropped back to their
+// deflated bytes once that has finished, files and regions are closed back to unopened. Edited nodes and nodes rendered
+// in the current frame are never evicted.
+class MemoryBudget {
+public:
+  static constexpr size_t kDefaultBudget = size_t(1) << 30;
+
+  // Starts accounting for the node as the least recently used one.
+  void track(std::shared_ptr<Node> const &node) {
+    if (find(node) == fEntries.end()) {
+      insert(fEntries.begin(), node, 0);
+    }
+  }
+
+  // Marks the node as rendered in the frame. Its usage is measured again, as it may have been decoded since.
+  void touch(std::shared_ptr<Node> const &node, size_t frame) {
+    auto found = find(node);
+    if (found == fEntries.end()) {
+      insert(fEntries.end(), node, frame);
+      return;
+    }
+    found->fFrame = frame;
+    update(*found, node->memoryUsage());
+    fEntries.splice(fEntries.end(), fEntries, found);
+  }
+
+  // Returns the number of nodes evicted. Chunks are deflated on pool, and evicted by retrieve later.
+  size_t evict(size_t frame, TaskQueue &pool, DeflateCompletions &completions) {
+    using namespace std;
+    size_t evicted = 0;
+    // Chunks being deflated are counted as evicted already, so that no more is evicted than needed.
+    size_t deflating = 0;
+    for (auto it = fEntries.begin(); it != fEntries.end() && fUsage - deflating > fBudget;) {
+      if (it->fFrame == frame) {
+        // Everything after this has been rendered in this frame as well.
+        break;
+      }
+      auto node = it->fNode.lock();
+      if (!node) {
+        it = erase(it);
+        continue;
+      }
+      if (auto c = node->compound(); c && c->fTape && c->fName.index() == 0) {
+        if (!c->fEdited) {
+          if (fDeflating.insert(node.get()).second) {
+            Deflate(node, *c, pool, completions);
+          }
+          deflating += std::min(it->fBytes, fUsage - deflating);
+        }
+        it++;
+        continue;
+      }
+      Region::ValueType chunks;
+      if (auto r = node->region(); r && r->fValue.index() == 0) {
+        chunks = get<0>(r->fValue);
+      }
+      if (!node->evict()) {
+        it++;
+        continue;
+      }
+      for (auto const &chunk : chunks) {
+        if (chunk) {
+          forget(chunk.get());
+        }
+      }
+      evicted++;
+      if (node->fileUnopened()) {
+        it = erase(it);
+      } else {
+        update(*it, node->memoryUsage());
+        it++;
+      }
+    }
+    return evicted;
+  }
+
+  // Evicts the chunks deflated since the last call, unless they have been edited or rendered in frame meanwhile. Returns
+  // the number of chunks evicted.
+  size_t retrieve(size_t frame, DeflateCompletions &completions) {
+    size_t evicted = 0;
+    completions.drain([this, frame, &evicted](ChunkDeflated &&deflated) {
+      fDeflating.erase(deflated.fKey);
+      auto node = deflated.fNode.lock();
+      if (!node) {
+        return;
+      }
+      auto found = find(node);
+      if (found == fEntries.end() || found->fFrame == frame) {
+        return;
+      }
+      if (auto c = node->compound(); c && c->dematerialize(std::move(deflated.fCompressed), deflated.fRevision)) {
+        update(*found, node->memoryUsage());
+        evicted++;
+      }
+    });
+    return evicted;
+  }
+
+  void clear() {
+    fEntries.clear();
+    fIndex.clear();
+    fDeflating.clear();
+    fUsage = 0;
+  }
+
+  size_t usage() const {
+    return fUsage;
+  }
+
+  size_t budget() const {
+    return fBudget;
+  }
+
+  void setBudget(size_t budget) {
+    fBudget = budget;
+  }
+
+private:
+  // The tape is copied out on the UI thread, as the chunk may be edited while it is deflated.
+  static void Deflate(std::shared_ptr<Node> const &node, Compound const &c, TaskQueue &pool, DeflateCompletions &completions) {
+    using namespace std;
+    weak_ptr<Node> weak = node;
+    pool.enqueue("DeflateChunk", TaskPriority::Low, [&completions, weak, key = node.get(), revision = c.fRevision, bytes = c.fTape->bytes()]() mutable {
+      if (!mcfile::Compression::Compress(bytes)) {
+        bytes.clear();
+      }
+      completions.push(ChunkDeflated{weak, key, revision, std::move(bytes)});
+    });
+  }
+
+  struct Entry {
+    std::weak_ptr<Node> fNode;
+    Node const *fKey;
+    size_t fBytes;
+    size_t fFrame;
+  };
+
+  std::list<Entry>::iterator find(std::shared_ptr<Node> const &node) {
+    auto found = fIndex.find(node.get());
+    if (found == fIndex.end()) {
+      return fEntries.end();
+    }
+    if (found->second->fNode.lock() != node) {
+      // The node has gone, and its address has been reused.
+      erase(found->second);
+      return fEntries.end();
+    }
+    return found->second;
+  }
+
+  void insert(std::list<Entry>::iterator pos, std::shared_ptr<Node> const &node, size_t frame) {
+    size_t bytes = node->memoryUsage();
+    auto it = fEntries.insert(pos, Entry{node, node.get(), bytes, frame});
+    fIndex[node.get()] = it;
+    fUsage += bytes;
+  }
+
+  void update(Entry &entry, size_t bytes) {
+    fUsage = fUsage - entry.fBytes + bytes;
+    entry.fBytes = bytes;
+  }
+
+  std::list<Entry>::iterator erase(std::list<Entry>::iterator it) {
+    fUsage -= it->fBytes;
+    fIndex.erase(it->fKey);
+    return fEntries.erase(it);
+  }
+
+  void forget(Node const *node) {
+    if (auto found = fIndex.find(node); found != fIndex.end()) {
+      erase(found->second);
+    }
+  }
+
+  std::list<Entry> fEntries;
+  std::unordered_map<Node const *, std::list<Entry>::iterator> fIndex;
+  // Chunks being deflated.
+  std::set<Node const *> fDeflating;
+  size_t fUsage = 0;
+  size_t fBudget = kDefaultBudget;
+};
+
+} // namespace nbte
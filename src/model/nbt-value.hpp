@@ -0,0 +1,215 @@
+#pragma once
+
+namespace nbte {
+
+// A tag read through the same accessors whether it is held as mcfile::nbt::Tag or in a Tape, so that a tree is walked by
+// one traversal for both. Values are cheap to copy, and only valid while the tag or tape they point into is.
+//
+// forEachChild calls fn(i, name, child) for the children of a compound or list. name is null for items of a list.
+class TagValue {
+public:
+  using Type = mcfile::nbt::Tag::Type;
+
+  // Editing a string keeps the addresses of the tags, which the filter cache is keyed by.
+  static constexpr bool kStableEntries = true;
+
+  explicit TagValue(std::shared_ptr<mcfile::nbt::Tag> const &tag) : fTag(tag) {}
+
+  Type type() const {
+    return fTag->type();
+  }
+
+  // Children of a compound or list, or elements of an array.
+  uint32_t size() const {
+    using namespace mcfile::nbt;
+    switch (fTag->type()) {
+    case Tag::Type::Compound:
+      return (uint32_t)static_cast<CompoundTag const &>(*fTag).size();
+    case Tag::Type::List:
+      return (uint32_t)static_cast<ListTag const &>(*fTag).fValue.size();
+    case Tag::Type::ByteArray:
+      return (uint32_t)array<uint8_t>().size();
+    case Tag::Type::IntArray:
+      return (uint32_t)array<int32_t>().size();
+    case Tag::Type::LongArray:
+      return (uint32_t)array<int64_t>().size();
+    default:
+      return 0;
+    }
+  }
+
+  template <class T>
+  T scalar() const {
+    return value<T>();
+  }
+
+  template <class T>
+  void setScalar(T v) {
+    value<T>() = v;
+  }
+
+  template <class T>
+  T element(uint32_t i) const {
+    return array<T>()[i];
+  }
+
+  template <class T>
+  void setElement(uint32_t i, T v) {
+    array<T>()[i] = v;
+  }
+
+  String const &string() const {
+    return static_cast<mcfile::nbt::StringTag const &>(*fTag).fValue;
+  }
+
+  bool setString(String const &v) {
+    static_cast<mcfile::nbt::StringTag &>(*fTag).fValue = v;
+    return true;
+  }
+
+  template <class Fn>
+  void forEachChild(Fn &&fn) const {
+    using namespace mcfile::nbt;
+    if (fTag->type() == Tag::Type::Compound) {
+      uint32_t i = 0;
+      for (auto const &it : static_cast<CompoundTag const &>(*fTag)) {
+        if (it.second) {
+          fn(i, &it.first, TagValue(it.second));
+        }
+        i++;
+      }
+    } else if (fTag->type() == Tag::Type::List) {
+      auto const &list = static_cast<ListTag const &>(*fTag).fValue;
+      for (uint32_t i = 0; i < list.size(); i++) {
+        if (list[i]) {
+          fn(i, nullptr, TagValue(list[i]));
+        }
+      }
+    }
+  }
+
+  // What the filter caches are keyed by.
+  std::shared_ptr<mcfile::nbt::Tag> const &entry() const {
+    return fTag;
+  }
+
+  // Whether name, the key this value is held under, matches. cache is a FilterCache or State.
+  template <class Cache>
+  bool matchKey(Cache &, String const &name, FilterKey const &filter) const {
+    return filter.match(name);
+  }
+
+  void record(EditJournal &journal, Compound const &root, uint32_t element = EditJournal::kNoElement) const {
+    journal.record(root, *fTag, element);
+  }
+
+private:
+  template <class T>
+  T &value() const {
+    using namespace mcfile::nbt;
+    if constexpr (std::is_same_v<T, uint8_t>) {
+      return static_cast<ByteTag &>(*fTag).fValue;
+    } else if constexpr (std::is_same_v<T, int16_t>) {
+      return static_cast<ShortTag &>(*fTag).fValue;
+    } else if constexpr (std::is_same_v<T, int32_t>) {
+      return static_cast<IntTag &>(*fTag).fValue;
+    } else if constexpr (std::is_same_v<T, int64_t>) {
+      return static_cast<LongTag &>(*fTag).fValue;
+    } else if constexpr (std::is_same_v<T, float>) {
+      return static_cast<FloatTag &>(*fTag).fValue;
+    } else {
+      static_assert(std::is_same_v<T, double>);
+      return static_cast<DoubleTag &>(*fTag).fValue;
+    }
+  }
+
+  template <class T>
+  std::vector<T> &array() const {
+    using namespace mcfile::nbt;
+    if constexpr (std::is_same_v<T, uint8_t>) {
+      return static_cast<ByteArrayTag &>(*fTag).fValue;
+    } else if constexpr (std::is_same_v<T, int32_t>) {
+      return static_cast<IntArrayTag &>(*fTag).fValue;
+    } else {
+      static_assert(std::is_same_v<T, int64_t>);
+      return static_cast<LongArrayTag &>(*fTag).fValue;
+    }
+  }
+
+  std::shared_ptr<mcfile::nbt::Tag> fTag;
+};
+
+class TapeValue {
+public:
+  using Type = Tape::Type;
+
+  // setString rebuilds the entries of the tape, which the filter cache is keyed by.
+  static constexpr bool kStableEntries = false;
+
+  TapeValue(Tape &tape, uint32_t index) : fTape(&tape), fIndex(index) {}
+
+  Type type() const {
+    return fTape->type(fIndex);
+  }
+
+  uint32_t size() const {
+    return fTape->size(fIndex);
+  }
+
+  template <class T>
+  T scalar() const {
+    return fTape->scalar<T>(fIndex);
+  }
+
+  template <class T>
+  void setScalar(T v) {
+    fTape->setScalar(fIndex, v);
+  }
+
+  template <class T>
+  T element(uint32_t i) const {
+    return fTape->element<T>(fIndex, i);
+  }
+
+  template <class T>
+  void setElement(uint32_t i, T v) {
+    fTape->setElement(fIndex, i, v);
+  }
+
+  String string() const {
+    return fTape->string(fIndex);
+  }
+
+  bool setString(String const &v) {
+    return fTape->setString(fIndex, v);
+  }
+
+  template <class Fn>
+  void forEachChild(Fn &&fn) const {
+    bool compound = type() == Type::Compound;
+    for (uint32_t i = 0; i < size(); i++) {
+      uint32_t child = fTape->child(fIndex, i);
+      fn(i, compound ? &fTape->name(child) : nullptr, TapeValue(*fTape, child));
+    }
+  }
+
+  TapeEntry entry() const {
+    return TapeEntry{fTape, fIndex};
+  }
+
+  // Keys are compared by their id in KeyTable, which the cache remembers the result for.
+  template <class Cache>
+  bool matchKey(Cache &cache, String const &, FilterKey const &filter) const {
+    return cache.matchKey(fTape->key(fIndex), filter);
+  }
+
+  void record(EditJournal &journal, Compound const &root, uint32_t element = EditJournal::kNoElement) const {
+    journal.record(root, *fTape, fIndex, element);
+  }
+
+private:
+  Tape *fTape;
+  uint32_t fIndex;
+};
+
+} // namespace nbte
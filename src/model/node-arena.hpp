@@ -0,0 +1,190 @@
+#pragma once
+
+namespace nbte {
+
+class Node;
+
+// Backing storage for all the Nodes under one opened root. Node and its shared_ptr control block are allocated together
+// from large blocks, so siblings sit next to each other in memory, and closing a world releases the blocks at once
+// instead of freeing every node separately. Freed slots are recycled through a free list per size class.
+//
+// The arena is created with the root and counts the allocations made from it, so that it goes away with the last node
+// rather than with the root, as nodes are also held outside the tree. The allocators only hold a raw pointer to it.
+//
+// Every node also has a Handle, an index into the table of the arena, which nodes link to their parent with instead of a
+// weak_ptr. A handle stays valid while its node is alive, and its index is reused with a new generation afterwards.
+class NodeArena {
+public:
+  static constexpr size_t kBlockSize = 256 * 1024;
+
+  struct Handle {
+    static constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+    uint32_t fIndex = kNone;
+    uint32_t fGeneration = 0;
+  };
+
+  template <class T>
+  class Allocator {
+  public:
+    using value_type = T;
+
+    explicit Allocator(NodeArena *arena) : fArena(arena) {}
+
+    template <class U>
+    Allocator(Allocator<U> const &other) : fArena(other.fArena) {}
+
+    T *allocate(size_t n) {
+      static_assert(alignof(T) <= alignof(std::max_align_t));
+      return (T *)fArena->allocate(sizeof(T) * n);
+    }
+
+    void deallocate(T *p, size_t n) {
+      fArena->deallocate(p, sizeof(T) * n);
+    }
+
+    template <class U>
+    bool operator==(Allocator<U> const &other) const {
+      return fArena == other.fArena;
+    }
+
+    template <class U>
+    bool operator!=(Allocator<U> const &other) const {
+      return fArena != other.fArena;
+    }
+
+    NodeArena *fArena;
+  };
+
+  // Deleted by the deallocation of the last node allocated from it.
+  static NodeArena *Make() {
+    return new NodeArena;
+  }
+
+  NodeArena(NodeArena const &) = delete;
+  NodeArena &operator=(NodeArena const &) = delete;
+
+  void *allocate(size_t size) {
+    using namespace std;
+    size = Align(max(size, sizeof(void *)), kAlignment);
+    fAllocations.fetch_add(1, memory_order_relaxed);
+    if (size > kMaxPooledSize) {
+      return ::operator new(size);
+    }
+    lock_guard<mutex> lock(fMutex);
+    void *&head = fFree[size / kAlignment - 1];
+    if (head) {
+      void *p = head;
+      head = *(void **)p;
+      return p;
+    }
+    if (fBlocks.empty() || fUsed + size > kBlockSize) {
+      fBlocks.push_back(make_unique<max_align_t[]>(kBlockSize / sizeof(max_align_t)));
+      fCurrent = (uint8_t *)fBlocks.back().get();
+      fUsed = 0;
+    }
+    void *p = fCurrent + fUsed;
+    fUsed += size;
+    return p;
+  }
+
+  void deallocate(void *p, size_t size) {
+    using namespace std;
+    size = Align(max(size, sizeof(void *)), kAlignment);
+    if (size > kMaxPooledSize) {
+      ::operator delete(p);
+    } else {
+      lock_guard<mutex> lock(fMutex);
+      void *&head = fFree[size / kAlignment - 1];
+      *(void **)p = head;
+      head = p;
+    }
+    if (fAllocations.fetch_sub(1, memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  // Called by the constructor of the node.
+  Handle add() {
+    using namespace std;
+    lock_guard<mutex> lock(fMutex);
+    uint32_t index;
+    if (fFreeHandles.empty()) {
+      index = fHandleCount++;
+      auto [segment, offset] = Locate(index);
+      if (offset == 0) {
+        fSegments[segment].store(new Slot[kFirstSegmentSize << segment], memory_order_release);
+      }
+    } else {
+      index = fFreeHandles.back();
+      fFreeHandles.pop_back();
+    }
+    // Odd generations are alive, and even ones free.
+    uint32_t generation = slot(index).fGeneration.fetch_add(1, memory_order_release) + 1;
+    return Handle{index, generation};
+  }
+
+  // Called by the destructor of the node.
+  void remove(Handle handle) {
+    using namespace std;
+    slot(handle.fIndex).fGeneration.fetch_add(1, memory_order_release);
+    lock_guard<mutex> lock(fMutex);
+    fFreeHandles.push_back(handle.fIndex);
+  }
+
+  // Whether the node of the handle is still alive. Lock free, as it is called for every row drawn.
+  bool alive(Handle handle) const {
+    if (handle.fIndex == Handle::kNone) {
+      return false;
+    }
+    return slot(handle.fIndex).fGeneration.load(std::memory_order_acquire) == handle.fGeneration;
+  }
+
+private:
+  static constexpr size_t kAlignment = alignof(std::max_align_t);
+  static constexpr size_t kMaxPooledSize = 1024;
+  // The table is made of segments twice as large as the one before, which never move once made, so that alive() can
+  // read them while add() makes new ones.
+  static constexpr uint32_t kFirstSegmentBits = 10;
+  static constexpr uint32_t kFirstSegmentSize = 1u << kFirstSegmentBits;
+  static constexpr size_t kSegments = 32 - kFirstSegmentBits;
+
+  struct Slot {
+    std::atomic<uint32_t> fGeneration = 0;
+  };
+
+  NodeArena() = default;
+
+  ~NodeArena() {
+    for (auto &segment : fSegments) {
+      delete[] segment.load(std::memory_order_relaxed);
+    }
+  }
+
+  static std::pair<uint32_t, uint32_t> Locate(uint32_t index) {
+    uint64_t i = uint64_t(index) + kFirstSegmentSize;
+    uint32_t segment = (uint32_t)std::bit_width(i) - 1 - kFirstSegmentBits;
+    return std::make_pair(segment, uint32_t(i - (uint64_t(kFirstSegmentSize) << segment)));
+  }
+
+  Slot &slot(uint32_t index) const {
+    auto [segment, offset] = Locate(index);
+    return fSegments[segment].load(std::memory_order_acquire)[offset];
+  }
+
+  static size_t Align(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+  std::mutex fMutex;
+  std::atomic<size_t> fAllocations = 0;
+  std::vector<std::unique_ptr<std::max_align_t[]>> fBlocks;
+  uint8_t *fCurrent = nullptr;
+  size_t fUsed = 0;
+  std::array<void *, kMaxPooledSize / kAlignment> fFree{};
+  std::array<std::atomic<Slot *>, kSegments> fSegments{};
+  uint32_t fHandleCount = 0;
+  std::vector<uint32_t> fFreeHandles;
+};
+
+} // namespace nbte
@@ -0,0 +1,140 @@
+#pragma once
+
+namespace nbte {
+
+class Node;
+
+// Sizes of a Compound or Region, measured by the worker decoding it.
+struct NodeSize {
+  struct Subtree {
+    String fPath;
+    uint64_t fDecoded;
+  };
+
+  static constexpr size_t kLargestCount = 8;
+
+  // Bytes of uncompressed NBT.
+  uint64_t fDecoded = 0;
+  // Bytes stored on disk.
+  uint64_t fCompressed = 0;
+  // The largest compounds and lists inside, largest first. Paths are relative to the root compound.
+  std::vector<Subtree> fLargest;
+
+  static NodeSize Measure(Tape const &tape, uint64_t decoded, uint64_t compressed) {
+    using namespace std;
+    using Type = Tape::Type;
+
+    NodeSize ret;
+    ret.fDecoded = decoded;
+    ret.fCompressed = compressed;
+
+    // Children always come after their parent, so walking backwards sees every child before its parent.
+    uint32_t count = tape.entries();
+    vector<uint64_t> sizes(count, 0);
+    vector<uint32_t> parents(count, 0);
+    vector<uint32_t> candidates;
+    for (uint32_t i = count; i-- > 0;) {
+      uint64_t size = 0;
+      switch (tape.type(i)) {
+      case Type::Byte:
+        size = 1;
+        break;
+      case Type::Short:
+        size = 2;
+        break;
+      case Type::Int:
+      case Type::Float:
+        size = 4;
+        break;
+      case Type::Long:
+      case Type::Double:
+        size = 8;
+        break;
+      case Type::String:
+        size = 2 + (uint64_t)tape.size(i);
+        break;
+      case Type::ByteArray:
+        size = 4 + (uint64_t)tape.size(i);
+        break;
+      case Type::IntArray:
+        size = 4 + 4 * (uint64_t)tape.size(i);
+        break;
+      case Type::LongArray:
+        size = 4 + 8 * (uint64_t)tape.size(i);
+        break;
+      case Type::List:
+        size = 1 + 4;
+        for (uint32_t j = 0; j < tape.size(i); j++) {
+          uint32_t child = tape.child(i, j);
+          size += sizes[child];
+          parents[child] = i;
+        }
+        break;
+      case Type::Compound:
+        size = 1;
+        for (uint32_t j = 0; j < tape.size(i); j++) {
+          uint32_t child = tape.child(i, j);
+          size += 1 + 2 + tape.name(child).size() + sizes[child];
+          parents[child] = i;
+        }
+        break;
+      default:
+        break;
+      }
+      sizes[i] = size;
+      if (i > 0 && (tape.type(i) == Type::Compound || tape.type(i) == Type::List)) {
+        candidates.push_back(i);
+      }
+    }
+
+    size_t largest = min(kLargestCount, candidates.size());
+    partial_sort(candidates.begin(), candidates.begin() + largest, candidates.end(), [&sizes](uint32_t a, uint32_t b) {
+      return sizes[a] > sizes[b];
+    });
+    for (size_t i = 0; i < largest; i++) {
+      ret.fLargest.push_back(Subtree{SubtreePath(tape, parents, candidates[i]), sizes[candidates[i]]});
+    }
+    return ret;
+  }
+
+private:
+  static String SubtreePath(Tape const &tape, std::vector<uint32_t> const &parents, uint32_t index) {
+    using namespace std;
+    vector<String> names;
+    for (uint32_t i = index; i != 0; i = parents[i]) {
+      uint32_t parent = parents[i];
+      if (tape.type(parent) == Tape::Type::List) {
+        for (uint32_t j = 0; j < tape.size(parent); j++) {
+          if (tape.child(parent, j) == i) {
+            names.push_back(u8"#" + ToString(j));
+            break;
+          }
+        }
+      } else {
+        names.push_back(tape.name(i));
+      }
+    }
+    String ret;
+    for (auto it = names.rbegin(); it != names.rend(); it++) {
+      if (!ret.empty()) {
+        ret += u8"/";
+      }
+      ret += *it;
+    }
+    return ret;
+  }
+};
+
+// A row of the largest items report.
+struct SizeReportItem {
+  String fName;
+  char8_t const *fKind;
+  uint64_t fDecoded;
+  // Zero for subtrees, which are not stored on their own.
+  uint64_t fCompressed;
+  // Set for chunks and their subtrees, to locate them in the tree.
+  std::weak_ptr<Node> fRegion;
+  std::optional<mcfile::Pos2i> fChunk;
+};
+
+} // namespace nbte
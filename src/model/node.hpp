@@ -3,18 +3,52 @@
 namespace nbte {
 
 class Node;
-class State;
+class Compound;
+class MemoryBudget;
 
-class Region {
+// Pushed by the task loading a region or a file, and applied by the UI thread with Node::Loaded.
+struct RegionLoaded {
+  std::weak_ptr<Node> fOwner;
+  CancellationToken fToken;
+  std::optional<std::vector<std::shared_ptr<Node>>> fChunks;
+  // Set for a file, to null when it is not NBT.
+  std::optional<std::shared_ptr<Compound>> fFile;
+};
+
+using RegionCompletions = CompletionQueue<RegionLoaded>;
+
+class RegionHeader {
 public:
-  Region(hwm::task_queue &queue, int x, int z, Path const &path, std::shared_ptr<Node> const &owner);
+  struct Entry {
+    uint32_t fSectorOffset = 0;
+    uint32_t fSectorCount = 0;
+    uint32_t fTimestamp = 0;
+
+    bool present() const {
+      return fSectorOffset != 0 && fSectorCount != 0;
+    }
+  };
 
-  bool wait(State &s);
-  String save(TemporaryDirectory &temp);
-  bool isDirty() const;
+  static std::optional<RegionHeader> Read(Path const &file);
+
+  static constexpr uint64_t kSectorSize = 4096;
+
+  std::array<Entry, 1024> fEntries;
+};
+
+class Region {
+public:
+  Region(TaskQueue &queue, RegionCompletions &completions, int x, int z, Path const &path, std::shared_ptr<Node> const &owner);
 
   using ValueType = std::vector<std::shared_ptr<Node>>;
 
+  bool ready() const {
+    return fValue.index() == 0;
+  }
+  // Chunks are accounted by budget when it is given.
+  void loaded(MemoryBudget *budget, std::optional<ValueType> &&chunks);
+  bool isDirty() const;
+
   static size_t Index(int localChunkX, int localChunkZ) {
     return localChunkZ * 32 + localChunkX;
   }
@@ -22,14 +56,20 @@ public:
   Path fFile;
   int fX;
   int fZ;
-  std::variant<ValueType, std::shared_ptr<std::future<std::optional<ValueType>>>> fValue;
+  // monostate while loading.
+  std::variant<ValueType, std::monostate> fValue;
   std::weak_ptr<Node> fOwner;
+  // To raise the priority of loading while the region is visible.
+  TaskQueue::Handle fLoadTask;
+  // Stops the loading task when the region is closed, or dropped with the tree.
+  CancellationSource fCancellation;
+  // Sum of the chunks, once loaded.
+  NodeSize fSize;
 };
 
 class DirectoryContents {
 public:
   DirectoryContents(Path const &dir, std::shared_ptr<Node> parent);
-  String save(TemporaryDirectory &temp);
   bool dirtyFiles(std::vector<Path> *buffer = nullptr) const;
 
   Path fDir;
@@ -48,17 +88,52 @@ public:
   };
 
   Compound(Path const &name, std::shared_ptr<mcfile::nbt::CompoundTag> const &tag, Format format) : fName(name), fTag(tag), fFormat(format) {}
-  Compound(String const &name, int cx, int cz, std::shared_ptr<mcfile::nbt::CompoundTag> const &tag, Format format) : fName(name), fTag(tag), fFormat(format), fChunkX(cx), fChunkZ(cz) {}
+  Compound(String const &name, Path const &regionFile, int cx, int cz, std::shared_ptr<Tape> const &tape, Format format) : fName(name), fTape(tape), fFormat(format), fChunkX(cx), fChunkZ(cz), fRegionFile(regionFile) {}
+
+  // Deflated formats are compressed on pool when it is given.
+  static String Write(mcfile::nbt::CompoundTag const &tag, Format format, Path const &file, SaveProfile profile, TaskQueue *pool);
 
-  String save(Path const &file);
-  String save();
   String name() const;
   std::optional<Path> filePathIfEdited() const;
 
+  void markEdited() {
+    fEdited = true;
+    fRevision++;
+  }
+
+  // Decodes fCompressed without keeping the result.
+  std::shared_ptr<Tape> decode() const;
+  // Decodes an evicted chunk, and drops its deflated bytes.
+  bool materialize();
+  // Evicts the chunk, keeping compressed, its tape deflated at revision. Fails when it has been edited since.
+  bool dematerialize(std::vector<uint8_t> &&compressed, uint64_t revision);
+
   std::variant<String, Path> fName;
+  // Files are held as fTag. Chunks in a region are held as fTape while decoded, and as fCompressed once evicted.
   std::shared_ptr<mcfile::nbt::CompoundTag> fTag;
+  std::shared_ptr<Tape> fTape;
+  // Deflated NBT of an evicted chunk.
+  std::vector<uint8_t> fCompressed;
+  // Estimated when the file is read.
+  size_t fTagMemoryUsage = 0;
+  NodeSize fSize;
   Format fFormat;
   bool fEdited = false;
+  // Increased on every edit, to tell whether a saved snapshot is still up to date.
+  uint64_t fRevision = 0;
+  int fChunkX = 0;
+  int fChunkZ = 0;
+  // The region a chunk is stored in.
+  Path fRegionFile;
+};
+
+// Stands for a chunk of a region which couldn't be read or decoded, so that the rest of the region can still be seen and
+// the chunk can still be located.
+class BrokenChunk {
+public:
+  String fName;
+  // Why the chunk couldn't be read.
+  String fError;
   int fChunkX = 0;
   int fChunkZ = 0;
 };
@@ -72,19 +147,24 @@ public:
     TypeUnsupportedFile,
     TypeRegion,
     TypeCompound,
+    TypeBrokenChunk,
   };
   using Value = std::variant<DirectoryContents, // DirectoryContents
                              Path,              // FileUnopened
                              Path,              // DirectoryUnopened
                              Path,              // UnsupportedFile
                              Region,            // Region
-                             Compound           // Compound
+                             Compound,          // Compound
+                             BrokenChunk        // BrokenChunk
                              >;
 
-  Node(Value &&value, std::shared_ptr<Node> parent);
+  Node(Value &&value, std::shared_ptr<Node> const &parent, NodeArena *arena);
+  ~Node();
 
-  void load(hwm::task_queue &queue);
-  String save(TemporaryDirectory &temp);
+  // Regions and files are read on queue, and their results pushed to completions.
+  void load(TaskQueue &queue, RegionCompletions &completions);
+  // Whether a region or a file is being read.
+  bool loading() const;
 
   DirectoryContents const *directoryContents() const;
   DirectoryContents *directoryContents();
@@ -95,23 +175,48 @@ public:
   Path const *unsupportedFile() const;
   Region *region();
   Region const *region() const;
+  BrokenChunk const *brokenChunk() const;
 
   String description() const;
+  // Whether the node has a parent which is still alive.
   bool hasParent() const;
-  void clearDirty();
+  // The file or directory of the node, unless it is a chunk.
+  std::optional<Path> path() const;
   bool dirtyFiles(std::vector<Path> *buffer = nullptr) const;
 
-  static std::shared_ptr<Node> OpenDirectory(Path const &path, hwm::task_queue &queue);
-  static std::shared_ptr<Node> OpenFile(Path const &path, hwm::task_queue &queue);
+  // Memory held by this node. Chunks in a region are accounted on their own nodes.
+  size_t memoryUsage() const;
+  // Closes an unedited file or region back to unopened, see close. Chunks are evicted by MemoryBudget instead, which
+  // deflates them on the pool first.
+  bool evict();
+  // Closes an unedited file or region back to unopened. A region still loading stops loading.
+  bool close();
+  // Stops the loading of every region in this subtree.
+  void cancel();
+
+  static std::shared_ptr<Node> OpenDirectory(Path const &path, TaskQueue &queue, RegionCompletions &completions);
+  static std::shared_ptr<Node> OpenFile(Path const &path, TaskQueue &queue, RegionCompletions &completions);
 
   static std::shared_ptr<Node> DirectoryUnopened(Path const &path, std::shared_ptr<Node> const &parent);
   static std::shared_ptr<Node> FileUnopened(Path const &path, std::shared_ptr<Node> const &parent);
 
+  // Allocates the node from the arena of parent, or from a new arena when parent is null.
+  static std::shared_ptr<Node> Make(Value &&value, std::shared_ptr<Node> const &parent);
+
+  // Applies a result pushed by the task started by load. Returns the node it was applied to, or null when the result is
+  // not wanted anymore. Chunks are accounted by budget when it is given.
+  static std::shared_ptr<Node> Loaded(RegionLoaded &&loaded, MemoryBudget *budget);
+
 private:
   Value fValue;
+  NodeArena *const fArena;
+  NodeArena::Handle const fHandle;
+  // Set while the file is read on the pool.
+  std::optional<CancellationSource> fLoading;
 
 public:
-  std::weak_ptr<Node> const fParent;
+  // In the same arena. Unset for a root.
+  NodeArena::Handle const fParent;
 };
 
 } // namespace nbte
@@ -2,28 +2,28 @@
 
 namespace nbte {
 
-std::shared_ptr<Node> Node::OpenDirectory(Path const &path, hwm::task_queue &queue) {
+std::shared_ptr<Node> Node::OpenDirectory(Path const &path, TaskQueue &queue, RegionCompletions &completions) {
   using namespace std;
   auto ret = DirectoryUnopened(path, nullptr);
-  ret->load(queue);
+  ret->load(queue, completions);
   return ret;
 }
 
-std::shared_ptr<Node> Node::OpenFile(Path const &path, hwm::task_queue &queue) {
+std::shared_ptr<Node> Node::OpenFile(Path const &path, TaskQueue &queue, RegionCompletions &completions) {
   using namespace std;
   auto ret = FileUnopened(path, nullptr);
-  ret->load(queue);
+  ret->load(queue, completions);
   return ret;
 }
 
 std::shared_ptr<Node> Node::DirectoryUnopened(Path const &path, std::shared_ptr<Node> const &parent) {
   using namespace std;
-  return shared_ptr<Node>(new Node(Value(in_place_index<TypeDirectoryUnopened>, path), parent));
+  return Make(Value(in_place_index<TypeDirectoryUnopened>, path), parent);
 }
 
 std::shared_ptr<Node> Node::FileUnopened(Path const &path, std::shared_ptr<Node> const &parent) {
   using namespace std;
-  return shared_ptr<Node>(new Node(Value(in_place_index<TypeFileUnopened>, path), parent));
+  return Make(Value(in_place_index<TypeFileUnopened>, path), parent);
 }
 
 static std::shared_ptr<mcfile::nbt::CompoundTag> ReadCompound(Path const &path, Compound::Format *format) {
@@ -61,7 +61,119 @@ static std::shared_ptr<mcfile::nbt::CompoundTag> ReadCompound(Path const &path,
   return nullptr;
 }
 
-Node::Node(Node::Value &&value, std::shared_ptr<Node> parent) : fValue(value), fParent(parent) {}
+// Adds the memory held by the tag, and the bytes it takes as uncompressed NBT excluding its type and name.
+static void MeasureTag(std::shared_ptr<mcfile::nbt::Tag> const &tag, size_t *memory, uint64_t *encoded) {
+  using namespace std;
+  using namespace mcfile::nbt;
+
+  // Approximates a node of std::map, and the shared_ptr control block allocated with each tag.
+  constexpr size_t kMapNodeOverhead = 4 * sizeof(void *);
+  constexpr size_t kControlBlock = 2 * sizeof(void *);
+
+  switch (tag->type()) {
+  case Tag::Type::Compound:
+    if (auto v = dynamic_pointer_cast<CompoundTag>(tag); v) {
+      *memory += sizeof(CompoundTag) + kControlBlock;
+      *encoded += 1;
+      for (auto const &it : *v) {
+        *memory += kMapNodeOverhead + sizeof(it) + it.first.capacity();
+        *encoded += 1 + 2 + it.first.size();
+        MeasureTag(it.second, memory, encoded);
+      }
+      return;
+    }
+    break;
+  case Tag::Type::List:
+    if (auto v = dynamic_pointer_cast<ListTag>(tag); v) {
+      *memory += sizeof(ListTag) + kControlBlock + v->fValue.capacity() * sizeof(shared_ptr<Tag>);
+      *encoded += 1 + 4;
+      for (auto const &it : v->fValue) {
+        MeasureTag(it, memory, encoded);
+      }
+      return;
+    }
+    break;
+  case Tag::Type::String:
+    if (auto v = dynamic_pointer_cast<StringTag>(tag); v) {
+      *memory += sizeof(StringTag) + kControlBlock + v->fValue.capacity();
+      *encoded += 2 + v->fValue.size();
+      return;
+    }
+    break;
+  case Tag::Type::ByteArray:
+    if (auto v = dynamic_pointer_cast<ByteArrayTag>(tag); v) {
+      *memory += sizeof(ByteArrayTag) + kControlBlock + v->fValue.capacity() * sizeof(v->fValue[0]);
+      *encoded += 4 + v->fValue.size() * sizeof(v->fValue[0]);
+      return;
+    }
+    break;
+  case Tag::Type::IntArray:
+    if (auto v = dynamic_pointer_cast<IntArrayTag>(tag); v) {
+      *memory += sizeof(IntArrayTag) + kControlBlock + v->fValue.capacity() * sizeof(v->fValue[0]);
+      *encoded += 4 + v->fValue.size() * sizeof(v->fValue[0]);
+      return;
+    }
+    break;
+  case Tag::Type::LongArray:
+    if (auto v = dynamic_pointer_cast<LongArrayTag>(tag); v) {
+      *memory += sizeof(LongArrayTag) + kControlBlock + v->fValue.capacity() * sizeof(v->fValue[0]);
+      *encoded += 4 + v->fValue.size() * sizeof(v->fValue[0]);
+      return;
+    }
+    break;
+  case Tag::Type::Byte:
+    *encoded += 1;
+    break;
+  case Tag::Type::Short:
+    *encoded += 2;
+    break;
+  case Tag::Type::Int:
+  case Tag::Type::Float:
+    *encoded += 4;
+    break;
+  case Tag::Type::Long:
+  case Tag::Type::Double:
+    *encoded += 8;
+    break;
+  default:
+    break;
+  }
+  // Scalars. The largest of them holds a double.
+  *memory += sizeof(DoubleTag) + kControlBlock;
+}
+
+// Runs on the pool. Measuring walks the whole tag, so it is done here instead of in the frame that opened the file.
+static std::shared_ptr<Compound> ReadFile(Path const &file) {
+  using namespace std;
+  Compound::Format format;
+  auto tag = ReadCompound(file, &format);
+  if (!tag) {
+    return nullptr;
+  }
+  auto compound = make_shared<Compound>(file, tag, format);
+  uint64_t decoded = 0;
+  MeasureTag(tag, &compound->fTagMemoryUsage, &decoded);
+  // The root compound is written with its type and an empty name.
+  compound->fSize.fDecoded = 1 + 2 + decoded;
+  error_code ec;
+  if (auto size = filesystem::file_size(file, ec); !ec) {
+    compound->fSize.fCompressed = size;
+  }
+  return compound;
+}
+
+std::shared_ptr<Node> Node::Make(Value &&value, std::shared_ptr<Node> const &parent) {
+  using namespace std;
+  NodeArena *arena = parent ? parent->fArena : NodeArena::Make();
+  return allocate_shared<Node>(NodeArena::Allocator<Node>(arena), std::move(value), parent, arena);
+}
+
+Node::Node(Node::Value &&value, std::shared_ptr<Node> const &parent, NodeArena *arena) : fValue(std::move(value)), fArena(arena), fHandle(arena->add()), fParent(parent ? parent->fHandle : NodeArena::Handle()) {}
+
+// The arena is kept alive by the allocation of the node, which is released after the destructor.
+Node::~Node() {
+  fArena->remove(fHandle);
+}
 
 DirectoryContents const *Node::directoryContents() const {
   if (fValue.index() != TypeDirectoryContents) {
@@ -126,6 +238,13 @@ Region const *Node::region() const {
   return &std::get<TypeRegion>(fValue);
 }
 
+BrokenChunk const *Node::brokenChunk() const {
+  if (fValue.index() != TypeBrokenChunk) {
+    return nullptr;
+  }
+  return &std::get<TypeBrokenChunk>(fValue);
+}
+
 String Node::description() const {
   if (auto compound = this->compound(); compound) {
     switch (compound->fFormat) {
@@ -149,29 +268,27 @@ String Node::description() const {
 }
 
 bool Node::hasParent() const {
-  return fParent.use_count() != 0;
+  return fArena->alive(fParent);
 }
 
-void Node::clearDirty() {
+std::optional<Path> Node::path() const {
   if (auto contents = directoryContents(); contents) {
-    for (auto const &it : contents->fValue) {
-      it->clearDirty();
-    }
+    return contents->fDir;
+  } else if (auto unopened = fileUnopened(); unopened) {
+    return *unopened;
+  } else if (auto unopened = directoryUnopened(); unopened) {
+    return *unopened;
   } else if (auto r = region(); r) {
-    if (r->fValue.index() == 0) {
-      for (auto const &it : std::get<0>(r->fValue)) {
-        if (!it) {
-          continue;
-        }
-        it->clearDirty();
-      }
-    }
-  } else if (auto c = compound(); c) {
-    c->fEdited = false;
+    return r->fFile;
+  } else if (auto c = compound(); c && c->fName.index() == 1) {
+    return std::get<1>(c->fName);
+  } else if (auto unsupported = unsupportedFile(); unsupported) {
+    return *unsupported;
   }
+  return std::nullopt;
 }
 
-void Node::load(hwm::task_queue &queue) {
+void Node::load(TaskQueue &queue, RegionCompletions &completions) {
   using namespace std;
 
   if (auto unopened = directoryUnopened(); unopened) {
@@ -180,32 +297,141 @@ void Node::load(hwm::task_queue &queue) {
     return;
   }
   if (auto unopened = fileUnopened(); unopened) {
-    Compound::Format format;
-    if (auto tag = ReadCompound(*unopened, &format); tag) {
-      fValue = Value(std::in_place_index<TypeCompound>, Compound(*unopened, tag, format));
+    if (auto pos = mcfile::je::Region::RegionXZFromFile(*unopened); pos) {
+      fValue = Value(std::in_place_index<TypeRegion>, Region(queue, completions, pos->fX, pos->fZ, *unopened, shared_from_this()));
       return;
     }
-
-    if (auto pos = mcfile::je::Region::RegionXZFromFile(*unopened); pos) {
-      fValue = Value(std::in_place_index<TypeRegion>, Region(queue, pos->fX, pos->fZ, *unopened, shared_from_this()));
+    if (fLoading) {
       return;
     }
-
-    fValue = Value(std::in_place_index<TypeUnsupportedFile>, *unopened);
+    fLoading = CancellationSource();
+    CancellationToken token = fLoading->token();
+    weak_ptr<Node> weak = shared_from_this();
+    queue.enqueue("ReadFile", TaskPriority::High, [&completions, token, weak, file = *unopened]() {
+      if (token.cancelled()) {
+        return;
+      }
+      completions.push(RegionLoaded{weak, token, nullopt, ReadFile(file)});
+    });
     return;
   }
 }
 
-String Node::save(TemporaryDirectory &temp) {
+bool Node::loading() const {
   if (auto r = region(); r) {
-    return r->save(temp);
-  } else if (auto contents = directoryContents(); contents) {
-    return contents->save(temp);
-  } else if (auto c = compound(); c) {
-    return c->save();
+    return !r->ready();
   }
+  return fLoading.has_value();
+}
 
-  return u8"";
+std::shared_ptr<Node> Node::Loaded(RegionLoaded &&loaded, MemoryBudget *budget) {
+  using namespace std;
+  if (loaded.fToken.cancelled()) {
+    // Closed or reloaded while loading.
+    return nullptr;
+  }
+  auto owner = loaded.fOwner.lock();
+  if (!owner) {
+    return nullptr;
+  }
+  if (loaded.fFile) {
+    auto unopened = owner->fileUnopened();
+    if (!unopened || !owner->fLoading) {
+      return nullptr;
+    }
+    owner->fLoading.reset();
+    if (auto const &compound = *loaded.fFile; compound) {
+      owner->fValue = Value(in_place_index<TypeCompound>, std::move(*compound));
+    } else {
+      Path file = *unopened;
+      owner->fValue = Value(in_place_index<TypeUnsupportedFile>, file);
+    }
+    return owner;
+  }
+  auto region = owner->region();
+  if (!region || region->ready()) {
+    return nullptr;
+  }
+  region->loaded(budget, std::move(loaded.fChunks));
+  return owner;
+}
+
+size_t Node::memoryUsage() const {
+  size_t ret = sizeof(Node);
+  if (auto c = compound(); c) {
+    ret += c->fTagMemoryUsage + c->fCompressed.capacity();
+    if (c->fTape) {
+      ret += c->fTape->memoryUsage();
+    }
+  } else if (auto r = region(); r) {
+    if (r->fValue.index() == 0) {
+      ret += std::get<0>(r->fValue).capacity() * sizeof(std::shared_ptr<Node>);
+    }
+  } else if (auto broken = brokenChunk(); broken) {
+    ret += broken->fName.capacity() + broken->fError.capacity();
+  }
+  return ret;
+}
+
+bool Node::evict() {
+  using namespace std;
+  if (!hasParent()) {
+    return false;
+  }
+  if (auto c = compound(); c) {
+    if (c->fEdited) {
+      return false;
+    }
+    if (c->fTape) {
+      // Chunks are deflated on the pool by MemoryBudget, and evicted once that has finished.
+      return false;
+    }
+  } else if (auto r = region(); r) {
+    if (r->fValue.index() != 0) {
+      // Nothing decoded to drop yet.
+      return false;
+    }
+  }
+  return close();
+}
+
+bool Node::close() {
+  using namespace std;
+  if (!hasParent()) {
+    return false;
+  }
+  if (auto c = compound(); c) {
+    if (c->fEdited || c->fName.index() != 1) {
+      return false;
+    }
+    Path file = get<1>(c->fName);
+    fValue = Value(in_place_index<TypeFileUnopened>, file);
+    return true;
+  } else if (auto r = region(); r) {
+    if (r->isDirty()) {
+      return false;
+    }
+    r->fCancellation.cancel();
+    Path file = r->fFile;
+    fValue = Value(in_place_index<TypeFileUnopened>, file);
+    return true;
+  } else if (fLoading) {
+    // Stops reading, so that opening the file again starts over.
+    fLoading.reset();
+  }
+  return false;
+}
+
+void Node::cancel() {
+  if (auto contents = directoryContents(); contents) {
+    for (auto const &child : contents->fValue) {
+      child->cancel();
+    }
+  } else if (auto r = region(); r) {
+    r->fCancellation.cancel();
+  } else if (fLoading) {
+    fLoading->cancel();
+  }
 }
 
 bool Node::dirtyFiles(std::vector<Path> *buffer) const {
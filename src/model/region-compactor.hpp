@@ -0,0 +1,81 @@
+#pragma once
+
+namespace nbte {
+
+// Rewrites region files with the chunks packed one after another in the order of their index, so that no sector is
+// left unused and every chunk takes only the sectors it needs. Compressed payloads and timestamps are copied as is.
+class RegionCompactor {
+public:
+  struct Result {
+    Path fFile;
+    uint64_t fBefore = 0;
+    uint64_t fAfter = 0;
+    String fError;
+
+    uint64_t reclaimed() const {
+      return fBefore > fAfter ? fBefore - fAfter : 0;
+    }
+  };
+
+  // Compacts the files in parallel on pool, and waits for all of them.
+  static std::vector<Result> CompactAll(std::vector<Path> const &files, TaskQueue &pool) {
+    using namespace std;
+    vector<future<Result>> tasks;
+    tasks.reserve(files.size());
+    for (auto const &file : files) {
+      tasks.push_back(pool.enqueue("CompactRegion", TaskPriority::Normal, Compact, file).fFuture);
+    }
+    vector<Result> results;
+    results.reserve(tasks.size());
+    for (auto &task : tasks) {
+      results.push_back(task.get());
+    }
+    return results;
+  }
+
+  static Result Compact(Path const &file) {
+    using namespace std;
+    constexpr size_t kSectorSize = RegionHeader::kSectorSize;
+    constexpr size_t kHeaderSize = 2 * kSectorSize;
+
+    Result result;
+    result.fFile = file;
+
+    vector<uint8_t> in;
+    if (!ReadWholeFile(file, in)) {
+      result.fError = u8"Can't read the file";
+      return result;
+    }
+    result.fBefore = in.size();
+    result.fAfter = in.size();
+    if (in.empty()) {
+      return result;
+    }
+    if (in.size() < kHeaderSize) {
+      result.fError = u8"Broken header";
+      return result;
+    }
+
+    vector<uint8_t> out(kHeaderSize, 0);
+    out.reserve(in.size());
+    for (size_t index = 0; index < 1024; index++) {
+      if (auto err = CopyChunk(in, index, out); !err.empty()) {
+        result.fError = err;
+        return result;
+      }
+    }
+    if (out == in) {
+      return result;
+    }
+
+    // Written the same way as saving, so a crash leaves either the old file or the new one.
+    if (!ReplaceWholeFile(file, out)) {
+      result.fError = u8"Can't write the file";
+      return result;
+    }
+    result.fAfter = out.size();
+    return result;
+  }
+};
+
+} // namespace nbte
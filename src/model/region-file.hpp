@@ -0,0 +1,168 @@
+#pragma once
+
+namespace nbte {
+
+// Helpers for tools reading .mca files as a whole, without going through mcfile.
+
+static bool IsRegionFile(Path const &file) {
+  return file.extension() == u8".mca" && mcfile::je::Region::RegionXZFromFile(file);
+}
+
+// The region files under target, or target itself when it is a region file.
+static std::vector<Path> ListRegionFiles(Path const &target) {
+  using namespace std;
+  namespace fs = std::filesystem;
+  vector<Path> files;
+  error_code ec;
+  if (fs::is_regular_file(target, ec)) {
+    if (IsRegionFile(target)) {
+      files.push_back(target);
+    }
+    return files;
+  }
+  for (auto it = fs::recursive_directory_iterator(target, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    if (it->is_regular_file(ec) && IsRegionFile(it->path())) {
+      files.push_back(it->path());
+    }
+  }
+  sort(files.begin(), files.end());
+  return files;
+}
+
+static bool ReadWholeFile(Path const &file, std::vector<uint8_t> &out) {
+  using namespace std;
+  namespace fs = std::filesystem;
+  FILE *fp = OpenFileStream(file, u8"rb");
+  if (!fp) {
+    return false;
+  }
+  // Read with a single call, as the files are read by many threads at once.
+  error_code ec;
+  auto size = fs::file_size(file, ec);
+  if (ec) {
+    fclose(fp);
+    return false;
+  }
+  out.resize(size);
+  size_t read = out.empty() ? 0 : fread(out.data(), 1, out.size(), fp);
+  out.resize(read);
+  bool ok = ferror(fp) == 0;
+  fclose(fp);
+  return ok;
+}
+
+static uint32_t LoadBigEndian32(uint8_t const *p) {
+  return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+}
+
+static void StoreBigEndian32(uint8_t *p, uint32_t v) {
+  p[0] = uint8_t(v >> 24);
+  p[1] = uint8_t(v >> 16);
+  p[2] = uint8_t(v >> 8);
+  p[3] = uint8_t(v);
+}
+
+// Appends a chunk to out, a region file being built from its header on, as the chunk at index. The payload is the
+// compression type followed by size bytes of data, padded to whole sectors. Returns false when it doesn't fit in the
+// 255 sectors a chunk can have.
+static bool AppendChunk(std::vector<uint8_t> &out, size_t index, uint8_t type, uint8_t const *data, size_t size, uint32_t timestamp) {
+  constexpr size_t kSectorSize = RegionHeader::kSectorSize;
+  size_t sectors = (5 + size + kSectorSize - 1) / kSectorSize;
+  if (sectors > 0xff) {
+    return false;
+  }
+  size_t position = out.size();
+  out.resize(position + sectors * kSectorSize, 0);
+  StoreBigEndian32(out.data() + position, uint32_t(1 + size));
+  out[position + 4] = type;
+  if (size > 0) {
+    memcpy(out.data() + position + 5, data, size);
+  }
+  StoreBigEndian32(out.data() + 4 * index, uint32_t(position / kSectorSize) << 8 | uint32_t(sectors));
+  StoreBigEndian32(out.data() + kSectorSize + 4 * index, timestamp);
+  return true;
+}
+
+// Appends the chunk at index of the region file in to out as it is stored, without decoding it, along with its
+// timestamp. Returns what is broken, or empty when the chunk has been copied or has not been saved yet.
+static String CopyChunk(std::vector<uint8_t> const &in, size_t index, std::vector<uint8_t> &out) {
+  constexpr size_t kSectorSize = RegionHeader::kSectorSize;
+  constexpr size_t kHeaderSize = 2 * kSectorSize;
+  uint32_t loc = LoadBigEndian32(in.data() + 4 * index);
+  if (loc == 0) {
+    return {};
+  }
+  uint64_t offset = uint64_t(loc >> 8) * kSectorSize;
+  if (offset < kHeaderSize || offset + 4 > in.size()) {
+    return u8"Chunk #" + ToString(index) + u8" is out of the file";
+  }
+  uint32_t length = LoadBigEndian32(in.data() + offset);
+  if (length == 0) {
+    // Not saved yet.
+    return {};
+  }
+  // The last sector of a file is not always padded.
+  if (offset + 4 + length > in.size()) {
+    return u8"Chunk #" + ToString(index) + u8" is out of the file";
+  }
+  size_t sectors = (4 + length + kSectorSize - 1) / kSectorSize;
+  if (sectors > 0xff) {
+    return u8"Chunk #" + ToString(index) + u8" is too large";
+  }
+  size_t position = out.size();
+  out.insert(out.end(), in.begin() + offset, in.begin() + offset + 4 + length);
+  out.resize(position + sectors * kSectorSize, 0);
+  StoreBigEndian32(out.data() + 4 * index, uint32_t(position / kSectorSize) << 8 | uint32_t(sectors));
+  memcpy(out.data() + kSectorSize + 4 * index, in.data() + kSectorSize + 4 * index, 4);
+  return {};
+}
+
+// Returned by DecodeChunk for LZ4 chunks with a valid header, which only Minecraft itself can decode.
+static constexpr char8_t kLz4Unsupported[] = u8"LZ4 compression is not supported";
+
+// Decodes the payload of a chunk of regionFile, the compression type followed by the compressed data as stored in the
+// sectors of the chunk, into out. A chunk too large for the sectors is stored in c.<x>.<z>.mcc next to the region
+// instead, which the 0x80 flag on the type tells. compressed is set to the size of the compressed data. Returns what is
+// broken, or empty when out has been decoded.
+static String DecodeChunk(Path const &regionFile, int chunkX, int chunkZ, uint8_t const *payload, size_t size, std::vector<uint8_t> &out, uint64_t *compressed = nullptr) {
+  using namespace std;
+  if (size == 0) {
+    return u8"Length is zero";
+  }
+  uint8_t type = payload[0];
+  uint8_t const *data = payload + 1;
+  size_t length = size - 1;
+  vector<uint8_t> external;
+  if (type & 0x80) {
+    Path file = regionFile.parent_path() / (u8"c." + ToString(chunkX) + u8"." + ToString(chunkZ) + u8".mcc");
+    if (!ReadWholeFile(file, external)) {
+      return u8"External chunk file is missing";
+    }
+    data = external.data();
+    length = external.size();
+  }
+  if (compressed) {
+    *compressed = length;
+  }
+  switch (type & 0x7f) {
+  case 1:
+  case 2:
+    if (!Inflate(data, length, out)) {
+      return u8"Can't decompress";
+    }
+    return {};
+  case 3:
+    out.assign(data, data + length);
+    return {};
+  case 4:
+    // Written by LZ4BlockOutputStream of lz4-java, which starts every block with this.
+    if (length < 8 || memcmp(data, "LZ4Block", 8) != 0) {
+      return u8"LZ4 header is broken";
+    }
+    return kLz4Unsupported;
+  default:
+    return u8"Unknown compression type " + ToString((int)(type & 0x7f));
+  }
+}
+
+} // namespace nbte
@@ -0,0 +1,135 @@
+#pragma once
+
+namespace nbte {
+
+// Checks region files for the damage a crash can leave: a broken header, chunks overlapping each other or running past
+// their sectors or the end of the file, unknown compression types, and chunks which can't be decoded. Each file is read
+// with a single call and checked by a task of its own, so a folder is scanned by the whole pool.
+class RegionScanner {
+public:
+  struct Issue {
+    Path fFile;
+    // Unset for problems of the file as a whole.
+    std::optional<mcfile::Pos2i> fChunk;
+    String fMessage;
+  };
+
+  struct Progress {
+    std::atomic<size_t> fScanned = 0;
+    std::atomic<size_t> fTotal = 0;
+  };
+
+  static std::vector<Issue> ScanAll(Path const &target, TaskQueue &pool, Progress &progress) {
+    using namespace std;
+    vector<Path> files = ListRegionFiles(target);
+    progress.fTotal = files.size();
+    vector<future<vector<Issue>>> tasks;
+    tasks.reserve(files.size());
+    for (auto const &file : files) {
+      auto scan = [&progress](Path const &file) {
+        auto issues = Scan(file);
+        progress.fScanned++;
+        return issues;
+      };
+      tasks.push_back(pool.enqueue("ScanRegion", TaskPriority::Normal, scan, file).fFuture);
+    }
+    vector<Issue> issues;
+    for (auto &task : tasks) {
+      auto found = task.get();
+      issues.insert(issues.end(), make_move_iterator(found.begin()), make_move_iterator(found.end()));
+    }
+    return issues;
+  }
+
+  static std::vector<Issue> Scan(Path const &file) {
+    using namespace std;
+    constexpr size_t kSectorSize = RegionHeader::kSectorSize;
+    constexpr size_t kHeaderSectors = 2;
+
+    vector<Issue> issues;
+    auto pos = mcfile::je::Region::RegionXZFromFile(file);
+    if (!pos) {
+      return issues;
+    }
+    vector<uint8_t> data;
+    if (!ReadWholeFile(file, data)) {
+      issues.push_back(Issue{file, nullopt, u8"Can't read the file"});
+      return issues;
+    }
+    if (data.empty()) {
+      return issues;
+    }
+    if (data.size() < kHeaderSectors * kSectorSize) {
+      issues.push_back(Issue{file, nullopt, u8"Header is truncated"});
+      return issues;
+    }
+
+    // Index of the chunk using each sector.
+    size_t const sectors = (data.size() + kSectorSize - 1) / kSectorSize;
+    vector<int> owners(sectors, -1);
+    for (int index = 0; index < 1024; index++) {
+      mcfile::Pos2i chunk(pos->fX * 32 + index % 32, pos->fZ * 32 + index / 32);
+      auto report = [&issues, &file, chunk](String const &message) {
+        issues.push_back(Issue{file, chunk, message});
+      };
+      uint32_t loc = LoadBigEndian32(data.data() + 4 * index);
+      if (loc == 0) {
+        continue;
+      }
+      size_t offset = loc >> 8;
+      size_t count = loc & 0xff;
+      if (count == 0) {
+        report(u8"Sector count is zero");
+        continue;
+      }
+      if (offset < kHeaderSectors) {
+        report(u8"Sectors overlap the header");
+        continue;
+      }
+      if (offset * kSectorSize + 5 > data.size()) {
+        report(u8"Sectors are beyond the end of the file");
+        continue;
+      }
+      set<int> overlapped;
+      for (size_t sector = offset; sector < min(offset + count, sectors); sector++) {
+        if (owners[sector] >= 0) {
+          overlapped.insert(owners[sector]);
+        } else {
+          owners[sector] = index;
+        }
+      }
+      for (int other : overlapped) {
+        report(u8"Sectors overlap with chunk " + ToString(pos->fX * 32 + other % 32) + u8" " + ToString(pos->fZ * 32 + other / 32));
+      }
+
+      uint8_t const *payload = data.data() + offset * kSectorSize;
+      uint32_t length = LoadBigEndian32(payload);
+      if (length == 0) {
+        report(u8"Length is zero");
+        continue;
+      }
+      if (length + 4 > count * kSectorSize) {
+        report(u8"Length exceeds the sectors of the chunk");
+        continue;
+      }
+      if (offset * kSectorSize + 4 + length > data.size()) {
+        report(u8"Data is beyond the end of the file");
+        continue;
+      }
+      // The same decoding as the tree, so that a chunk reported here is the one shown as broken there.
+      vector<uint8_t> decompressed;
+      if (auto err = DecodeChunk(file, chunk.fX, chunk.fZ, payload + 4, length, decompressed); err == kLz4Unsupported) {
+        continue;
+      } else if (!err.empty()) {
+        report(err);
+        continue;
+      }
+      if (!Tape::Parse(std::move(decompressed), mcfile::Endian::Big)) {
+        report(u8"Can't parse NBT");
+      }
+    }
+    return issues;
+  }
+};
+
+} // namespace nbte
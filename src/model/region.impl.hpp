@@ -2,182 +2,178 @@
 
 namespace nbte {
 
-static std::optional<Region::ValueType> ReadRegion(int rx, int rz, Path path, std::shared_ptr<Node> parent) {
+// Reads the chunk at index of region file and decodes it into buffer, which is left empty when the chunk has not been
+// saved yet. compressed is set to the size of the stored bytes. Returns what is broken, or empty when the chunk could be
+// read. A truncated header is a problem of the file rather than of the chunk, so the chunk is taken as not saved.
+static String ReadChunk(mcfile::stream::InputStreamReader &sr, Path const &file, int chunkX, int chunkZ, uint64_t index, std::vector<uint8_t> &buffer, uint64_t &compressed) {
   using namespace std;
-
-  Region::ValueType ret;
-  ret.resize(1024);
-
   constexpr uint64_t kSectorSize = 4096;
 
-  auto stream = make_shared<mcfile::stream::FileInputStream>(path);
-  mcfile::stream::InputStreamReader sr(stream, mcfile::Endian::Big);
+  if (!sr.valid()) {
+    return u8"Can't read the file";
+  }
+  uint32_t loc;
+  if (!sr.seek(4 * index) || !sr.read(&loc)) {
+    return {};
+  }
+  if (loc == 0) {
+    // chunk not saved yet
+    return {};
+  }
 
-  for (int z = 0; z < 32; z++) {
-    for (int x = 0; x < 32; x++) {
-      uint64_t const index = (x & 31) + (z & 31) * 32;
-      if (!sr.valid()) {
-        return nullopt;
-      }
-      if (!sr.seek(4 * index)) {
-        return nullopt;
-      }
+  uint64_t sectorOffset = loc >> 8;
+  uint32_t timestamp;
+  if (!sr.seek(kSectorSize + 4 * index) || !sr.read(&timestamp)) {
+    return {};
+  }
 
-      uint32_t loc;
-      if (!sr.read(&loc)) {
-        return nullopt;
-      }
-      if (loc == 0) {
-        // chunk not saved yet
-        continue;
-      }
+  if (!sr.seek(sectorOffset * kSectorSize)) {
+    return u8"Sectors are beyond the end of the file";
+  }
+  uint32_t chunkSize;
+  if (!sr.read(&chunkSize)) {
+    return u8"Sectors are beyond the end of the file";
+  }
+  if (chunkSize == 0) {
+    // chunk not saved yet
+    return {};
+  }
+  if (chunkSize > 255 * kSectorSize) {
+    return u8"Length exceeds the sectors of the chunk";
+  }
+  vector<uint8_t> payload(chunkSize);
+  if (!sr.read(payload)) {
+    return u8"Data is beyond the end of the file";
+  }
+  vector<uint8_t> decoded;
+  if (auto err = DecodeChunk(file, chunkX, chunkZ, payload.data(), payload.size(), decoded, &compressed); !err.empty()) {
+    return err;
+  }
+  buffer.swap(decoded);
+  return {};
+}
 
-      uint64_t sectorOffset = loc >> 8;
-      if (!sr.seek(kSectorSize + 4 * index)) {
-        return nullopt;
-      }
+static std::optional<Region::ValueType> ReadRegion(TaskQueue *queue, CancellationToken token, int rx, int rz, Path path, std::weak_ptr<Node> parent) {
+  using namespace std;
 
-      uint32_t timestamp;
-      if (!sr.read(&timestamp)) {
-        return nullopt;
-      }
+  // The owner is needed as the parent of the chunks. Gone means nobody waits for the result.
+  auto owner = parent.lock();
+  if (!owner) {
+    return nullopt;
+  }
 
-      if (!sr.seek(sectorOffset * kSectorSize)) {
-        return nullopt;
-      }
-      uint32_t chunkSize;
-      if (!sr.read(&chunkSize)) {
-        return nullopt;
-      }
-      if (chunkSize == 0) {
-        // chunk not saved yet
-        continue;
-      }
-#if 0
-      UnopenedChunk uc(path, sectorOffset * kSectorSize, chunkSize, rx * 32 + x, rz * 32 + z, x, z);
-      auto node = shared_ptr<Node>(new Node(Node::Value(in_place_index<Node::TypeUnopenedChunk>, uc), parent));
-#else
-      // NOTE: Code for debug: Loading all chunks immediately
-      if (!sr.seek(sectorOffset * kSectorSize + sizeof(uint32_t))) {
-        return nullopt;
-      }
-      uint8_t compressionType;
-      if (!sr.read(&compressionType)) {
-        return nullopt;
-      }
-      if (compressionType != 2) {
-        return nullopt;
-      }
-      vector<uint8_t> buffer(chunkSize - 1);
-      if (!sr.read(buffer)) {
-        return nullopt;
+  Region::ValueType ret;
+  ret.resize(1024);
+
+  // Each row of chunks is read and decoded by one piece with a stream of its own, so that reading a row overlaps decoding
+  // the others on the rest of the pool.
+  atomic<bool> ok = true;
+  queue->parallelFor(32, [&](size_t row) {
+    int z = (int)row;
+    auto stream = make_shared<mcfile::stream::FileInputStream>(path);
+    mcfile::stream::InputStreamReader sr(stream, mcfile::Endian::Big);
+    if (!sr.valid()) {
+      ok = false;
+      return;
+    }
+    for (int x = 0; x < 32; x++) {
+      if (!ok.load(memory_order_relaxed)) {
+        return;
       }
-      auto tag = mcfile::nbt::CompoundTag::ReadCompressed(buffer, mcfile::Endian::Big);
-      if (!tag) {
-        return nullopt;
+      if (token.cancelled()) {
+        ok = false;
+        return;
       }
+      // A broken chunk is shown as a BrokenChunk with the error, so that the rest of the region can still be seen.
       int cx = rx * 32 + x;
       int cz = rz * 32 + z;
+      vector<uint8_t> buffer;
+      uint64_t size = 0;
+      String error = ReadChunk(sr, path, cx, cz, Region::Index(x, z), buffer, size);
+      if (buffer.empty() && error.empty()) {
+        continue;
+      }
       String name(u8"Chunk " + ToString(cx) + u8" " + ToString(cz) + u8" [" + ToString(x) + u8" " + ToString(z) + u8" in region]");
-      auto node = shared_ptr<Node>(new Node(Node::Value(in_place_index<Node::TypeCompound>, Compound(name, cx, cz, tag, Compound::Format::DeflatedBigEndian)), parent));
-#endif
-      ret[Region::Index(x, z)].swap(node);
+      shared_ptr<Tape> tape;
+      uint64_t decoded = buffer.size();
+      if (error.empty()) {
+        BlobPool &pool = BlobPool::Shared();
+        tape = Tape::Parse(std::move(buffer), mcfile::Endian::Big, pool.enabled() ? &pool : nullptr);
+        if (!tape) {
+          error = u8"Can't parse the NBT";
+        }
+      }
+      if (!tape) {
+        BrokenChunk broken{name, error, cx, cz};
+        ret[Region::Index(x, z)] = Node::Make(Node::Value(in_place_index<Node::TypeBrokenChunk>, std::move(broken)), owner);
+        continue;
+      }
+      // The deflated bytes are dropped, and made again from the tape if the chunk is evicted.
+      Compound compound(name, path, cx, cz, tape, Compound::Format::DeflatedBigEndian);
+      compound.fSize = NodeSize::Measure(*tape, decoded, size);
+      ret[Region::Index(x, z)] = Node::Make(Node::Value(in_place_index<Node::TypeCompound>, std::move(compound)), owner);
     }
+  });
+  if (!ok) {
+    return nullopt;
   }
 
   return ret;
 }
 
-Region::Region(hwm::task_queue &queue, int x, int z, Path const &file, std::shared_ptr<Node> const &owner) : fFile(file), fX(x), fZ(z), fOwner(owner) {
-  fValue = std::make_shared<std::future<std::optional<ValueType>>>(queue.enqueue(ReadRegion, x, z, file, owner));
-}
-
-bool Region::wait(State &s) {
+std::optional<RegionHeader> RegionHeader::Read(Path const &file) {
   using namespace std;
-  if (fValue.index() == 0) {
-    return true;
-  }
-  shared_ptr<future<optional<ValueType>>> future = get<1>(fValue);
-  auto state = future->wait_for(chrono::seconds(0));
-  if (state != future_status::ready) {
-    return false;
+
+  auto stream = make_shared<mcfile::stream::FileInputStream>(file);
+  mcfile::stream::InputStreamReader sr(stream, mcfile::Endian::Big);
+  if (!sr.valid()) {
+    return nullopt;
   }
-  if (auto owner = fOwner.lock(); owner) {
-    s.revokeFilterCache(owner);
+  RegionHeader header;
+  for (auto &entry : header.fEntries) {
+    uint32_t loc;
+    if (!sr.read(&loc)) {
+      return nullopt;
+    }
+    entry.fSectorOffset = loc >> 8;
+    entry.fSectorCount = loc & 0xff;
   }
-  if (auto v = future->get(); v) {
-    fValue = *v;
-  } else {
-    fValue = ValueType(1024);
+  for (auto &entry : header.fEntries) {
+    if (!sr.read(&entry.fTimestamp)) {
+      return nullopt;
+    }
   }
-  future.reset();
-  return true;
+  return header;
 }
 
-String Region::save(TemporaryDirectory &tempRoot) {
+Region::Region(TaskQueue &queue, RegionCompletions &completions, int x, int z, Path const &file, std::shared_ptr<Node> const &owner) : fFile(file), fX(x), fZ(z), fValue(std::monostate()), fOwner(owner) {
+  CancellationToken token = fCancellation.token();
+  std::weak_ptr<Node> weak = owner;
+  auto task = queue.enqueue("ReadRegion", TaskPriority::Normal, [&queue, &completions, token, x, z, file, weak]() {
+    completions.push(RegionLoaded{weak, token, ReadRegion(&queue, token, x, z, file, weak)});
+  });
+  fLoadTask = task.fHandle;
+}
+
+void Region::loaded(MemoryBudget *budget, std::optional<ValueType> &&chunks) {
   using namespace std;
-  namespace fs = std::filesystem;
-  if (fValue.index() != 0) {
-    return u8"";
+  if (chunks) {
+    fValue = std::move(*chunks);
+  } else {
+    fValue = ValueType(1024);
   }
-  auto const &r = get<0>(fValue);
-  bool dirty = isDirty();
-  if (!dirty) {
-    return u8"";
-  }
-
-  Path temp = tempRoot.createTempChildDirectory();
-  Path backup = temp / fFile.filename();
-  error_code ec;
-  fs::rename(fFile, backup, ec);
-  if (ec) {
-    ec.clear();
-    fs::remove_all(temp, ec);
-    return u8"IO Error";
-  }
-  ec.clear();
-
-  auto out = make_shared<mcfile::stream::FileOutputStream>(fFile);
-  auto region = mcfile::je::Region::MakeRegion(backup);
-  if (!region) {
-    return u8"IO Error";
-  }
-  bool ok = mcfile::je::Region::SquashChunksAsMca(*out, [this, &r, region](int x, int z, mcfile::stream::OutputStream &output, bool &stop) {
-    for (auto const &it : r) {
-      if (!it) {
-        continue;
-      }
-      auto c = it->compound();
-      if (!c) {
-        continue;
-      }
-      if (x != c->fChunkX - fX * 32) {
-        continue;
-      }
-      if (z != c->fChunkZ - fZ * 32) {
-        continue;
-      }
-      if (!mcfile::nbt::CompoundTag::WriteCompressed(*c->fTag, output, mcfile::Endian::Big)) {
-        stop = true;
-        return;
-      }
+  fSize = NodeSize();
+  for (auto const &chunk : get<0>(fValue)) {
+    if (!chunk) {
+      continue;
     }
-    if (!region->exportToCompressedNbt(fX * 32 + x, fZ * 32 + z, output)) {
-      stop = true;
+    if (budget) {
+      budget->track(chunk);
+    }
+    if (auto c = chunk->compound(); c) {
+      fSize.fDecoded += c->fSize.fDecoded;
+      fSize.fCompressed += c->fSize.fCompressed;
     }
-  });
-  out.reset();
-
-  if (ok) {
-    fs::remove_all(temp, ec);
-    return u8"";
-  } else {
-    fs::remove(fFile, ec);
-    ec.clear();
-    fs::rename(backup, fFile, ec);
-    ec.clear();
-    fs::remove_all(temp, ec);
-    return u8"IO error";
   }
 }
 
@@ -0,0 +1,231 @@
+#pragma once
+
+namespace nbte {
+
+// Copy of the edited files taken when saving starts. The save queue writes the copy while the tree goes on being
+// edited, and only the compounds not edited again in the meantime are marked as saved when it has finished.
+class SaveSnapshot {
+public:
+  explicit SaveSnapshot(SaveProfile profile) : fProfile(profile) {}
+
+  // Must be called on the UI thread.
+  static std::shared_ptr<SaveSnapshot> Capture(std::shared_ptr<Node> const &root, SaveProfile profile) {
+    auto ret = std::make_shared<SaveSnapshot>(profile);
+    ret->capture(root);
+    return ret;
+  }
+
+  // Adds a file or chunk not held by the tree, so it is not marked as saved by commit.
+  void addFile(Path const &path, std::shared_ptr<mcfile::nbt::CompoundTag> const &tag, Compound::Format format) {
+    fFiles.push_back(File{path, tag, format, {}, 0});
+  }
+
+  void addChunk(Path const &regionFile, int rx, int rz, int localX, int localZ, std::shared_ptr<Tape const> const &tape) {
+    using namespace std;
+    auto found = find_if(fRegions.begin(), fRegions.end(), [&regionFile](RegionFile const &r) { return r.fFile == regionFile; });
+    if (found == fRegions.end()) {
+      fRegions.push_back(RegionFile{regionFile, rx, rz, {}});
+      found = prev(fRegions.end());
+    }
+    Chunk chunk;
+    chunk.fLocalX = localX;
+    chunk.fLocalZ = localZ;
+    chunk.fTape = tape;
+    found->fChunks.push_back(std::move(chunk));
+  }
+
+  bool empty() const {
+    return fFiles.empty() && fRegions.empty();
+  }
+
+  // Runs on the save queue. Compression is spread over pool. Every file is written next to itself and renamed over the
+  // original, so a crash while saving leaves each file either as it was or as saved.
+  String write(TaskQueue &pool) {
+    for (auto const &file : fFiles) {
+      if (auto err = Compound::Write(*file.fTag, file.fFormat, file.fPath, fProfile, &pool); !err.empty()) {
+        return err;
+      }
+    }
+    for (auto &region : fRegions) {
+      if (auto err = writeRegion(region, pool); !err.empty()) {
+        return err;
+      }
+    }
+    return u8"";
+  }
+
+  // Called on the UI thread once write has succeeded.
+  void commit() {
+    using namespace std;
+    for (auto const &file : fFiles) {
+      if (auto node = file.fNode.lock(); node) {
+        if (auto c = node->compound(); c && c->fRevision == file.fRevision) {
+          c->fEdited = false;
+        }
+      }
+    }
+    for (auto &region : fRegions) {
+      for (auto &chunk : region.fChunks) {
+        auto node = chunk.fNode.lock();
+        if (!node) {
+          continue;
+        }
+        if (auto c = node->compound(); c && c->fRevision == chunk.fRevision) {
+          c->fEdited = false;
+        }
+      }
+    }
+  }
+
+private:
+  struct File {
+    Path fPath;
+    std::shared_ptr<mcfile::nbt::CompoundTag> fTag;
+    Compound::Format fFormat;
+    std::weak_ptr<Node> fNode;
+    uint64_t fRevision;
+  };
+
+  struct Chunk {
+    int fLocalX;
+    int fLocalZ;
+    // Deflated into fCompressed by compressChunks.
+    std::shared_ptr<Tape const> fTape;
+    std::vector<uint8_t> fCompressed;
+    // Set for the chunks captured from the tree.
+    std::weak_ptr<Node> fNode;
+    uint64_t fRevision = 0;
+  };
+
+  struct RegionFile {
+    Path fFile;
+    int fX;
+    int fZ;
+    std::vector<Chunk> fChunks;
+  };
+
+  void capture(std::shared_ptr<Node> const &node) {
+    using namespace std;
+    if (auto contents = node->directoryContents(); contents) {
+      for (auto const &child : contents->fValue) {
+        capture(child);
+      }
+    } else if (auto r = node->region(); r) {
+      if (!r->isDirty()) {
+        return;
+      }
+      RegionFile region{r->fFile, r->fX, r->fZ, {}};
+      for (auto const &it : get<0>(r->fValue)) {
+        if (!it) {
+          continue;
+        }
+        // The chunks not edited are the same as in the file, and are copied from there by writeRegion.
+        auto c = it->compound();
+        if (!c || !c->fEdited) {
+          continue;
+        }
+        Chunk chunk;
+        chunk.fLocalX = c->fChunkX - r->fX * 32;
+        chunk.fLocalZ = c->fChunkZ - r->fZ * 32;
+        // Edited chunks are never evicted, so they have a tape. Copying it is cheap as large arrays are shared.
+        chunk.fTape = make_shared<Tape>(*c->fTape);
+        chunk.fNode = it;
+        chunk.fRevision = c->fRevision;
+        region.fChunks.push_back(std::move(chunk));
+      }
+      fRegions.push_back(std::move(region));
+    } else if (auto c = node->compound(); c) {
+      if (!c->fEdited || c->fName.index() != 1 || !c->fTag) {
+        return;
+      }
+      fFiles.push_back(File{get<1>(c->fName), c->fTag->copy(), c->fFormat, node, c->fRevision});
+    }
+  }
+
+  // Chunks are small, so they are deflated one per task instead of in blocks.
+  bool compressChunks(RegionFile &region, TaskQueue &pool) {
+    using namespace std;
+    int level = ParallelDeflate::Level(fProfile);
+    vector<future<bool>> tasks;
+    for (auto &chunk : region.fChunks) {
+      if (!chunk.fTape) {
+        continue;
+      }
+      auto compress = [&chunk, level]() {
+        vector<uint8_t> buffer = chunk.fTape->bytes();
+        if (!ParallelDeflate::Compress(buffer, ParallelDeflate::Container::Zlib, level, nullptr)) {
+          return false;
+        }
+        chunk.fCompressed.swap(buffer);
+        chunk.fTape.reset();
+        return true;
+      };
+      tasks.push_back(pool.enqueue("CompressChunk", TaskPriority::High, compress).fFuture);
+    }
+    bool ok = true;
+    for (auto &task : tasks) {
+      ok = task.get() && ok;
+    }
+    return ok;
+  }
+
+  String writeRegion(RegionFile &region, TaskQueue &pool) {
+    using namespace std;
+    namespace fs = std::filesystem;
+    constexpr size_t kHeaderSize = 2 * RegionHeader::kSectorSize;
+
+    if (!compressChunks(region, pool)) {
+      return u8"Compression failed";
+    }
+
+    // The chunks not edited are copied from the original as they are stored, without decoding them, so that a chunk
+    // broken or compressed in a way not supported here is kept as it was instead of failing the save.
+    vector<uint8_t> in;
+    error_code ec;
+    if (fs::exists(region.fFile, ec) && !ReadWholeFile(region.fFile, in)) {
+      return u8"IO error";
+    }
+    if (in.size() < kHeaderSize) {
+      in.clear();
+    }
+    array<Chunk *, 1024> chunks;
+    chunks.fill(nullptr);
+    for (auto &chunk : region.fChunks) {
+      chunks[Region::Index(chunk.fLocalX, chunk.fLocalZ)] = &chunk;
+    }
+    uint32_t now = (uint32_t)time(nullptr);
+    vector<uint8_t> out(kHeaderSize, 0);
+    out.reserve(max(in.size(), kHeaderSize));
+    for (size_t index = 0; index < 1024; index++) {
+      Chunk *chunk = chunks[index];
+      if (!chunk) {
+        // Sectors out of the file leave nothing to copy, and the chunk is dropped as Minecraft would do.
+        if (!in.empty()) {
+          CopyChunk(in, index, out);
+        }
+        continue;
+      }
+      if (AppendChunk(out, index, 2, chunk->fCompressed.data(), chunk->fCompressed.size(), now)) {
+        continue;
+      }
+      // Too large for a chunk in the region, so written to the external file Minecraft uses for that.
+      int cx = region.fX * 32 + (int)(index % 32);
+      int cz = region.fZ * 32 + (int)(index / 32);
+      Path external = region.fFile.parent_path() / (u8"c." + ToString(cx) + u8"." + ToString(cz) + u8".mcc");
+      if (!ReplaceWholeFile(external, chunk->fCompressed)) {
+        return u8"IO error";
+      }
+      AppendChunk(out, index, 0x82, nullptr, 0, now);
+    }
+    if (!ReplaceWholeFile(region.fFile, out)) {
+      return u8"IO error";
+    }
+    return u8"";
+  }
+
+  SaveProfile const fProfile;
+  std::vector<File> fFiles;
+  std::vector<RegionFile> fRegions;
+};
+
+} // namespace nbte
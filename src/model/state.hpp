@@ -2,6 +2,12 @@
 
 namespace nbte {
 
+enum class ChunkLocatorMode : int {
+  Presence = 0,
+  Size,
+  Timestamp,
+};
+
 class State {
   String fFilterRaw;
   bool fFilterCaseSensitive = false;
@@ -17,19 +23,50 @@ public:
   bool fMainMenuBarHelpAboutOpened = false;
   bool fMainMenuBarHelpOpenSourceLicensesOpened = false;
   bool fDebugOpened = false;
+  bool fDebugMetricsOpened = false;
+  bool fLargestItemsOpened = false;
+  bool fShowSizes = false;
+  // Incremented whenever nodes with a NodeSize are loaded or evicted.
+  uint64_t fSizeGeneration = 0;
+  std::vector<SizeReportItem> fSizeReport;
+  std::optional<uint64_t> fSizeReportGeneration;
 
   std::optional<std::pair<std::shared_ptr<Node>, mcfile::Pos2i>> fChunkLocatorRequest;
   std::optional<std::pair<std::shared_ptr<Node>, mcfile::Pos2i>> fChunkLocatorResponse;
+  std::optional<std::pair<std::shared_ptr<Node>, RegionHeader>> fChunkLocatorHeader;
+  ChunkLocatorMode fChunkLocatorMode = ChunkLocatorMode::Presence;
   std::optional<std::pair<std::shared_ptr<Node>, double>> fChunkFadeTimeout;
 
   bool fQuitRequested = false;
   bool fQuitAccepted = false;
 
-  TemporaryDirectory fTempRoot;
-
   std::shared_ptr<Node> fOpened;
   Path fOpenedPath;
-  std::shared_ptr<std::future<String>> fSaveTask;
+  struct PendingSave {
+    std::shared_ptr<SaveSnapshot> fSnapshot;
+    std::future<String> fFuture;
+  };
+  // Written one after another by fSaveQueue, in the order requested.
+  std::deque<PendingSave> fSaveTasks;
+  SaveProfile fSaveProfile = SaveProfile::Balanced;
+
+  // Region files are rewritten by fSaveQueue, so compaction never overlaps with saving.
+  std::optional<std::future<std::vector<RegionCompactor::Result>>> fCompactionTask;
+  Path fCompactionRoot;
+  std::vector<RegionCompactor::Result> fCompactionReport;
+  bool fCompactionReportOpened = false;
+
+  // Also run by fSaveQueue, so files being saved are not scanned halfway.
+  std::optional<std::future<std::vector<RegionScanner::Issue>>> fScanTask;
+  std::shared_ptr<RegionScanner::Progress> fScanProgress;
+  Path fScanRoot;
+  std::vector<RegionScanner::Issue> fScanReport;
+  bool fScanReportOpened = false;
+
+  EditJournal fJournal;
+  // Edits left unsaved by a previous session, until they are applied or discarded.
+  std::vector<EditJournal::Record> fRecoveredEdits;
+  std::optional<std::future<String>> fRecoveryTask;
 
   String fError;
 
@@ -43,38 +80,127 @@ public:
 
   std::optional<Path> fMinecraftSaveDirectory;
 
-  std::unique_ptr<hwm::task_queue> fPool;
-  std::unique_ptr<hwm::task_queue> fSaveQueue;
+  Tracer fTracer;
+  InputRecorder fRecorder;
+  // Declared before the pools, so that it outlives their workers.
+  RegionCompletions fRegionCompletions;
+  DeflateCompletions fDeflateCompletions;
+  std::unique_ptr<TaskQueue> fPool;
+  std::unique_ptr<TaskQueue> fSaveQueue;
   TextureSet fTextures;
+  FontAtlas fFontAtlas;
 
   FilterCacheSelector<2> fCacheSelector;
+  MemoryBudget fMemoryBudget;
 
   size_t fFrameCount = 0;
 
-  State() : fFilter({}, false), fPool(new hwm::task_queue(std::thread::hardware_concurrency())), fSaveQueue(new hwm::task_queue(1)) {
+  Profiler fProfiler;
+
+  State() : fFilter({}, false), fPool(new TaskQueue("pool", std::thread::hardware_concurrency())), fSaveQueue(new TaskQueue("save", 1)) {
+    fPool->setTracer(&fTracer);
+    fSaveQueue->setTracer(&fTracer);
+  }
+
+  ~State() {
+    // The pools run what is queued before they stop, so regions still loading are cancelled to make that quick.
+    if (fOpened) {
+      fOpened->cancel();
+    }
+    // Saves requested on quit are finished before the queue stops, and then the journal is compacted.
+    for (auto &task : fSaveTasks) {
+      task.fFuture.wait();
+    }
+    retrieveSaveTask();
   }
 
   bool containsTerm(std::shared_ptr<mcfile::nbt::Tag> const &tag, FilterKey const *key, FilterMode mode) {
+    Profiler::Scope scope(fProfiler, Profiler::PhaseFilter);
     return fCacheSelector.containsTerm(tag, key, mode);
   }
 
   bool containsTerm(std::shared_ptr<Node> const &node, FilterKey const *key, FilterMode mode) {
+    Profiler::Scope scope(fProfiler, Profiler::PhaseFilter);
     return fCacheSelector.containsTerm(node, key, mode);
   }
 
-  void loadTextures(void *device) {
-    fTextures.loadTextures(device);
+  bool containsTerm(TapeEntry const &entry, FilterKey const *key, FilterMode mode) {
+    Profiler::Scope scope(fProfiler, Profiler::PhaseFilter);
+    return fCacheSelector.containsTerm(entry, key, mode);
+  }
+
+  bool matchKey(uint32_t id, FilterKey const &key) {
+    return fCacheSelector.matchKey(id, key);
+  }
+
+  // Called for the nodes whose contents are rendered in this frame. Evicted chunks are decoded again here.
+  void touch(std::shared_ptr<Node> const &node) {
+    if (auto c = node->compound(); c) {
+      c->materialize();
+    }
+    fMemoryBudget.touch(node, fFrameCount);
+  }
+
+  // Applies the regions and files loaded since the last frame, all at once.
+  void retrieveLoadedRegions() {
+    using namespace std;
+    Profiler::Scope scope(fProfiler, Profiler::PhaseRegionsLoaded);
+    vector<shared_ptr<Node>> owners;
+    fRegionCompletions.drain([this, &owners](RegionLoaded &&loaded) {
+      if (auto owner = Node::Loaded(std::move(loaded), &fMemoryBudget); owner) {
+        owners.push_back(owner);
+      }
+    });
+    if (owners.empty()) {
+      return;
+    }
+    for (auto const &owner : owners) {
+      revokeFilterCache(owner);
+    }
+    fProfiler.count(Profiler::CounterRegionsLoaded, owners.size());
+    fSizeGeneration++;
+  }
+
+  // Chunks deflated on the pool are evicted in the frame they finish, the rest is checked every 30 frames.
+  void enforceMemoryBudget() {
+    size_t evicted = fMemoryBudget.retrieve(fFrameCount, fDeflateCompletions);
+    if (fFrameCount % 30 == 0) {
+      evicted += fMemoryBudget.evict(fFrameCount, *fPool, fDeflateCompletions);
+    }
+    if (evicted > 0) {
+      // Cached filter results are keyed by addresses of the evicted tags.
+      fCacheSelector.invalidate();
+      fProfiler.count(Profiler::CounterEvicted, evicted);
+      fSizeGeneration++;
+    }
+  }
+
+  void loadTextures(ImFontAtlas &fonts) {
+    fTextures.loadTextures();
+    fFontAtlas.load(fonts, fTextures);
+  }
+
+  bool updateTextures(ImFontAtlas &fonts) {
+    return fFontAtlas.update(fonts, fTextures);
   }
 
   void open(Path const &selected) {
     fError.clear();
 
-    if (auto node = Node::OpenFile(selected, *fPool); node) {
+    if (auto node = Node::OpenFile(selected, *fPool, fRegionCompletions); node) {
+      if (fOpened) {
+        // Loading of the previous tree is not waited for anymore.
+        fOpened->cancel();
+      }
       fOpened = node;
+      fMemoryBudget.clear();
+      // Keys only the previous tree used.
+      KeyTable::Shared().prune();
       if (fOpenedPath != selected) {
         fCacheSelector.invalidate();
       }
       fOpenedPath = selected;
+      openJournal(selected);
       return;
     }
     fError = u8"Can't open file";
@@ -83,17 +209,43 @@ public:
   void openDirectory(Path const &selected) {
     fError.clear();
 
-    if (auto node = Node::OpenDirectory(selected, *fPool); node) {
+    if (auto node = Node::OpenDirectory(selected, *fPool, fRegionCompletions); node) {
+      if (fOpened) {
+        // Loading of the previous tree is not waited for anymore.
+        fOpened->cancel();
+      }
       fOpened = node;
+      fMemoryBudget.clear();
+      // Keys only the previous tree used.
+      KeyTable::Shared().prune();
       if (fOpenedPath != selected) {
         fCacheSelector.invalidate();
       }
       fOpenedPath = selected;
+      openJournal(selected);
       return;
     }
     fError = u8"Can't open directory";
   }
 
+  // For files chosen in a dialog or handed over by the OS, which a recorded session can't replay from its input events.
+  void openChosen(Path const &selected, bool directory) {
+    fRecorder.opened(selected, directory);
+    if (directory) {
+      openDirectory(selected);
+    } else {
+      open(selected);
+    }
+  }
+
+  void startRecording() {
+    fRecorder.start();
+    if (fOpened) {
+      // The session is replayed from the same tree.
+      fRecorder.opened(fOpenedPath, std::filesystem::is_directory(fOpenedPath));
+    }
+  }
+
   void reload() {
     if (!fOpened) {
       return;
@@ -106,13 +258,20 @@ public:
   }
 
   bool canSave() const {
-    if (!fOpened) {
-      return false;
-    }
-    if (fSaveTask) {
-      return false;
-    }
-    return true;
+    return fOpened != nullptr;
+  }
+
+  bool saving() const {
+    return !fSaveTasks.empty() || fRecoveryTask;
+  }
+
+  bool compacting() const {
+    return fCompactionTask.has_value();
+  }
+
+  // Files being written must not be read back, so opening and reloading wait until saving has finished.
+  bool canOpen() const {
+    return !saving() && !compacting();
   }
 
   void save() {
@@ -122,24 +281,198 @@ public:
     if (!fOpened) {
       return;
     }
-    fSaveTask = make_shared<future<String>>(fSaveQueue->enqueue([](Node &node, TemporaryDirectory &temp) { return node.save(temp); }, *fOpened, ref(fTempRoot)));
+    auto snapshot = SaveSnapshot::Capture(fOpened, fSaveProfile);
+    if (snapshot->empty()) {
+      return;
+    }
+    auto task = fSaveQueue->enqueue("Save", TaskPriority::High, [](shared_ptr<SaveSnapshot> snapshot, TaskQueue &pool) { return snapshot->write(pool); }, snapshot, ref(*fPool));
+    fSaveTasks.push_back(PendingSave{snapshot, std::move(task.fFuture)});
   }
 
   void retrieveSaveTask() {
     using namespace std;
-    if (!fSaveTask) {
+    while (!fSaveTasks.empty()) {
+      PendingSave &front = fSaveTasks.front();
+      auto state = front.fFuture.wait_for(chrono::seconds(0));
+      if (state != future_status::ready) {
+        return;
+      }
+      auto error = front.fFuture.get();
+      if (error.empty()) {
+        front.fSnapshot->commit();
+        // Saved chunks may have moved to other sectors.
+        fChunkLocatorHeader = nullopt;
+        if (fOpened) {
+          vector<Path> dirty;
+          fOpened->dirtyFiles(&dirty);
+          fJournal.compact(dirty);
+        }
+      } else {
+        fError = error;
+      }
+      fSaveTasks.pop_front();
+    }
+  }
+
+  // Compacts the region files under target, which is a region file or a directory.
+  void compactRegions(Path const &target) {
+    using namespace std;
+    namespace fs = std::filesystem;
+    if (compacting()) {
       return;
     }
-    auto state = fSaveTask->wait_for(chrono::seconds(0));
-    if (state != future_status::ready) {
+    error_code ec;
+    fCompactionRoot = fs::is_directory(target, ec) ? target : target.parent_path();
+    auto task = fSaveQueue->enqueue("Compact", TaskPriority::Normal, [](Path target, TaskQueue &pool) { return RegionCompactor::CompactAll(ListRegionFiles(target), pool); }, target, ref(*fPool));
+    fCompactionTask = std::move(task.fFuture);
+  }
+
+  void retrieveCompactionTask() {
+    using namespace std;
+    if (!fCompactionTask || fCompactionTask->wait_for(chrono::seconds(0)) != future_status::ready) {
+      return;
+    }
+    fCompactionReport = fCompactionTask->get();
+    fCompactionTask = nullopt;
+    fCompactionReportOpened = true;
+
+    // Chunks have moved to other sectors, so the compacted regions are read again.
+    fChunkLocatorHeader = nullopt;
+    set<Path> compacted;
+    for (auto const &result : fCompactionReport) {
+      if (result.fError.empty()) {
+        compacted.insert(result.fFile);
+      }
+    }
+    if (!fOpened) {
+      return;
+    }
+    if (auto r = fOpened->region(); r) {
+      if (compacted.contains(r->fFile) && !r->isDirty()) {
+        reload();
+      }
+    } else {
+      CloseRegions(fOpened, compacted);
+    }
+  }
+
+  // Closes the unedited regions of the files under node back to unopened, so that they are read again when expanded.
+  static void CloseRegions(std::shared_ptr<Node> const &node, std::set<Path> const &files) {
+    if (auto r = node->region(); r) {
+      if (files.contains(r->fFile)) {
+        node->close();
+      }
+    } else if (auto contents = node->directoryContents(); contents) {
+      for (auto const &child : contents->fValue) {
+        CloseRegions(child, files);
+      }
+    }
+  }
+
+  bool scanning() const {
+    return fScanTask.has_value();
+  }
+
+  // Checks the integrity of the region files under target, which is a region file or a directory.
+  void scanRegions(Path const &target) {
+    using namespace std;
+    namespace fs = std::filesystem;
+    if (scanning()) {
+      return;
+    }
+    error_code ec;
+    fScanRoot = fs::is_directory(target, ec) ? target : target.parent_path();
+    fScanProgress = make_shared<RegionScanner::Progress>();
+    auto task = fSaveQueue->enqueue("Scan", TaskPriority::Normal, [](Path target, TaskQueue &pool, shared_ptr<RegionScanner::Progress> progress) { return RegionScanner::ScanAll(target, pool, *progress); }, target, ref(*fPool), fScanProgress);
+    fScanTask = std::move(task.fFuture);
+  }
+
+  void retrieveScanTask() {
+    using namespace std;
+    if (!fScanTask || fScanTask->wait_for(chrono::seconds(0)) != future_status::ready) {
+      return;
+    }
+    fScanReport = fScanTask->get();
+    fScanTask = nullopt;
+    fScanReportOpened = true;
+  }
+
+  // Finds the node of a region file in the opened tree, loading the directories and the file on the way. The file is not
+  // loaded while files are being written, see canOpen.
+  std::shared_ptr<Node> locateRegion(Path const &file) {
+    using namespace std;
+    auto node = fOpened;
+    while (node) {
+      if (node->directoryUnopened() || (node->fileUnopened() && canOpen())) {
+        node->load(*fPool, fRegionCompletions);
+        fSizeGeneration++;
+      }
+      if (auto region = node->region(); region) {
+        return region->fFile == file ? node : nullptr;
+      }
+      auto contents = node->directoryContents();
+      if (!contents) {
+        return nullptr;
+      }
+      shared_ptr<Node> next;
+      for (auto const &child : contents->fValue) {
+        if (auto path = child->path(); path && IsPathUnder(file, *path)) {
+          next = child;
+          break;
+        }
+      }
+      node = next;
+    }
+    return nullptr;
+  }
+
+  void applyRecoveredEdits() {
+    using namespace std;
+    namespace fs = std::filesystem;
+    if (fRecoveredEdits.empty() || fRecoveryTask) {
+      return;
+    }
+    error_code ec;
+    Path root = fs::is_directory(fOpenedPath, ec) ? fOpenedPath : fOpenedPath.parent_path();
+    auto task = fSaveQueue->enqueue("ApplyJournal", TaskPriority::High, [](Path root, vector<EditJournal::Record> records, SaveProfile profile, TaskQueue &pool) { return EditJournal::Apply(root, records, profile, pool); }, root, fRecoveredEdits, fSaveProfile, ref(*fPool));
+    fRecoveryTask = std::move(task.fFuture);
+  }
+
+  void discardRecoveredEdits() {
+    fJournal.clear();
+    fRecoveredEdits.clear();
+  }
+
+  void retrieveRecoveryTask() {
+    using namespace std;
+    if (!fRecoveryTask || fRecoveryTask->wait_for(chrono::seconds(0)) != future_status::ready) {
       return;
     }
-    auto error = fSaveTask->get();
-    fError = error;
-    if (fError.empty()) {
-      fOpened->clearDirty();
+    auto error = fRecoveryTask->get();
+    fRecoveryTask = nullopt;
+    if (error.empty()) {
+      discardRecoveredEdits();
+    }
+    // The journal is kept when some of the edits couldn't be applied, and offered again by the reload.
+    reload();
+    if (!error.empty()) {
+      fError = error;
+    }
+  }
+
+  // Writes the edits journaled during this frame.
+  void flushJournal() {
+    if (!fJournal.flush()) {
+      fError = u8"Can't write the edit journal";
     }
-    fSaveTask.reset();
+  }
+
+  // The edits of the tree being replaced are given up, unless they are still waiting to be applied.
+  void openJournal(Path const &selected) {
+    if (fRecoveredEdits.empty()) {
+      fJournal.clear();
+    }
+    fRecoveredEdits = fJournal.open(selected);
   }
 
   FilterKey const *filterKey() const {
@@ -169,7 +502,8 @@ public:
     fCacheSelector.revokeCache(node);
   }
 
-  String winowTitle() const {
+  String winowTitle() {
+    Profiler::Scope scope(fProfiler, Profiler::PhaseWindowTitle);
     String title = u8"nbte";
     if (!fOpened) {
       return title;
@@ -184,7 +518,8 @@ public:
     return title;
   }
 
-  bool dirtyFiles(std::vector<Path> &buffer) const {
+  bool dirtyFiles(std::vector<Path> &buffer) {
+    Profiler::Scope scope(fProfiler, Profiler::PhaseDirtyFiles);
     if (!fOpened) {
       return false;
     }
@@ -202,6 +537,17 @@ public:
       fFilter.fCaseSensitive = fFilterCaseSensitive;
     }
   }
+
+  void sampleProfiler() {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    fCacheSelector.takeStatistics(&hits, &misses);
+    fProfiler.count(Profiler::CounterFilterCacheHit, hits);
+    fProfiler.count(Profiler::CounterFilterCacheMiss, misses);
+    fProfiler.set(Profiler::CounterPoolQueued, fPool->queued());
+    fProfiler.set(Profiler::CounterPoolRunning, fPool->running());
+    fProfiler.nextFrame();
+  }
 };
 
 } // namespace nbte
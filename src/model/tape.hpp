@@ -0,0 +1,436 @@
+#pragma once
+
+namespace nbte {
+
+// Read-mostly NBT representation: the decoded bytes are kept as is, and a flat array of entries indexes the tags in them.
+// Keys are interned in KeyTable, and held by the tape until it is destroyed. A chunk held this way costs its uncompressed
+// size plus about 24 bytes per tag, instead of one heap allocated mcfile::nbt::Tag per tag. Entry 0 is the root compound.
+// Entries are numbered in pre-order, so entry indices stay the same when a value is rewritten.
+//
+// When parsed with a BlobPool, payloads of large arrays are cut out of fBytes and shared with other tapes holding the same
+// bytes. A shared payload is copied into the tape the first time it is edited.
+class Tape {
+public:
+  using Type = mcfile::nbt::Tag::Type;
+
+  struct Entry {
+    uint32_t fKey = 0;      // id in KeyTable, children of compounds only
+    uint32_t fPayload = 0;  // offset of the payload in fBytes, or index in fBlobs when fBlob is set
+    uint32_t fSize = 0;     // children of compound and list, elements of arrays, bytes of string
+    uint32_t fChildren = 0; // index in fChildren of the first child
+    Type fType = Type::End;
+    bool fBlob = false;
+  };
+
+  static constexpr int kMaxDepth = 512;
+
+  static std::shared_ptr<Tape> Parse(std::vector<uint8_t> &&bytes, mcfile::Endian endian, BlobPool *pool = nullptr) {
+    using namespace std;
+    auto tape = make_shared<Tape>();
+    tape->fBytes.swap(bytes);
+    tape->fEndian = endian;
+    tape->fPool = pool;
+    if (!tape->parse()) {
+      return nullptr;
+    }
+    return tape;
+  }
+
+  uint32_t entries() const {
+    return (uint32_t)fEntries.size();
+  }
+
+  Type type(uint32_t index) const {
+    return fEntries[index].fType;
+  }
+
+  uint32_t key(uint32_t index) const {
+    return fEntries[index].fKey;
+  }
+
+  String const &name(uint32_t index) const {
+    return KeyTable::Shared().key(fEntries[index].fKey);
+  }
+
+  uint32_t size(uint32_t index) const {
+    return fEntries[index].fSize;
+  }
+
+  // Children of a compound are ordered by key, the same as mcfile::nbt::CompoundTag iterates them.
+  uint32_t child(uint32_t index, uint32_t i) const {
+    return fChildren[fEntries[index].fChildren + i];
+  }
+
+  template <class T>
+  T scalar(uint32_t index) const {
+    return read<T>(fBytes.data() + fEntries[index].fPayload);
+  }
+
+  template <class T>
+  void setScalar(uint32_t index, T v) {
+    write<T>(fBytes.data() + fEntries[index].fPayload, v);
+  }
+
+  template <class T>
+  T element(uint32_t index, uint32_t i) const {
+    return read<T>(payload(index) + sizeof(T) * i);
+  }
+
+  template <class T>
+  void setElement(uint32_t index, uint32_t i, T v) {
+    write<T>(mutablePayload(index) + sizeof(T) * i, v);
+  }
+
+  String string(uint32_t index) const {
+    Entry const &e = fEntries[index];
+    return String((char8_t const *)fBytes.data() + e.fPayload, e.fSize);
+  }
+
+  // Changes the length of the payload, so the bytes after it are moved and the entries are rebuilt.
+  bool setString(uint32_t index, String const &value) {
+    using namespace std;
+    if (value.size() > numeric_limits<uint16_t>::max()) {
+      return false;
+    }
+    Entry const &e = fEntries[index];
+    // Offset of the payload in the reassembled bytes.
+    size_t offset = e.fPayload;
+    for (auto const &blob : fBlobs) {
+      if (blob.fOffset <= e.fPayload) {
+        offset += blob.size();
+      }
+    }
+    vector<uint8_t> original = this->bytes();
+    vector<uint8_t> bytes;
+    bytes.reserve(original.size() - e.fSize + value.size());
+    bytes.insert(bytes.end(), original.begin(), original.begin() + offset - sizeof(uint16_t));
+    bytes.resize(bytes.size() + sizeof(uint16_t));
+    write<uint16_t>(bytes.data() + bytes.size() - sizeof(uint16_t), (uint16_t)value.size());
+    bytes.insert(bytes.end(), value.begin(), value.end());
+    bytes.insert(bytes.end(), original.begin() + offset + e.fSize, original.end());
+    fBytes.swap(bytes);
+    if (!parse()) {
+      fBytes.swap(original);
+      parse();
+      return false;
+    }
+    return true;
+  }
+
+  // Identifies a tag while the tape is not rebuilt by setString.
+  void const *address(uint32_t index) const {
+    return &fEntries[index];
+  }
+
+  // The uncompressed NBT, in the same format as it was parsed from.
+  std::vector<uint8_t> bytes() const {
+    using namespace std;
+    size_t size = fBytes.size();
+    for (auto const &blob : fBlobs) {
+      size += blob.size();
+    }
+    vector<uint8_t> ret;
+    ret.reserve(size);
+    uint32_t pos = 0;
+    for (auto const &blob : fBlobs) {
+      ret.insert(ret.end(), fBytes.begin() + pos, fBytes.begin() + blob.fOffset);
+      ret.insert(ret.end(), blob.data(), blob.data() + blob.size());
+      pos = blob.fOffset;
+    }
+    ret.insert(ret.end(), fBytes.begin() + pos, fBytes.end());
+    return ret;
+  }
+
+  // Shared payloads are accounted evenly to the tapes sharing them.
+  size_t memoryUsage() const {
+    size_t ret = fBytes.capacity() + fEntries.capacity() * sizeof(Entry) + fChildren.capacity() * sizeof(uint32_t) + fBlobs.capacity() * sizeof(Blob);
+    for (auto const &blob : fBlobs) {
+      if (blob.fShared) {
+        ret += blob.fShared->capacity() / std::max<long>(blob.fShared.use_count(), 1);
+      } else {
+        ret += blob.fOwned.capacity();
+      }
+    }
+    return ret;
+  }
+
+private:
+  struct Blob {
+    std::shared_ptr<BlobPool::Blob const> fShared;
+    std::vector<uint8_t> fOwned;
+    uint32_t fOffset = 0; // offset in fBytes the payload was cut out from
+
+    uint8_t const *data() const {
+      return fShared ? fShared->data() : fOwned.data();
+    }
+
+    size_t size() const {
+      return fShared ? fShared->size() : fOwned.size();
+    }
+  };
+
+  struct ParseContext {
+    // Keys repeat a lot within a chunk, look them up locally before going to the shared table.
+    std::unordered_map<std::u8string_view, uint32_t> fKeys;
+    KeyTable::References fReferences;
+    // Ranges of the input moved into fBlobs, as (offset, size).
+    std::vector<std::pair<uint32_t, uint32_t>> fCuts;
+    uint32_t fRemoved = 0;
+  };
+
+  uint8_t const *payload(uint32_t index) const {
+    Entry const &e = fEntries[index];
+    if (e.fBlob) {
+      return fBlobs[e.fPayload].data();
+    } else {
+      return fBytes.data() + e.fPayload;
+    }
+  }
+
+  uint8_t *mutablePayload(uint32_t index) {
+    Entry const &e = fEntries[index];
+    if (!e.fBlob) {
+      return fBytes.data() + e.fPayload;
+    }
+    Blob &blob = fBlobs[e.fPayload];
+    if (blob.fShared) {
+      blob.fOwned = *blob.fShared;
+      blob.fShared.reset();
+    }
+    return blob.fOwned.data();
+  }
+
+  // All supported hosts are little endian.
+  template <class T>
+  T read(uint8_t const *p) const {
+    using namespace std;
+    uint8_t b[sizeof(T)];
+    memcpy(b, p, sizeof(T));
+    if (fEndian == mcfile::Endian::Big) {
+      reverse(b, b + sizeof(T));
+    }
+    T v;
+    memcpy(&v, b, sizeof(T));
+    return v;
+  }
+
+  template <class T>
+  void write(uint8_t *p, T v) const {
+    using namespace std;
+    uint8_t b[sizeof(T)];
+    memcpy(b, &v, sizeof(T));
+    if (fEndian == mcfile::Endian::Big) {
+      reverse(b, b + sizeof(T));
+    }
+    memcpy(p, b, sizeof(T));
+  }
+
+  bool parse() {
+    using namespace std;
+    fEntries.clear();
+    fChildren.clear();
+    fBlobs.clear();
+    uint32_t pos = 0;
+    if (fBytes.size() > numeric_limits<uint32_t>::max()) {
+      return false;
+    }
+    if (fBytes.size() < 1 || (Type)fBytes[0] != Type::Compound) {
+      return false;
+    }
+    pos = 1;
+    uint16_t nameSize;
+    if (!readHeader<uint16_t>(pos, &nameSize) || !skip(pos, nameSize)) {
+      return false;
+    }
+    ParseContext ctx;
+    if (!parseValue(Type::Compound, pos, 0, ctx)) {
+      return false;
+    }
+    if (!ctx.fCuts.empty()) {
+      std::vector<uint8_t> bytes;
+      bytes.reserve(fBytes.size() - ctx.fRemoved);
+      uint32_t from = 0;
+      for (auto const &cut : ctx.fCuts) {
+        bytes.insert(bytes.end(), fBytes.begin() + from, fBytes.begin() + cut.first);
+        from = cut.first + cut.second;
+      }
+      bytes.insert(bytes.end(), fBytes.begin() + from, fBytes.end());
+      fBytes.swap(bytes);
+    }
+    fEntries.shrink_to_fit();
+    fChildren.shrink_to_fit();
+    fBlobs.shrink_to_fit();
+    // The keys of the former entries, when rebuilt by setString, are released here.
+    fKeys = std::move(ctx.fReferences);
+    return true;
+  }
+
+  template <class T>
+  bool readHeader(uint32_t &pos, T *v) const {
+    if ((size_t)pos + sizeof(T) > fBytes.size()) {
+      return false;
+    }
+    *v = read<T>(fBytes.data() + pos);
+    pos += sizeof(T);
+    return true;
+  }
+
+  bool skip(uint32_t &pos, uint64_t size) const {
+    if (pos + size > fBytes.size()) {
+      return false;
+    }
+    pos += (uint32_t)size;
+    return true;
+  }
+
+  bool parseValue(Type type, uint32_t &pos, int depth, ParseContext &ctx) {
+    using namespace std;
+    if (depth > kMaxDepth) {
+      return false;
+    }
+    uint32_t index = (uint32_t)fEntries.size();
+    fEntries.emplace_back();
+    fEntries[index].fType = type;
+    fEntries[index].fPayload = pos - ctx.fRemoved;
+    switch (type) {
+    case Type::Byte:
+      return skip(pos, 1);
+    case Type::Short:
+      return skip(pos, 2);
+    case Type::Int:
+    case Type::Float:
+      return skip(pos, 4);
+    case Type::Long:
+    case Type::Double:
+      return skip(pos, 8);
+    case Type::String: {
+      uint16_t size;
+      if (!readHeader<uint16_t>(pos, &size)) {
+        return false;
+      }
+      fEntries[index].fPayload = pos - ctx.fRemoved;
+      fEntries[index].fSize = size;
+      return skip(pos, size);
+    }
+    case Type::ByteArray:
+    case Type::IntArray:
+    case Type::LongArray: {
+      int32_t size;
+      if (!readHeader<int32_t>(pos, &size) || size < 0) {
+        return false;
+      }
+      fEntries[index].fPayload = pos - ctx.fRemoved;
+      fEntries[index].fSize = (uint32_t)size;
+      uint64_t element = type == Type::ByteArray ? 1 : (type == Type::IntArray ? 4 : 8);
+      uint32_t start = pos;
+      uint64_t bytes = element * (uint32_t)size;
+      if (!skip(pos, bytes)) {
+        return false;
+      }
+      if (fPool && bytes >= BlobPool::kMinBlobSize) {
+        Blob blob;
+        blob.fShared = fPool->intern(fBytes.data() + start, bytes);
+        blob.fOffset = start - ctx.fRemoved;
+        fEntries[index].fBlob = true;
+        fEntries[index].fPayload = (uint32_t)fBlobs.size();
+        fBlobs.push_back(std::move(blob));
+        ctx.fCuts.push_back(make_pair(start, (uint32_t)bytes));
+        ctx.fRemoved += (uint32_t)bytes;
+      }
+      return true;
+    }
+    case Type::List: {
+      uint8_t elementType;
+      int32_t size;
+      if (!readHeader<uint8_t>(pos, &elementType) || !readHeader<int32_t>(pos, &size)) {
+        return false;
+      }
+      if (size <= 0) {
+        fEntries[index].fChildren = (uint32_t)fChildren.size();
+        return true;
+      }
+      if (elementType == (uint8_t)Type::End || elementType > (uint8_t)Type::LongArray) {
+        return false;
+      }
+      vector<uint32_t> children;
+      children.reserve(min<uint32_t>((uint32_t)size, 1024));
+      for (int32_t i = 0; i < size; i++) {
+        children.push_back((uint32_t)fEntries.size());
+        if (!parseValue((Type)elementType, pos, depth + 1, ctx)) {
+          return false;
+        }
+      }
+      fEntries[index].fSize = (uint32_t)children.size();
+      fEntries[index].fChildren = (uint32_t)fChildren.size();
+      fChildren.insert(fChildren.end(), children.begin(), children.end());
+      return true;
+    }
+    case Type::Compound: {
+      vector<pair<u8string_view, uint32_t>> children;
+      while (true) {
+        uint8_t childType;
+        if (!readHeader<uint8_t>(pos, &childType)) {
+          return false;
+        }
+        if (childType == (uint8_t)Type::End) {
+          break;
+        }
+        if (childType > (uint8_t)Type::LongArray) {
+          return false;
+        }
+        uint16_t nameSize;
+        if (!readHeader<uint16_t>(pos, &nameSize)) {
+          return false;
+        }
+        u8string_view name((char8_t const *)fBytes.data() + pos, nameSize);
+        if (!skip(pos, nameSize)) {
+          return false;
+        }
+        uint32_t child = (uint32_t)fEntries.size();
+        if (!parseValue((Type)childType, pos, depth + 1, ctx)) {
+          return false;
+        }
+        auto found = ctx.fKeys.find(name);
+        if (found == ctx.fKeys.end()) {
+          found = ctx.fKeys.insert(make_pair(name, KeyTable::Shared().intern(name))).first;
+          ctx.fReferences.add(found->second);
+        }
+        fEntries[child].fKey = found->second;
+        children.push_back(make_pair(name, child));
+      }
+      stable_sort(children.begin(), children.end(), [](auto const &a, auto const &b) {
+        return a.first < b.first;
+      });
+      // A duplicated key overwrites the former one when read into CompoundTag, keep the last one here as well.
+      auto last = unique(children.rbegin(), children.rend(), [](auto const &a, auto const &b) {
+        return a.first == b.first;
+      });
+      children.erase(children.begin(), last.base());
+      fEntries[index].fSize = (uint32_t)children.size();
+      fEntries[index].fChildren = (uint32_t)fChildren.size();
+      for (auto const &it : children) {
+        fChildren.push_back(it.second);
+      }
+      return true;
+    }
+    default:
+      return false;
+    }
+  }
+
+  std::vector<uint8_t> fBytes;
+  mcfile::Endian fEndian = mcfile::Endian::Big;
+  BlobPool *fPool = nullptr;
+  std::vector<Entry> fEntries;
+  std::vector<uint32_t> fChildren;
+  std::vector<Blob> fBlobs;
+  KeyTable::References fKeys;
+};
+
+// A tag inside a Tape, as a key of the filter cache.
+struct TapeEntry {
+  Tape const *fTape;
+  uint32_t fIndex;
+};
+
+} // namespace nbte
@@ -2,8 +2,20 @@
 
 namespace nbte {
 
-using Path = std::filesystem::path;
+#if NBTE_HEADLESS
+// Headless builds have no native dialogs, files are opened through State directly.
+static std::optional<std::filesystem::path> OpenFileDialog() {
+  return std::nullopt;
+}
+
+static std::optional<std::filesystem::path> OpenDirectoryDialog() {
+  return std::nullopt;
+}
 
+static std::optional<std::filesystem::path> SaveFileDialog(String const &defaultName) {
+  return std::nullopt;
+}
+#else
 static std::optional<std::filesystem::path> OpenFileDialog() {
   using namespace std;
   namespace fs = std::filesystem;
@@ -34,6 +46,22 @@ static std::optional<std::filesystem::path> OpenDirectoryDialog() {
   }
 }
 
+static std::optional<std::filesystem::path> SaveFileDialog(String const &defaultName) {
+  using namespace std;
+  namespace fs = std::filesystem;
+
+  nfdchar_t *outPath = nullptr;
+  if (NFD_SaveDialog(&outPath, nullptr, 0, nullptr, (nfdchar_t const *)defaultName.c_str()) == NFD_OKAY) {
+    String selected;
+    selected.assign((char8_t const *)outPath);
+    NFD_FreePath(outPath);
+    return fs::path(selected);
+  } else {
+    return nullopt;
+  }
+}
+#endif
+
 static int GetModCtrlKeyIndex() {
 #if defined(__APPLE__)
   return ImGui::GetKeyIndex(ImGuiKey_ModSuper);
@@ -58,7 +86,7 @@ static String QuitMenuShortcut() {
 #endif
 }
 
-#if defined(_MSC_VER)
+#if defined(_MSC_VER) && !NBTE_HEADLESS
 static std::optional<Path> MinecraftSaveDirectory() {
   namespace fs = std::filesystem;
   wchar_t path[MAX_PATH * 2];
@@ -76,24 +104,6 @@ static std::optional<Path> MinecraftSaveDirectory() {
 }
 #endif
 
-static Path TemporaryDirectoryRoot() {
-#if defined(_MSC_VER)
-  wchar_t buffer[2048] = {0};
-  GetTempPathW(sizeof(buffer) / sizeof(buffer[0]), buffer);
-  return Path(buffer);
-#else
-  return std::filesystem::temp_directory_path();
-#endif
-}
-
-static String UuidString() {
-  char data[37] = {0};
-  uuid4_generate(data);
-  String ret;
-  ret.assign(data, data + 36);
-  return ret;
-}
-
 struct Resource {
   Resource(void *data, size_t size, bool systemOwned) : fData(data), fSize(size), fSystemOwned(systemOwned) {}
 
@@ -114,7 +124,18 @@ struct Resource {
 static std::unique_ptr<Resource> LoadNamedResource(char const *name) {
   using namespace std;
   namespace fs = std::filesystem;
-#if defined(_MSC_VER)
+#if NBTE_HEADLESS
+  // Read from the resource directory of the source tree, which the build passes as NBTE_RESOURCE_DIR.
+  auto stream = make_shared<mcfile::stream::FileInputStream>(Path(NBTE_RESOURCE_DIR) / name);
+  vector<uint8_t> buffer;
+  mcfile::stream::InputStream::ReadUntilEos(*stream, buffer);
+  if (buffer.empty()) {
+    return nullptr;
+  }
+  void *copy = malloc(buffer.size());
+  memcpy(copy, buffer.data(), buffer.size());
+  return make_unique<Resource>(copy, buffer.size(), false);
+#elif defined(_MSC_VER)
   HINSTANCE self = GetModuleHandle(nullptr);
   HRSRC info = FindResourceA(self, name, "DATA");
   if (!info) {
@@ -156,47 +177,37 @@ static std::unique_ptr<Resource> LoadNamedResource(char const *name) {
 #endif
 }
 
-std::optional<Texture> LoadTexture(char const *name, void *devicePtr) {
-#if defined(_MSC_VER)
+struct Image {
+  int fWidth;
+  int fHeight;
+  std::vector<uint8_t> fPixels; // RGBA, 8 bits per component
+};
+
+static std::optional<Image> LoadRgbaImage(char const *name) {
+#if defined(_MSC_VER) || NBTE_HEADLESS
   auto resource = LoadNamedResource(name);
   if (!resource) {
     return std::nullopt;
   }
 
-  // Load from file
   int width, height, components;
   unsigned char *img = stbi_load_from_memory((stbi_uc const *)resource->fData, resource->fSize, &width, &height, &components, 4);
   if (img == NULL) {
     return std::nullopt;
   }
 
-  // Create a OpenGL texture identifier
-  GLuint image_texture;
-  glGenTextures(1, &image_texture);
-  glBindTexture(GL_TEXTURE_2D, image_texture);
-
-  // Setup filtering parameters for display
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
-  // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // Same
-
-  // Upload pixels into texture
-#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-#endif
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, img);
-  stbi_image_free(img);
-
-  Texture ret;
-  ret.fTexture = (ImTextureID)(intptr_t)image_texture;
+  Image ret;
   ret.fWidth = width;
   ret.fHeight = height;
+  ret.fPixels.assign(img, img + (size_t)width * height * 4);
+  stbi_image_free(img);
   return ret;
 #else
   @autoreleasepool {
-    id<MTLDevice> device = (__bridge id<MTLDevice>)devicePtr;
     NSImage *image = [NSImage imageNamed:[NSString stringWithUTF8String:name]];
+    if (!image) {
+      return std::nullopt;
+    }
     NSSize size = image.size;
     NSRect rect = NSMakeRect(0, 0, size.width, size.height);
     CGImageRef imageRef = [image CGImageForProposedRect:&rect context:nil hints:nil];
@@ -205,14 +216,16 @@ std::optional<Texture> LoadTexture(char const *name, void *devicePtr) {
     NSUInteger height = CGImageGetHeight(imageRef);
     CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
 
-    NSUInteger components = 4;
-    void *data = calloc(width * height * components, 1);
+    Image ret;
+    ret.fWidth = (int)width;
+    ret.fHeight = (int)height;
+    ret.fPixels.resize(width * height * 4);
     NSUInteger bytesPerPixel = 4;
     NSUInteger bytesPerRow = bytesPerPixel * width;
     NSUInteger bitsPerComponent = 8;
 
     uint32_t bitmapInfo = kCGImageAlphaPremultipliedLast | kCGImageByteOrder32Big;
-    CGContextRef ctx = CGBitmapContextCreate(data,
+    CGContextRef ctx = CGBitmapContextCreate(ret.fPixels.data(),
                                              width,
                                              height,
                                              bitsPerComponent,
@@ -223,20 +236,6 @@ std::optional<Texture> LoadTexture(char const *name, void *devicePtr) {
 
     CGColorSpaceRelease(colorSpace);
     CGContextRelease(ctx);
-
-    MTLTextureDescriptor *textureDescriptor = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA8Unorm
-                                                                                                 width:width
-                                                                                                height:height
-                                                                                             mipmapped:YES];
-    id<MTLTexture> texture = [device newTextureWithDescriptor:textureDescriptor];
-
-    MTLRegion region = MTLRegionMake2D(0, 0, width, height);
-    [texture replaceRegion:region mipmapLevel:0 withBytes:data bytesPerRow:bytesPerRow];
-
-    Texture ret;
-    ret.fTexture = texture;
-    ret.fWidth = width;
-    ret.fHeight = height;
     return ret;
   }
 #endif
@@ -0,0 +1,213 @@
+#pragma once
+
+namespace nbte {
+
+class Profiler {
+public:
+  enum Phase : int {
+    PhaseFrame = 0,
+    PhaseRenderNode,
+    PhaseVisit,
+    PhaseFilter,
+    PhaseRegionsLoaded,
+    PhaseDirtyFiles,
+    PhaseWindowTitle,
+
+    PhaseCount,
+  };
+
+  enum Counter : int {
+    CounterVisit = 0,
+    CounterFilterCacheHit,
+    CounterFilterCacheMiss,
+    CounterRegionsLoaded,
+    CounterPoolQueued,
+    CounterPoolRunning,
+    CounterEvicted,
+
+    CounterCount,
+  };
+
+  static constexpr size_t kHistorySize = 240;
+
+  class Scope {
+  public:
+    Scope(Profiler &profiler, Phase phase) : fProfiler(profiler), fPhase(phase) {
+      if (fProfiler.fDepth[fPhase]++ == 0) {
+        fStart = std::chrono::high_resolution_clock::now();
+      }
+    }
+
+    Scope(Scope const &) = delete;
+    Scope &operator=(Scope const &) = delete;
+
+    ~Scope() {
+      // Visit is recursive, so only the outermost scope of a phase contributes to its time.
+      if (--fProfiler.fDepth[fPhase] == 0) {
+        auto elapsed = std::chrono::high_resolution_clock::now() - fStart;
+        fProfiler.fCurrent.fMilliseconds[fPhase] += std::chrono::duration<float, std::milli>(elapsed).count();
+      }
+    }
+
+  private:
+    Profiler &fProfiler;
+    Phase const fPhase;
+    std::chrono::high_resolution_clock::time_point fStart;
+  };
+
+  static char const *PhaseName(Phase phase) {
+    switch (phase) {
+    case PhaseFrame:
+      return "Render";
+    case PhaseRenderNode:
+      return "RenderNode";
+    case PhaseVisit:
+      return "Visit";
+    case PhaseFilter:
+      return "containsTerm";
+    case PhaseRegionsLoaded:
+      return "retrieveLoadedRegions";
+    case PhaseDirtyFiles:
+      return "dirtyFiles";
+    case PhaseWindowTitle:
+      return "winowTitle";
+    default:
+      return "";
+    }
+  }
+
+  static char const *CounterName(Counter counter) {
+    switch (counter) {
+    case CounterVisit:
+      return "Visit calls";
+    case CounterFilterCacheHit:
+      return "Filter cache hits";
+    case CounterFilterCacheMiss:
+      return "Filter cache misses";
+    case CounterRegionsLoaded:
+      return "Regions loaded";
+    case CounterPoolQueued:
+      return "Pool queued";
+    case CounterPoolRunning:
+      return "Pool running";
+    case CounterEvicted:
+      return "Evicted nodes";
+    default:
+      return "";
+    }
+  }
+
+  void count(Counter counter, uint64_t delta = 1) {
+    fCurrent.fCounters[counter] += delta;
+  }
+
+  void set(Counter counter, uint64_t value) {
+    fCurrent.fCounters[counter] = value;
+  }
+
+  // Closes the frame measured so far and starts a new one. Everything recorded between two calls,
+  // including work done outside of Render such as updating the window title, belongs to one frame.
+  void nextFrame() {
+    fHistoryIndex = (fHistoryIndex + 1) % kHistorySize;
+    for (int i = 0; i < PhaseCount; i++) {
+      fMilliseconds[i][fHistoryIndex] = fCurrent.fMilliseconds[i];
+    }
+    for (int i = 0; i < CounterCount; i++) {
+      fCounters[i][fHistoryIndex] = (float)fCurrent.fCounters[i];
+    }
+    if (fHistoryCount < kHistorySize) {
+      fHistoryCount++;
+    }
+    fCurrent = Frame();
+  }
+
+  // Offset of the oldest sample, to be used as values_offset of im::PlotLines.
+  int historyOffset() const {
+    return (int)((fHistoryIndex + 1) % kHistorySize);
+  }
+
+  float const *history(Phase phase) const {
+    return fMilliseconds[phase].data();
+  }
+
+  float const *history(Counter counter) const {
+    return fCounters[counter].data();
+  }
+
+  float last(Phase phase) const {
+    return fMilliseconds[phase][fHistoryIndex];
+  }
+
+  float last(Counter counter) const {
+    return fCounters[counter][fHistoryIndex];
+  }
+
+  float average(Phase phase) const {
+    return Average(fMilliseconds[phase]);
+  }
+
+  float average(Counter counter) const {
+    return Average(fCounters[counter]);
+  }
+
+  float max(Phase phase) const {
+    return *std::max_element(fMilliseconds[phase].begin(), fMilliseconds[phase].end());
+  }
+
+  float max(Counter counter) const {
+    return *std::max_element(fCounters[counter].begin(), fCounters[counter].end());
+  }
+
+  bool dump(Path const &file) const {
+    std::ofstream stream(file, std::ios::binary);
+    if (!stream) {
+      return false;
+    }
+    stream << "frame";
+    for (int i = 0; i < PhaseCount; i++) {
+      stream << "," << PhaseName((Phase)i) << " [ms]";
+    }
+    for (int i = 0; i < CounterCount; i++) {
+      stream << "," << CounterName((Counter)i);
+    }
+    stream << "\n";
+    for (size_t n = 0; n < fHistoryCount; n++) {
+      size_t index = (fHistoryIndex + kHistorySize + 1 - fHistoryCount + n) % kHistorySize;
+      stream << n;
+      for (int i = 0; i < PhaseCount; i++) {
+        stream << "," << fMilliseconds[i][index];
+      }
+      for (int i = 0; i < CounterCount; i++) {
+        stream << "," << fCounters[i][index];
+      }
+      stream << "\n";
+    }
+    return stream.good();
+  }
+
+private:
+  float Average(std::array<float, kHistorySize> const &values) const {
+    if (fHistoryCount == 0) {
+      return 0;
+    }
+    float sum = 0;
+    for (size_t n = 0; n < fHistoryCount; n++) {
+      sum += values[(fHistoryIndex + kHistorySize - n) % kHistorySize];
+    }
+    return sum / fHistoryCount;
+  }
+
+  struct Frame {
+    std::array<float, PhaseCount> fMilliseconds{};
+    std::array<uint64_t, CounterCount> fCounters{};
+  };
+
+  Frame fCurrent;
+  std::array<int, PhaseCount> fDepth{};
+  std::array<std::array<float, kHistorySize>, PhaseCount> fMilliseconds{};
+  std::array<std::array<float, kHistorySize>, CounterCount> fCounters{};
+  size_t fHistoryIndex = 0;
+  size_t fHistoryCount = 0;
+};
+
+} // namespace nbte
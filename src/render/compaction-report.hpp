@@ -0,0 +1,65 @@
+#pragma once
+
+namespace nbte {
+
+static void RenderCompactionReport(State &s) {
+  using namespace std;
+  if (!s.fCompactionReportOpened) {
+    return;
+  }
+  auto const &style = im::GetStyle();
+
+  float windowWidth = 640;
+  im::SetNextWindowPos(ImVec2(s.fDisplaySize.x - style.FramePadding.x - windowWidth, im::GetFrameHeightWithSpacing()), ImGuiCond_Appearing);
+  im::SetNextWindowSize(ImVec2(windowWidth, 480), ImGuiCond_Appearing);
+  if (Begin(u8"Compaction", &s.fCompactionReportOpened)) {
+    uint64_t reclaimed = 0;
+    size_t failed = 0;
+    for (auto const &result : s.fCompactionReport) {
+      reclaimed += result.reclaimed();
+      if (!result.fError.empty()) {
+        failed++;
+      }
+    }
+    String summary = ToString(s.fCompactionReport.size()) + u8" region files, " + FormatBytes(reclaimed) + u8" reclaimed";
+    if (failed > 0) {
+      summary += u8", " + ToString(failed) + u8" failed";
+    }
+    TextUnformatted(summary);
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY;
+    if (im::BeginTable("compaction", 4, flags)) {
+      im::TableSetupScrollFreeze(0, 1);
+      TableSetupColumn(u8"File", ImGuiTableColumnFlags_WidthStretch);
+      TableSetupColumn(u8"Before", ImGuiTableColumnFlags_WidthFixed);
+      TableSetupColumn(u8"After", ImGuiTableColumnFlags_WidthFixed);
+      TableSetupColumn(u8"Reclaimed", ImGuiTableColumnFlags_WidthFixed);
+      im::TableHeadersRow();
+
+      ImGuiListClipper clipper;
+      clipper.Begin((int)s.fCompactionReport.size());
+      while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+          auto const &result = s.fCompactionReport[i];
+          im::TableNextRow();
+          im::TableNextColumn();
+          TextUnformatted(result.fFile.lexically_relative(s.fCompactionRoot).generic_u8string());
+          im::TableNextColumn();
+          TextUnformatted(FormatBytes(result.fBefore));
+          im::TableNextColumn();
+          TextUnformatted(FormatBytes(result.fAfter));
+          im::TableNextColumn();
+          if (result.fError.empty()) {
+            TextUnformatted(FormatBytes(result.reclaimed()));
+          } else {
+            TextUnformatted(result.fError);
+          }
+        }
+      }
+      im::EndTable();
+    }
+  }
+  im::End();
+}
+
+} // namespace nbte
@@ -0,0 +1,127 @@
+#pragma once
+
+namespace nbte {
+
+static void CollectSizeReport(std::shared_ptr<Node> const &node, String const &path, std::vector<SizeReportItem> &out) {
+  using namespace std;
+  if (auto contents = node->directoryContents(); contents) {
+    String next = node->hasParent() ? path + contents->fDir.filename().u8string() + u8"/" : path;
+    for (auto const &it : contents->fValue) {
+      CollectSizeReport(it, next, out);
+    }
+  } else if (auto region = node->region(); region) {
+    if (region->fValue.index() != 0) {
+      return;
+    }
+    String name = path + region->fFile.filename().u8string();
+    out.push_back(SizeReportItem{name, u8"Region", region->fSize.fDecoded, region->fSize.fCompressed, {}, nullopt});
+    for (auto const &it : get<0>(region->fValue)) {
+      if (!it) {
+        continue;
+      }
+      auto c = it->compound();
+      if (!c) {
+        continue;
+      }
+      mcfile::Pos2i chunk(c->fChunkX, c->fChunkZ);
+      String chunkName = name + u8"/" + c->name();
+      out.push_back(SizeReportItem{chunkName, u8"Chunk", c->fSize.fDecoded, c->fSize.fCompressed, node, chunk});
+      for (auto const &subtree : c->fSize.fLargest) {
+        out.push_back(SizeReportItem{chunkName + u8"/" + subtree.fPath, u8"Subtree", subtree.fDecoded, 0, node, chunk});
+      }
+    }
+  } else if (auto c = node->compound(); c) {
+    out.push_back(SizeReportItem{path + c->name(), u8"File", c->fSize.fDecoded, c->fSize.fCompressed, {}, std::nullopt});
+  }
+}
+
+static void SortSizeReport(std::vector<SizeReportItem> &items, ImGuiTableColumnSortSpecs const &spec) {
+  using namespace std;
+  bool ascending = spec.SortDirection == ImGuiSortDirection_Ascending;
+  stable_sort(items.begin(), items.end(), [&spec, ascending](SizeReportItem const &a, SizeReportItem const &b) {
+    int order = 0;
+    switch (spec.ColumnIndex) {
+    case 0:
+      order = a.fName.compare(b.fName);
+      break;
+    case 1:
+      order = u8string_view(a.fKind).compare(b.fKind);
+      break;
+    case 2:
+      order = a.fDecoded < b.fDecoded ? -1 : (a.fDecoded > b.fDecoded ? 1 : 0);
+      break;
+    case 3:
+      order = a.fCompressed < b.fCompressed ? -1 : (a.fCompressed > b.fCompressed ? 1 : 0);
+      break;
+    }
+    return ascending ? order < 0 : order > 0;
+  });
+}
+
+static void RenderLargestItems(State &s) {
+  using namespace std;
+  if (!s.fLargestItemsOpened) {
+    return;
+  }
+  auto const &style = im::GetStyle();
+
+  float windowWidth = 640;
+  im::SetNextWindowPos(ImVec2(s.fDisplaySize.x - style.FramePadding.x - windowWidth, im::GetFrameHeightWithSpacing()), ImGuiCond_Appearing);
+  im::SetNextWindowSize(ImVec2(windowWidth, 480), ImGuiCond_Appearing);
+  if (Begin(u8"Largest Items", &s.fLargestItemsOpened)) {
+    bool collected = false;
+    if (s.fSizeReportGeneration != s.fSizeGeneration) {
+      s.fSizeReport.clear();
+      if (s.fOpened) {
+        CollectSizeReport(s.fOpened, u8"", s.fSizeReport);
+      }
+      s.fSizeReportGeneration = s.fSizeGeneration;
+      collected = true;
+    }
+    TextUnformatted(ToString(s.fSizeReport.size()) + u8" items in loaded files. Sizes are measured when loaded.");
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable | ImGuiTableFlags_Sortable | ImGuiTableFlags_ScrollY;
+    if (im::BeginTable("largest_items", 4, flags)) {
+      im::TableSetupScrollFreeze(0, 1);
+      TableSetupColumn(u8"Name", ImGuiTableColumnFlags_WidthStretch);
+      TableSetupColumn(u8"Kind", ImGuiTableColumnFlags_WidthFixed);
+      TableSetupColumn(u8"Decoded", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+      TableSetupColumn(u8"Compressed", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending);
+      im::TableHeadersRow();
+
+      if (auto specs = im::TableGetSortSpecs(); specs && specs->SpecsCount > 0 && (specs->SpecsDirty || collected)) {
+        SortSizeReport(s.fSizeReport, specs->Specs[0]);
+        specs->SpecsDirty = false;
+      }
+
+      ImGuiListClipper clipper;
+      clipper.Begin((int)s.fSizeReport.size());
+      while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+          auto const &item = s.fSizeReport[i];
+          im::TableNextRow();
+          im::TableNextColumn();
+          PushID(ToString(i));
+          if (Selectable(item.fName, false, ImGuiSelectableFlags_SpanAllColumns)) {
+            if (auto region = item.fRegion.lock(); region && item.fChunk) {
+              s.fChunkLocatorResponse = make_pair(region, *item.fChunk);
+            }
+          }
+          im::PopID();
+          im::TableNextColumn();
+          TextUnformatted(item.fKind);
+          im::TableNextColumn();
+          TextUnformatted(FormatBytes(item.fDecoded));
+          im::TableNextColumn();
+          if (item.fCompressed > 0) {
+            TextUnformatted(FormatBytes(item.fCompressed));
+          }
+        }
+      }
+      im::EndTable();
+    }
+  }
+  im::End();
+}
+
+} // namespace nbte
@@ -0,0 +1,136 @@
+#pragma once
+
+namespace nbte {
+
+static void RenderProfilerRow(char const *name, float last, float average, float max, char const *format) {
+  im::TableNextRow();
+  im::TableNextColumn();
+  Text("%s", name);
+  im::TableNextColumn();
+  Text(format, last);
+  im::TableNextColumn();
+  Text(format, average);
+  im::TableNextColumn();
+  Text(format, max);
+}
+
+static void SaveTrace(State &s) {
+  if (auto selected = SaveFileDialog(u8"nbte-trace.json"); selected) {
+    if (!s.fTracer.write(*selected)) {
+      s.fError = u8"Can't write trace";
+    }
+  }
+}
+
+static void SaveSession(State &s) {
+  if (auto selected = SaveFileDialog(u8"nbte-session.txt"); selected) {
+    if (!s.fRecorder.write(*selected)) {
+      s.fError = u8"Can't write session";
+    }
+  }
+}
+
+static void RenderProfiler(State &s) {
+  if (!s.fDebugOpened) {
+    return;
+  }
+  auto const &style = im::GetStyle();
+  auto const &profiler = s.fProfiler;
+
+  float windowWidth = 512;
+  im::SetNextWindowPos(ImVec2(s.fDisplaySize.x - style.FramePadding.x - windowWidth, im::GetFrameHeightWithSpacing()), ImGuiCond_Appearing);
+  im::SetNextWindowSize(ImVec2(windowWidth, 0), ImGuiCond_Appearing);
+  if (Begin(u8"Profiler", &s.fDebugOpened)) {
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "Render: %.2f ms", profiler.last(Profiler::PhaseFrame));
+    im::PlotLines("##render", profiler.history(Profiler::PhaseFrame), Profiler::kHistorySize, profiler.historyOffset(), overlay, 0, FLT_MAX, ImVec2(-FLT_MIN, 64));
+
+    snprintf(overlay, sizeof(overlay), "Visit: %.2f ms", profiler.last(Profiler::PhaseVisit));
+    im::PlotLines("##visit", profiler.history(Profiler::PhaseVisit), Profiler::kHistorySize, profiler.historyOffset(), overlay, 0, FLT_MAX, ImVec2(-FLT_MIN, 64));
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+    if (im::BeginTable("profiler_phases", 4, flags)) {
+      TableSetupColumn(u8"Phase [ms]");
+      TableSetupColumn(u8"Last");
+      TableSetupColumn(u8"Average");
+      TableSetupColumn(u8"Max");
+      im::TableHeadersRow();
+      for (int i = 0; i < Profiler::PhaseCount; i++) {
+        auto phase = (Profiler::Phase)i;
+        RenderProfilerRow(Profiler::PhaseName(phase), profiler.last(phase), profiler.average(phase), profiler.max(phase), "%.3f");
+      }
+      im::EndTable();
+    }
+
+    if (im::BeginTable("profiler_counters", 4, flags)) {
+      TableSetupColumn(u8"Counter");
+      TableSetupColumn(u8"Last");
+      TableSetupColumn(u8"Average");
+      TableSetupColumn(u8"Max");
+      im::TableHeadersRow();
+      for (int i = 0; i < Profiler::CounterCount; i++) {
+        auto counter = (Profiler::Counter)i;
+        RenderProfilerRow(Profiler::CounterName(counter), profiler.last(counter), profiler.average(counter), profiler.max(counter), "%.0f");
+      }
+      im::EndTable();
+    }
+
+    if (Button(u8"Dump")) {
+      if (auto selected = SaveFileDialog(u8"nbte-profile.csv"); selected) {
+        if (!profiler.dump(*selected)) {
+          s.fError = u8"Can't write profile";
+        }
+      }
+    }
+    im::SameLine();
+    if (s.fTracer.enabled()) {
+      if (Button(u8"Stop trace")) {
+        s.fTracer.stop();
+        SaveTrace(s);
+      }
+      im::SameLine();
+      Text("%zu events", s.fTracer.size());
+    } else {
+      if (Button(u8"Start trace")) {
+        s.fTracer.start();
+      }
+      if (s.fTracer.size() > 0) {
+        // The tracer stops by itself once it reaches Tracer::kMaxEvents.
+        im::SameLine();
+        if (Button(u8"Save trace")) {
+          SaveTrace(s);
+        }
+      }
+    }
+    im::SameLine();
+    Checkbox(u8"Dear ImGui metrics", &s.fDebugMetricsOpened);
+
+    // Replayed with nbte-frame-bench --replay, which starts with this window opened.
+    if (s.fRecorder.enabled()) {
+      if (Button(u8"Stop recording")) {
+        s.fRecorder.stop();
+        SaveSession(s);
+      }
+      im::SameLine();
+      Text("%zu frames", s.fRecorder.frames());
+    } else {
+      if (Button(u8"Record session")) {
+        s.startRecording();
+      }
+      if (s.fRecorder.frames() > 0) {
+        // The recorder stops by itself once it reaches InputRecorder::kMaxLines.
+        im::SameLine();
+        if (Button(u8"Save session")) {
+          SaveSession(s);
+        }
+      }
+    }
+  }
+  im::End();
+
+  if (s.fDebugMetricsOpened) {
+    im::ShowMetricsWindow(&s.fDebugMetricsOpened);
+  }
+}
+
+} // namespace nbte
@@ -4,60 +4,67 @@ namespace nbte {
 
 constexpr float kIndent = 6.0f;
 
-static void VisitNbtCompound(State &s,
-                             Compound &root,
-                             mcfile::nbt::CompoundTag const &tag,
-                             String const &path,
-                             FilterKey const *key);
-static void VisitNbt(State &s,
-                     Compound &root,
-                     String const &name,
-                     std::shared_ptr<mcfile::nbt::Tag> const &tag,
-                     String const &path,
-                     FilterKey const *key);
+template <class Value>
+static void VisitValue(State &s,
+                       Compound &root,
+                       Value const &value,
+                       String const &name,
+                       String const &path,
+                       FilterKey const *key);
 static void Visit(State &s,
                   std::shared_ptr<Node> const &node,
                   String const &path,
                   FilterKey const *key);
 
-static void RenderSavingModal(State &s) {
-  OpenPopup(u8"Info");
-  im::SetNextWindowSize(ImVec2(512, 0));
-  if (BeginPopupModal(u8"Info", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_AlwaysAutoResize)) {
-    TextUnformatted(u8"Saving edited files...");
-    im::EndPopup();
-  }
-}
-
 static void Save(State &s) {
   if (!s.canSave()) {
     return;
   }
-  RenderSavingModal(s);
   s.save();
 }
 
 static void RenderMainMenu(State &s) {
   if (im::BeginMenuBar()) {
     if (BeginMenu(u8"File", &s.fMainMenuBarFileSelected)) {
-      if (MenuItem(u8"Open", DecorateModCtrl(u8"O"), nullptr)) {
+      if (MenuItem(u8"Open", DecorateModCtrl(u8"O"), nullptr, s.canOpen())) {
         if (auto selected = OpenFileDialog(); selected) {
-          s.open(*selected);
+          s.openChosen(*selected, false);
         }
       }
-      if (MenuItem(u8"Open Folder", DecorateModCtrl(u8"Shift+O"), nullptr)) {
+      if (MenuItem(u8"Open Folder", DecorateModCtrl(u8"Shift+O"), nullptr, s.canOpen())) {
         if (auto selected = OpenDirectoryDialog(); selected) {
-          s.openDirectory(*selected);
+          s.openChosen(*selected, true);
         }
       }
       if (s.fMinecraftSaveDirectory) {
-        if (MenuItem(u8"Open Minecraft Save Directory", {}, nullptr)) {
-          s.openDirectory(*s.fMinecraftSaveDirectory);
+        if (MenuItem(u8"Open Minecraft Save Directory", {}, nullptr, s.canOpen())) {
+          s.openChosen(*s.fMinecraftSaveDirectory, true);
         }
       }
       if (MenuItem(u8"Save", DecorateModCtrl(u8"S"), nullptr, s.canSave())) {
         Save(s);
       }
+      if (BeginMenu(u8"Compression")) {
+        static std::pair<SaveProfile, char8_t const *> const sProfiles[] = {
+            {SaveProfile::Fast, u8"Fast"},
+            {SaveProfile::Balanced, u8"Balanced"},
+            {SaveProfile::Smallest, u8"Smallest"},
+        };
+        for (auto const &[profile, label] : sProfiles) {
+          bool selected = profile == s.fSaveProfile;
+          if (MenuItem(label, {}, &selected)) {
+            s.fSaveProfile = profile;
+          }
+        }
+        im::EndMenu();
+      }
+      im::Separator();
+      if (MenuItem(u8"Compact Regions", {}, nullptr, s.fOpened != nullptr && s.canOpen())) {
+        s.compactRegions(s.fOpenedPath);
+      }
+      if (MenuItem(u8"Scan Regions", {}, nullptr, s.fOpened != nullptr && !s.scanning())) {
+        s.scanRegions(s.fOpenedPath);
+      }
       im::Separator();
       if (MenuItem(u8"Quit", QuitMenuShortcut(), nullptr)) {
         s.fQuitRequested = true;
@@ -65,9 +72,25 @@ static void RenderMainMenu(State &s) {
       im::EndMenu();
     }
     if (BeginMenu(u8"View", &s.fMainMenuBarViewSelected)) {
-      if (MenuItem(u8"Reload", u8"F5", nullptr, s.fOpened != nullptr)) {
+      if (MenuItem(u8"Reload", u8"F5", nullptr, s.fOpened != nullptr && s.canOpen())) {
         s.reload();
       }
+      if (BeginMenu(u8"Memory Budget")) {
+        static size_t const sBudgets[] = {size_t(256) << 20, size_t(512) << 20, size_t(1) << 30, size_t(2) << 30, size_t(4) << 30, size_t(8) << 30};
+        for (size_t budget : sBudgets) {
+          bool selected = budget == s.fMemoryBudget.budget();
+          if (MenuItem(FormatBytes(budget), {}, &selected)) {
+            s.fMemoryBudget.setBudget(budget);
+          }
+        }
+        im::EndMenu();
+      }
+      MenuItem(u8"Show Sizes", {}, &s.fShowSizes);
+      MenuItem(u8"Largest Items", {}, &s.fLargestItemsOpened);
+      bool dedup = BlobPool::Shared().enabled();
+      if (MenuItem(u8"Deduplicate Chunk Data", {}, &dedup)) {
+        BlobPool::Shared().setEnabled(dedup);
+      }
       im::EndMenu();
     }
     if (BeginMenu(u8"Find", &s.fMainMenuBarFindSelected)) {
@@ -172,6 +195,7 @@ static void RenderQuitDialog(State &s) {
     im::SameLine(0, 50);
     PushDestructiveButtonStyles();
     if (Button(u8"No", ImVec2(64, 0))) {
+      s.fJournal.clear();
       s.fQuitAccepted = true;
       s.fQuitRequested = false;
       im::CloseCurrentPopup();
@@ -190,6 +214,41 @@ static void RenderQuitDialog(State &s) {
   }
 }
 
+static void RenderJournalRecoveryDialog(State &s) {
+  using namespace std;
+  if (s.fRecoveredEdits.empty()) {
+    return;
+  }
+  OpenPopup(u8"Recover Edits?");
+  im::SetNextWindowSize(ImVec2(512, 0), ImGuiCond_Once);
+  if (BeginPopupModal(u8"Recover Edits?", nullptr)) {
+    set<String> files;
+    for (auto const &r : s.fRecoveredEdits) {
+      files.insert(r.fFile);
+    }
+    TextUnformatted(u8"Edits not saved in the previous session were found. Apply them to these files?");
+    for (auto const &file : files) {
+      BulletText(file);
+    }
+    im::NewLine();
+    if (s.fRecoveryTask) {
+      TextUnformatted(u8"Applying edits...");
+    } else {
+      if (Button(u8"Apply to Files")) {
+        s.applyRecoveredEdits();
+      }
+      im::SameLine(0, 50);
+      PushDestructiveButtonStyles();
+      if (Button(u8"Discard")) {
+        s.discardRecoveredEdits();
+        im::CloseCurrentPopup();
+      }
+      PopDestructiveButtonStyles();
+    }
+    im::EndPopup();
+  }
+}
+
 template <class T, class U>
 static T Clamp(U u) {
   return (T)std::min<U>(std::max<U>(u, (U)std::numeric_limits<T>::lowest()), (U)std::numeric_limits<T>::max());
@@ -220,12 +279,14 @@ static ImGuiDataType DataType() {
 }
 
 template <std::integral T>
-static void InputScalar(T &v, Compound &root) {
+static bool InputScalar(T &v, Compound &root) {
   ImGuiDataType type = DataType<T>();
   T step = 1;
   if (im::InputScalar("", type, &v, &step)) {
-    root.fEdited = true;
+    root.markEdited();
+    return true;
   }
+  return false;
 }
 
 static void PushScalarInput(String const &name,
@@ -253,81 +314,141 @@ static void PopScalarInput() {
   im::PopItemWidth();
 }
 
-static void VisitNbtScalar(State &s,
-                           Compound &root,
-                           String const &name,
-                           std::shared_ptr<mcfile::nbt::Tag> const &tag,
-                           String const &path,
-                           FilterKey const *key) {
+template <class Value>
+static void VisitScalar(State &s,
+                        Compound &root,
+                        Value value,
+                        String const &name,
+                        String const &path,
+                        FilterKey const *key) {
   using namespace std;
-  using namespace mcfile::nbt;
-
-  switch (tag->type()) {
-  case Tag::Type::Int:
-    if (auto v = dynamic_pointer_cast<IntTag>(tag); v) {
-      PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeI);
-      InputScalar<int>(v->fValue, root);
+  using Type = typename Value::Type;
+
+  bool edited = false;
+  switch (value.type()) {
+  case Type::Int: {
+    PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeI);
+    int32_t v = value.template scalar<int32_t>();
+    if (InputScalar<int32_t>(v, root)) {
+      value.setScalar(v);
+      edited = true;
     }
     break;
-  case Tag::Type::Byte:
-    if (auto v = dynamic_pointer_cast<ByteTag>(tag); v) {
-      PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeB);
-      InputScalar<uint8_t>(v->fValue, root);
+  }
+  case Type::Byte: {
+    PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeB);
+    uint8_t v = value.template scalar<uint8_t>();
+    if (InputScalar<uint8_t>(v, root)) {
+      value.setScalar(v);
+      edited = true;
     }
     break;
-  case Tag::Type::Short:
-    if (auto v = dynamic_pointer_cast<ShortTag>(tag); v) {
-      PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeS);
-      InputScalar<int16_t>(v->fValue, root);
+  }
+  case Type::Short: {
+    PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeS);
+    int16_t v = value.template scalar<int16_t>();
+    if (InputScalar<int16_t>(v, root)) {
+      value.setScalar(v);
+      edited = true;
     }
     break;
-  case Tag::Type::Long:
-    if (auto v = dynamic_pointer_cast<LongTag>(tag); v) {
-      PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeL);
-      InputScalar(v->fValue, root);
+  }
+  case Type::Long: {
+    PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeL);
+    int64_t v = value.template scalar<int64_t>();
+    if (InputScalar<int64_t>(v, root)) {
+      value.setScalar(v);
+      edited = true;
     }
     break;
-  case Tag::Type::String:
-    if (auto v = dynamic_pointer_cast<StringTag>(tag); v) {
-      PushScalarInput(name, path, key, s.fTextures.fIconEditSmallCaps);
-      String value = v->fValue;
-      if (InputText(u8"", &value)) {
-        v->fValue = value;
-        root.fEdited = true;
+  }
+  case Type::String: {
+    PushScalarInput(name, path, key, s.fTextures.fIconEditSmallCaps);
+    String v = value.string();
+    if (InputText(u8"", &v) && value.setString(v)) {
+      root.markEdited();
+      edited = true;
+      if constexpr (!Value::kStableEntries) {
+        s.fCacheSelector.invalidate();
       }
     }
     break;
-  case mcfile::nbt::Tag::Type::Float:
-    if (auto v = dynamic_pointer_cast<FloatTag>(tag); v) {
-      PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeF);
-      if (InputFloat(u8"", &v->fValue)) {
-        root.fEdited = true;
-      }
+  }
+  case Type::Float: {
+    PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeF);
+    float v = value.template scalar<float>();
+    if (InputFloat(u8"", &v)) {
+      value.setScalar(v);
+      root.markEdited();
+      edited = true;
     }
     break;
-  case mcfile::nbt::Tag::Type::Double:
-    if (auto v = dynamic_pointer_cast<DoubleTag>(tag); v) {
-      PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeD);
-      if (InputDouble(u8"", &v->fValue)) {
-        root.fEdited = true;
-      }
+  }
+  case Type::Double: {
+    PushScalarInput(name, path, key, s.fTextures.fIconDocumentAttributeD);
+    double v = value.template scalar<double>();
+    if (InputDouble(u8"", &v)) {
+      value.setScalar(v);
+      root.markEdited();
+      edited = true;
     }
     break;
+  }
   default:
-    break;
+    return;
+  }
+  if (edited) {
+    value.record(s.fJournal, root);
   }
 
   PopScalarInput();
 }
 
-static void VisitNbtNonScalar(State &s,
-                              Compound &root,
-                              String const &name,
-                              std::shared_ptr<mcfile::nbt::Tag> const &tag,
-                              String const &path,
-                              FilterKey const *filterKey) {
+template <std::integral T, class Value>
+static void VisitArray(State &s, Compound &root, Value value, String const &path, FilterKey const *filter, std::optional<Texture> const &icon) {
+  for (uint32_t i = 0; i < value.size(); i++) {
+    auto label = u8"#" + ToString(i);
+    PushScalarInput(label, path, filter, icon);
+    T v = value.template element<T>(i);
+    if (InputScalar<T>(v, root)) {
+      value.setElement(i, v);
+      value.record(s.fJournal, root, i);
+    }
+    PopScalarInput();
+  }
+}
+
+template <class Value>
+static void VisitCompound(State &s,
+                          Compound &root,
+                          Value const &value,
+                          String const &path,
+                          FilterKey const *filter) {
+  value.forEachChild([&](uint32_t, String const *name, Value const &child) {
+    if (filter) {
+      if (s.fFilterMode == FilterMode::Key) {
+        if (!child.matchKey(s, *name, *filter) && !s.containsTerm(child.entry(), filter, s.fFilterMode)) {
+          return;
+        }
+      } else {
+        if (!s.containsTerm(child.entry(), filter, s.fFilterMode)) {
+          return;
+        }
+      }
+    }
+    VisitValue(s, root, child, *name, path, filter);
+  });
+}
+
+template <class Value>
+static void VisitNonScalar(State &s,
+                           Compound &root,
+                           Value const &value,
+                           String const &name,
+                           String const &path,
+                           FilterKey const *filterKey) {
   using namespace std;
-  using namespace mcfile::nbt;
+  using Type = typename Value::Type;
 
   FilterKey const *filter = filterKey;
   bool matchedNode = filter && filter->match(name);
@@ -335,50 +456,23 @@ static void VisitNbtNonScalar(State &s,
     filter = nullptr;
   }
 
+  Type type = value.type();
   optional<Texture> icon = nullopt;
-  int size = 0;
-  switch (tag->type()) {
-  case Tag::Type::Compound:
-    if (filter) {
-      if (!s.containsTerm(tag, filter, s.fFilterMode)) {
-        return;
-      }
-    }
-    if (auto v = dynamic_pointer_cast<CompoundTag>(tag); v) {
-      size = v->size();
-    }
-    icon = s.fTextures.fIconBox;
-    break;
-  case Tag::Type::List:
+  switch (type) {
+  case Type::Compound:
+  case Type::List:
     if (filter) {
-      if (!s.containsTerm(tag, filter, s.fFilterMode)) {
+      if (!s.containsTerm(value.entry(), filter, s.fFilterMode)) {
         return;
       }
     }
-    if (auto v = dynamic_pointer_cast<ListTag>(tag); v) {
-      size = v->size();
-    }
-    icon = s.fTextures.fIconEditList;
+    icon = type == Type::Compound ? s.fTextures.fIconBox : s.fTextures.fIconEditList;
     break;
-  case Tag::Type::ByteArray:
-    if (auto v = dynamic_pointer_cast<ByteArrayTag>(tag); v) {
-      size = v->fValue.size();
-    }
-    icon = s.fTextures.fIconEditCode;
-    break;
-  case Tag::Type::IntArray:
-    if (auto v = dynamic_pointer_cast<IntArrayTag>(tag); v) {
-      size = v->fValue.size();
-    }
-    icon = s.fTextures.fIconEditCode;
-    break;
-  case Tag::Type::LongArray:
-    if (auto v = dynamic_pointer_cast<LongArrayTag>(tag); v) {
-      size = v->fValue.size();
-    }
+  default:
     icon = s.fTextures.fIconEditCode;
     break;
   }
+  uint32_t size = value.size();
   String label = name + u8": ";
   if (size < 2) {
     label += ToString(size) + u8" entry";
@@ -405,50 +499,25 @@ static void VisitNbtNonScalar(State &s,
   if (TreeNode(label, flags, opt).opened) {
     im::Indent(kIndent);
 
-    switch (tag->type()) {
-    case Tag::Type::Compound:
-      if (auto v = dynamic_pointer_cast<CompoundTag>(tag); v) {
-        VisitNbtCompound(s, root, *v, nextPath, filter);
-      }
+    switch (type) {
+    case Type::Compound:
+      VisitCompound(s, root, value, nextPath, filter);
       break;
-    case Tag::Type::List:
-      if (auto v = dynamic_pointer_cast<ListTag>(tag); v) {
-        for (size_t i = 0; i < v->fValue.size(); i++) {
-          auto const &it = v->fValue[i];
-          auto label = u8"#" + ToString(i);
-          VisitNbt(s, root, label, it, nextPath, filter);
-        }
-      }
+    case Type::List:
+      value.forEachChild([&](uint32_t i, String const *, Value const &child) {
+        VisitValue(s, root, child, u8"#" + ToString(i), nextPath, filter);
+      });
       break;
-    case Tag::Type::ByteArray:
-      if (auto v = dynamic_pointer_cast<ByteArrayTag>(tag); v) {
-        for (size_t i = 0; i < v->fValue.size(); i++) {
-          auto label = u8"#" + ToString(i);
-          PushScalarInput(label, nextPath, filter, s.fTextures.fIconDocumentAttributeB);
-          InputScalar<uint8_t>(v->fValue[i], root);
-          PopScalarInput();
-        }
-      }
+    case Type::ByteArray:
+      VisitArray<uint8_t>(s, root, value, nextPath, filter, s.fTextures.fIconDocumentAttributeB);
       break;
-    case Tag::Type::IntArray:
-      if (auto v = dynamic_pointer_cast<IntArrayTag>(tag); v) {
-        for (size_t i = 0; i < v->fValue.size(); i++) {
-          auto label = u8"#" + ToString(i);
-          PushScalarInput(label, nextPath, filter, s.fTextures.fIconDocumentAttributeI);
-          InputScalar<int>(v->fValue[i], root);
-          PopScalarInput();
-        }
-      }
+    case Type::IntArray:
+      VisitArray<int32_t>(s, root, value, nextPath, filter, s.fTextures.fIconDocumentAttributeI);
       break;
-    case Tag::Type::LongArray:
-      if (auto v = dynamic_pointer_cast<LongArrayTag>(tag); v) {
-        for (size_t i = 0; i < v->fValue.size(); i++) {
-          auto label = u8"#" + ToString(i);
-          PushScalarInput(label, nextPath, filter, s.fTextures.fIconDocumentAttributeL);
-          InputScalar<int64_t>(v->fValue[i], root);
-          PopScalarInput();
-        }
-      }
+    case Type::LongArray:
+      VisitArray<int64_t>(s, root, value, nextPath, filter, s.fTextures.fIconDocumentAttributeL);
+      break;
+    default:
       break;
     }
 
@@ -458,59 +527,39 @@ static void VisitNbtNonScalar(State &s,
   im::PopID();
 }
 
-static void VisitNbt(State &s,
-                     Compound &root,
-                     String const &name,
-                     std::shared_ptr<mcfile::nbt::Tag> const &tag,
-                     String const &path,
-                     FilterKey const *filter) {
-  using namespace mcfile::nbt;
-
-  switch (tag->type()) {
-  case Tag::Type::Compound:
-  case Tag::Type::List:
-  case Tag::Type::ByteArray:
-  case Tag::Type::IntArray:
-  case Tag::Type::LongArray:
-    VisitNbtNonScalar(s, root, name, tag, path, filter);
+// Renders a tag held either as mcfile::nbt::Tag or in a Tape, see TagValue and TapeValue.
+template <class Value>
+static void VisitValue(State &s,
+                       Compound &root,
+                       Value const &value,
+                       String const &name,
+                       String const &path,
+                       FilterKey const *filter) {
+  using Type = typename Value::Type;
+
+  switch (value.type()) {
+  case Type::Compound:
+  case Type::List:
+  case Type::ByteArray:
+  case Type::IntArray:
+  case Type::LongArray:
+    VisitNonScalar(s, root, value, name, path, filter);
     break;
   default:
-    VisitNbtScalar(s, root, name, tag, path, filter);
+    VisitScalar(s, root, value, name, path, filter);
     break;
   }
 }
 
-static void VisitNbtCompound(State &s,
-                             Compound &root,
-                             mcfile::nbt::CompoundTag const &tag,
-                             String const &path,
-                             FilterKey const *filter) {
-  using namespace std;
-  using namespace mcfile::nbt;
-
-  for (auto &it : tag) {
-    String name = it.first;
-    if (!it.second) {
-      continue;
-    }
-    if (filter) {
-      if (s.fFilterMode == FilterMode::Key) {
-        if (!filter->match(name) && !s.containsTerm(it.second, filter, s.fFilterMode)) {
-          continue;
-        }
-      } else {
-        if (!s.containsTerm(it.second, filter, s.fFilterMode)) {
-          continue;
-        }
-      }
-    }
-    VisitNbt(s, root, name, it.second, path, filter);
+static std::optional<String> SizeBadge(State const &s, NodeSize const &size) {
+  if (!s.fShowSizes || size.fDecoded == 0) {
+    return std::nullopt;
   }
+  return FormatBytes(size.fDecoded) + u8" / " + FormatBytes(size.fCompressed);
 }
 
 static void RenderRegion(State &s, String const &path, String const &name, std::shared_ptr<Node> const &node, nbte::Region &region, FilterKey const *filter) {
-  bool ready = region.wait(s);
-  if (ready) {
+  if (region.ready()) {
     auto const &values = std::get<0>(region.fValue);
     for (int z = 0; z < 32; z++) {
       auto response = s.fChunkLocatorResponse;
@@ -521,7 +570,7 @@ static void RenderRegion(State &s, String const &path, String const &name, std::
           continue;
         }
         auto hitX = hitZ && response->second.fX == region.fX * 32 + x;
-        if (hitX && hitZ) {
+        if (hitX && hitZ && value->compound()) {
           im::SetNextItemOpen(true);
           s.fChunkFadeTimeout = std::make_pair(value, im::GetTime() + 3);
         }
@@ -542,12 +591,31 @@ static void RenderRegion(State &s, String const &path, String const &name, std::
   }
 }
 
+// Context menu of a region file, or of a directory holding region files.
+static void RenderRegionContextMenu(State &s, bool requested, Path const &target) {
+  if (requested) {
+    OpenPopup(u8"region_context_menu");
+  }
+  if (BeginPopup(u8"region_context_menu")) {
+    if (MenuItem(u8"Compact Regions", {}, nullptr, s.canOpen())) {
+      s.compactRegions(target);
+    }
+    if (MenuItem(u8"Scan Regions", {}, nullptr, !s.scanning())) {
+      s.scanRegions(target);
+    }
+    im::EndPopup();
+  }
+}
+
 static void Visit(State &s,
                   std::shared_ptr<Node> const &node,
                   String const &path,
                   FilterKey const *key) {
   using namespace std;
 
+  Profiler::Scope scope(s.fProfiler, Profiler::PhaseVisit);
+  s.fProfiler.count(Profiler::CounterVisit);
+
   auto const &style = im::GetStyle();
   float frameHeight = im::GetFrameHeight();
 
@@ -568,6 +636,7 @@ static void Visit(State &s,
     if (node->hasParent()) {
       ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_NavLeftJumpsBackHere;
       opt.icon = s.fTextures.fIconBox;
+      opt.badge = SizeBadge(s, compound->fSize);
       if (filter && filter->match(name)) {
         filter = nullptr;
       }
@@ -582,11 +651,21 @@ static void Visit(State &s,
         }
       }
       if (TreeNode(name, flags, opt).opened) {
-        VisitNbtCompound(s, *compound, *compound->fTag, path, filter);
+        s.touch(node);
+        if (compound->fTape) {
+          VisitCompound(s, *compound, TapeValue(*compound->fTape, 0), path, filter);
+        } else if (compound->fTag) {
+          VisitCompound(s, *compound, TagValue(compound->fTag), path, filter);
+        }
         im::TreePop();
       }
     } else {
-      VisitNbtCompound(s, *compound, *compound->fTag, path, filter);
+      s.touch(node);
+      if (compound->fTape) {
+        VisitCompound(s, *compound, TapeValue(*compound->fTape, 0), path, filter);
+      } else if (compound->fTag) {
+        VisitCompound(s, *compound, TagValue(compound->fTag), path, filter);
+      }
     }
     im::PopID();
   } else if (auto contents = node->directoryContents(); contents) {
@@ -606,7 +685,14 @@ static void Visit(State &s,
     PushID(path + u8"/" + name);
     if (node->hasParent()) {
       opt.icon = s.fTextures.fIconFolder;
-      if (TreeNode(label, ImGuiTreeNodeFlags_NavLeftJumpsBackHere, opt).opened) {
+      if (s.fChunkLocatorResponse) {
+        if (auto target = s.fChunkLocatorResponse->first->path(); target && IsPathUnder(*target, contents->fDir)) {
+          im::SetNextItemOpen(true);
+        }
+      }
+      auto tree = TreeNode(label, ImGuiTreeNodeFlags_NavLeftJumpsBackHere, opt);
+      RenderRegionContextMenu(s, tree.contextMenuRequested, contents->fDir);
+      if (tree.opened) {
         for (auto const &it : contents->fValue) {
           Visit(s, it, path + u8"/" + name, filter);
         }
@@ -626,20 +712,32 @@ static void Visit(State &s,
       filter = nullptr;
     }
     if (node->hasParent()) {
-      bool ready = region->wait(s);
+      bool ready = region->ready();
       opt.icon = s.fTextures.fIconBlock;
       opt.button = u8"Grid";
+      if (region->fValue.index() == 0) {
+        opt.badge = SizeBadge(s, region->fSize);
+      }
       if (s.fChunkLocatorResponse && s.fChunkLocatorResponse->first == node) {
         im::SetNextItemOpen(true);
       }
       auto tree = TreeNode(name, ImGuiTreeNodeFlags_DefaultOpen | ImGuiTreeNodeFlags_NavLeftJumpsBackHere, opt);
+      RenderRegionContextMenu(s, tree.contextMenuRequested, region->fFile);
+      if (!ready) {
+        region->fLoadTask.setPriority(im::IsItemVisible() ? TaskPriority::High : TaskPriority::Low);
+      }
       if (tree.opened) {
+        s.touch(node);
         RenderRegion(s, path, name, node, *region, filter);
         im::TreePop();
       }
       if (tree.buttonActivated) {
         s.fChunkLocatorRequest = std::make_pair(node, mcfile::Pos2i(region->fX, region->fZ));
       }
+      if (!ready && !tree.opened) {
+        // Collapsed before it has loaded, so the loading is not wanted anymore. Opening it again starts over.
+        node->close();
+      }
     } else {
       auto origin = im::GetCursorPos();
       auto regionAvail = im::GetContentRegionAvail();
@@ -657,6 +755,7 @@ static void Visit(State &s,
         s.fChunkLocatorRequest = std::make_pair(node, mcfile::Pos2i(region->fX, region->fZ));
       }
 
+      s.touch(node);
       RenderRegion(s, path, name, node, *region, filter);
     }
     im::PopID();
@@ -666,15 +765,31 @@ static void Visit(State &s,
     optional<Texture> icon = s.fTextures.fIconDocument;
     opt.noArrow = true;
     opt.openIgnoringStorage = false;
+    bool isRegion = false;
     if (auto pos = mcfile::je::Region::RegionXZFromFile(*unopenedFile); pos) {
       icon = s.fTextures.fIconBlock;
+      isRegion = true;
     }
     opt.icon = icon;
     if (filter && filter->match(name)) {
       filter = nullptr;
     }
-    if (TreeNode(name, 0, opt).opened) {
-      node->load(*s.fPool);
+    auto tree = TreeNode(name, 0, opt);
+    if (isRegion) {
+      RenderRegionContextMenu(s, tree.contextMenuRequested, *unopenedFile);
+    }
+    if (tree.opened) {
+      // Files being saved or compacted are read once that has finished.
+      if (s.canOpen()) {
+        node->load(*s.fPool, s.fRegionCompletions);
+        s.touch(node);
+        s.fSizeGeneration++;
+      }
+      if (node->loading() || !s.canOpen()) {
+        im::Indent(im::GetTreeNodeToLabelSpacing());
+        TextUnformatted(u8"loading...");
+        im::Unindent(im::GetTreeNodeToLabelSpacing());
+      }
       im::TreePop();
     }
     im::PopID();
@@ -686,8 +801,10 @@ static void Visit(State &s,
       filter = nullptr;
     }
     PushID(path + u8"/" + name);
-    if (TreeNode(name, ImGuiTreeNodeFlags_DefaultOpen | ImGuiTreeNodeFlags_NavLeftJumpsBackHere, opt).opened) {
-      node->load(*s.fPool);
+    auto tree = TreeNode(name, ImGuiTreeNodeFlags_DefaultOpen | ImGuiTreeNodeFlags_NavLeftJumpsBackHere, opt);
+    RenderRegionContextMenu(s, tree.contextMenuRequested, *unopenedDirectory);
+    if (tree.opened) {
+      node->load(*s.fPool, s.fRegionCompletions);
       im::Indent(im::GetTreeNodeToLabelSpacing());
       TextUnformatted(u8"loading...");
       im::Unindent(im::GetTreeNodeToLabelSpacing());
@@ -709,6 +826,14 @@ static void Visit(State &s,
     }
     im::PopID();
     im::Unindent(im::GetTreeNodeToLabelSpacing());
+  } else if (auto broken = node->brokenChunk(); broken) {
+    im::Indent(im::GetTreeNodeToLabelSpacing());
+    PushID(path + u8"/" + broken->fName);
+    im::PushStyleColor(ImGuiCol_Text, style.Colors[ImGuiCol_TextDisabled]);
+    IconLabel(broken->fName + u8": " + broken->fError, s.fTextures.fIconDocumentExclamation);
+    im::PopStyleColor();
+    im::PopID();
+    im::Unindent(im::GetTreeNodeToLabelSpacing());
   }
 }
 
@@ -716,6 +841,13 @@ static void RenderNode(State &s) {
   if (!s.fOpened) {
     return;
   }
+  Profiler::Scope scope(s.fProfiler, Profiler::PhaseRenderNode);
+  Tracer::Scope trace(s.fTracer, "RenderNode", "frame", "UI");
+  if (s.fOpened->loading() && s.fOpened->fileUnopened()) {
+    // The opened file is read on the pool.
+    TextUnformatted(u8"loading...");
+    return;
+  }
   Visit(s, s.fOpened, u8"", s.filterKey());
 }
 
@@ -729,10 +861,20 @@ static void RenderFooter(State &s) {
   if (s.fOpened && !s.fOpenedPath.empty()) {
     im::PushItemWidth(-FLT_EPSILON);
     auto formatDescription = s.fOpened->description();
+    String status = u8", Memory: " + FormatBytes(s.fMemoryBudget.usage()) + u8" / " + FormatBytes(s.fMemoryBudget.budget());
+    if (s.saving()) {
+      status += u8", Saving...";
+    }
+    if (s.compacting()) {
+      status += u8", Compacting...";
+    }
+    if (s.scanning()) {
+      status += u8", Scanning " + ToString(s.fScanProgress->fScanned.load()) + u8" / " + ToString(s.fScanProgress->fTotal.load());
+    }
     if (formatDescription.empty()) {
-      TextUnformatted(u8"Path: " + s.fOpenedPath.u8string());
+      TextUnformatted(u8"Path: " + s.fOpenedPath.u8string() + status);
     } else {
-      TextUnformatted(u8"Path: " + s.fOpenedPath.u8string() + u8", Format: " + formatDescription);
+      TextUnformatted(u8"Path: " + s.fOpenedPath.u8string() + u8", Format: " + formatDescription + status);
     }
     im::PopItemWidth();
   }
@@ -809,16 +951,17 @@ static void CaptureShortcutKey(State &s) {
   if (im::IsKeyDown(GetModCtrlKeyIndex())) {
     if (im::IsKeyDown(im::GetKeyIndex(ImGuiKey_F))) {
       s.fFilterBarOpened = true;
-    } else if (im::IsKeyDown(im::GetKeyIndex(ImGuiKey_S)) && s.fOpened) {
+    } else if (im::IsKeyPressed(im::GetKeyIndex(ImGuiKey_S), false) && s.fOpened) {
+      // Saving doesn't block the UI anymore, so holding the keys must not queue a save every frame.
       Save(s);
-    } else if (im::IsKeyDown(im::GetKeyIndex(ImGuiKey_O))) {
+    } else if (im::IsKeyDown(im::GetKeyIndex(ImGuiKey_O)) && s.canOpen()) {
       if (im::IsKeyDown(im::GetKeyIndex(ImGuiKey_ModShift))) {
         if (auto selected = OpenDirectoryDialog(); selected) {
-          s.openDirectory(*selected);
+          s.openChosen(*selected, true);
         }
       } else {
         if (auto selected = OpenFileDialog(); selected) {
-          s.open(*selected);
+          s.openChosen(*selected, false);
         }
       }
 #if NBTE_NAVBAR
@@ -829,64 +972,143 @@ static void CaptureShortcutKey(State &s) {
   } else if (im::IsKeyReleased(im::GetKeyIndex(ImGuiKey_F3))) {
     s.fDebugOpened = !s.fDebugOpened;
   } else if (im::IsKeyReleased(im::GetKeyIndex(ImGuiKey_F5))) {
-    if (s.fOpened) {
+    if (s.fOpened && s.canOpen()) {
       s.reload();
     }
   }
 }
 
+static ImU32 ChunkLocatorHeatColor(float t) {
+  ImVec4 cold(0.80f, 0.88f, 1.0f, 1.0f);
+  ImVec4 hot(1.0f, 0.23f, 0.19f, 1.0f);
+  t = std::clamp(t, 0.0f, 1.0f);
+  return im::GetColorU32(ImVec4(cold.x + (hot.x - cold.x) * t, cold.y + (hot.y - cold.y) * t, cold.z + (hot.z - cold.z) * t, 1.0f));
+}
+
+static String FormatTimestamp(uint32_t timestamp) {
+  time_t t = (time_t)timestamp;
+  char buffer[64] = {0};
+  if (auto tm = std::localtime(&t); tm) {
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", tm);
+  }
+  return ReinterpretAsU8String(buffer);
+}
+
 static void RenderChunkLocator(State &s) {
+  using namespace std;
+
   auto request = s.fChunkLocatorRequest;
   if (!request) {
+    s.fChunkLocatorHeader = nullopt;
     return;
   }
   auto region = request->first->region();
   if (!region) {
     return;
   }
+  if (!s.fChunkLocatorHeader || s.fChunkLocatorHeader->first != request->first) {
+    auto header = RegionHeader::Read(region->fFile);
+    s.fChunkLocatorHeader = make_pair(request->first, header ? *header : RegionHeader());
+  }
+  auto const &entries = s.fChunkLocatorHeader->second.fEntries;
   float const frameHeight = im::GetFrameHeight();
 
   im::OpenPopup("Locate chunk to open");
   bool open = true;
-  if (im::BeginPopupModal("Locate chunk to open", &open)) {
-    auto origin = im::GetCursorPos();
-    auto ready = region->wait(s);
+  if (BeginPopupModal(u8"Locate chunk to open", &open, ImGuiWindowFlags_AlwaysAutoResize)) {
+    int mode = (int)s.fChunkLocatorMode;
+    RadioButton(u8"Presence", &mode, (int)ChunkLocatorMode::Presence);
+    im::SameLine();
+    RadioButton(u8"Size", &mode, (int)ChunkLocatorMode::Size);
+    im::SameLine();
+    RadioButton(u8"Last modified", &mode, (int)ChunkLocatorMode::Timestamp);
+    s.fChunkLocatorMode = (ChunkLocatorMode)mode;
+
+    uint32_t minimum = numeric_limits<uint32_t>::max();
+    uint32_t maximum = 0;
+    for (auto const &entry : entries) {
+      if (!entry.present()) {
+        continue;
+      }
+      uint32_t v = s.fChunkLocatorMode == ChunkLocatorMode::Timestamp ? entry.fTimestamp : entry.fSectorCount;
+      minimum = std::min(minimum, v);
+      maximum = std::max(maximum, v);
+    }
+    if (s.fChunkLocatorMode == ChunkLocatorMode::Size && maximum > 0) {
+      Text("%u KiB - %u KiB", minimum * 4, maximum * 4);
+    } else if (s.fChunkLocatorMode == ChunkLocatorMode::Timestamp && maximum > 0) {
+      TextUnformatted(FormatTimestamp(minimum) + u8" - " + FormatTimestamp(maximum));
+    } else {
+      TextUnformatted(u8"");
+    }
 
+    ImVec2 origin = im::GetCursorScreenPos();
+    im::InvisibleButton("chunk_locator_grid", ImVec2(32 * frameHeight, 32 * frameHeight));
+    optional<pair<int, int>> hovered;
+    if (im::IsItemHovered()) {
+      ImVec2 mouse = im::GetMousePos();
+      int x = (int)((mouse.x - origin.x) / frameHeight);
+      int z = (int)((mouse.y - origin.y) / frameHeight);
+      if (0 <= x && x < 32 && 0 <= z && z < 32) {
+        hovered = make_pair(x, z);
+      }
+    }
+
+    ImDrawList *list = im::GetWindowDrawList();
+    ImU32 const absent = im::GetColorU32(ImGuiCol_FrameBg);
+    ImU32 const present = im::GetColorU32(ImGuiCol_Button);
+    ImU32 const highlight = im::GetColorU32(ImGuiCol_ButtonHovered);
     for (int z = 0; z < 32; z++) {
       for (int x = 0; x < 32; x++) {
-        int cx = request->second.fX * 32 + x;
-        int cz = request->second.fZ * 32 + z;
-        im::SetCursorPos(ImVec2(origin.x + x * frameHeight, origin.y + z * frameHeight));
-        auto id = std::string("chunk_locator_") + std::to_string(cx) + "_" + std::to_string(cz);
-        im::PushID(id.c_str());
-        bool disable = true;
-        if (ready) {
-          if (std::get<0>(region->fValue)[Region::Index(x, z)]) {
-            disable = false;
+        auto const &entry = entries[Region::Index(x, z)];
+        ImU32 color = absent;
+        if (entry.present()) {
+          if (hovered && hovered->first == x && hovered->second == z) {
+            color = highlight;
+          } else if (s.fChunkLocatorMode == ChunkLocatorMode::Presence || maximum == minimum) {
+            color = present;
+          } else {
+            uint32_t v = s.fChunkLocatorMode == ChunkLocatorMode::Timestamp ? entry.fTimestamp : entry.fSectorCount;
+            color = ChunkLocatorHeatColor((float)(v - minimum) / (float)(maximum - minimum));
           }
         }
-        im::BeginDisabled(disable);
-        if (im::Button("", ImVec2(frameHeight, frameHeight))) {
-          s.fChunkLocatorRequest = std::nullopt;
-          s.fChunkLocatorResponse = std::make_pair(request->first, mcfile::Pos2i(cx, cz));
-        }
-        im::EndDisabled();
-        im::PopID();
-        if (im::IsItemHovered()) {
-          im::SetTooltip("Chunk %d %d [%d %d in region]", cx, cz, x, z);
+        ImVec2 topLeft(origin.x + x * frameHeight, origin.y + z * frameHeight);
+        list->AddRectFilled(ImVec2(topLeft.x + 1, topLeft.y + 1), ImVec2(topLeft.x + frameHeight - 1, topLeft.y + frameHeight - 1), color, 2.0f);
+      }
+    }
+
+    if (hovered) {
+      int x = hovered->first;
+      int z = hovered->second;
+      int cx = request->second.fX * 32 + x;
+      int cz = request->second.fZ * 32 + z;
+      auto const &entry = entries[Region::Index(x, z)];
+      String tooltip = u8"Chunk " + ToString(cx) + u8" " + ToString(cz) + u8" [" + ToString(x) + u8" " + ToString(z) + u8" in region]";
+      if (entry.present()) {
+        tooltip += u8"\nSize: " + ToString(entry.fSectorCount * RegionHeader::kSectorSize / 1024) + u8" KiB";
+        tooltip += u8"\nLast modified: " + FormatTimestamp(entry.fTimestamp);
+        SetTooltip(tooltip);
+        if (im::IsItemClicked()) {
+          s.fChunkLocatorRequest = nullopt;
+          s.fChunkLocatorResponse = make_pair(request->first, mcfile::Pos2i(cx, cz));
         }
-        im::SameLine();
+      } else {
+        SetTooltip(tooltip);
       }
-      im::NewLine();
     }
     im::EndPopup();
   } else {
-    s.fChunkLocatorRequest = std::nullopt;
+    s.fChunkLocatorRequest = nullopt;
   }
 }
 
 static void Render(State &s) {
+  s.sampleProfiler();
+  Profiler::Scope scope(s.fProfiler, Profiler::PhaseFrame);
+  Tracer::Scope trace(s.fTracer, "Render", "frame", "UI");
+
   s.incrementFrameCount();
+  s.retrieveLoadedRegions();
 
   ImGuiStyle const &style = im::GetStyle();
   ImVec4 bg = style.Colors[ImGuiCol_WindowBg];
@@ -901,10 +1123,6 @@ static void Render(State &s) {
   im::SetWindowPos(ImVec2(0, 0));
   im::SetWindowSize(ImVec2(s.fDisplaySize.x, s.fDisplaySize.y - im::GetFrameHeightWithSpacing()));
 
-  if (s.fSaveTask) {
-    RenderSavingModal(s);
-  }
-
   RenderMainMenu(s);
   RenderErrorPopup(s);
   RenderFilterBar(s);
@@ -917,6 +1135,7 @@ static void Render(State &s) {
   RenderAboutDialog(s);
   RenderLegal(s);
   RenderQuitDialog(s);
+  RenderJournalRecoveryDialog(s);
 
   im::PopStyleColor();
   im::End();
@@ -924,20 +1143,21 @@ static void Render(State &s) {
   RenderFooter(s);
   RenderChunkLocator(s);
 
-  if (!s.fSaveTask) {
-    CaptureShortcutKey(s);
-  }
+  CaptureShortcutKey(s);
 
-  if (s.fDebugOpened) {
-    float windowWidth = 512;
-    im::SetNextWindowPos(ImVec2(s.fDisplaySize.x - style.FramePadding.x - windowWidth, im::GetFrameHeightWithSpacing()), ImGuiCond_Appearing);
-    im::SetNextWindowSize(ImVec2(windowWidth, 0));
-    im::ShowMetricsWindow(&s.fDebugOpened);
-  }
+  RenderProfiler(s);
+  RenderLargestItems(s);
+  RenderCompactionReport(s);
+  RenderScanReport(s);
 
   im::Render();
 
   s.retrieveSaveTask();
+  s.retrieveRecoveryTask();
+  s.retrieveCompactionTask();
+  s.retrieveScanTask();
+  s.enforceMemoryBudget();
+  s.flushJournal();
 }
 
 } // namespace nbte
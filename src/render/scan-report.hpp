@@ -0,0 +1,59 @@
+#pragma once
+
+namespace nbte {
+
+static void RenderScanReport(State &s) {
+  using namespace std;
+  if (!s.fScanReportOpened) {
+    return;
+  }
+  auto const &style = im::GetStyle();
+
+  float windowWidth = 640;
+  im::SetNextWindowPos(ImVec2(s.fDisplaySize.x - style.FramePadding.x - windowWidth, im::GetFrameHeightWithSpacing()), ImGuiCond_Appearing);
+  im::SetNextWindowSize(ImVec2(windowWidth, 480), ImGuiCond_Appearing);
+  if (Begin(u8"Integrity", &s.fScanReportOpened)) {
+    size_t scanned = s.fScanProgress ? s.fScanProgress->fTotal.load() : 0;
+    if (s.fScanReport.empty()) {
+      TextUnformatted(ToString(scanned) + u8" region files scanned, no problems found.");
+    } else {
+      TextUnformatted(ToString(scanned) + u8" region files scanned, " + ToString(s.fScanReport.size()) + u8" problems found. Click a chunk to show it.");
+    }
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY;
+    if (im::BeginTable("integrity", 3, flags)) {
+      im::TableSetupScrollFreeze(0, 1);
+      TableSetupColumn(u8"File", ImGuiTableColumnFlags_WidthFixed);
+      TableSetupColumn(u8"Chunk", ImGuiTableColumnFlags_WidthFixed);
+      TableSetupColumn(u8"Problem", ImGuiTableColumnFlags_WidthStretch);
+      im::TableHeadersRow();
+
+      ImGuiListClipper clipper;
+      clipper.Begin((int)s.fScanReport.size());
+      while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+          auto const &issue = s.fScanReport[i];
+          im::TableNextRow();
+          im::TableNextColumn();
+          PushID(ToString(i));
+          if (Selectable(issue.fFile.lexically_relative(s.fScanRoot).generic_u8string(), false, ImGuiSelectableFlags_SpanAllColumns) && issue.fChunk) {
+            if (auto region = s.locateRegion(issue.fFile); region) {
+              s.fChunkLocatorResponse = make_pair(region, *issue.fChunk);
+            }
+          }
+          im::PopID();
+          im::TableNextColumn();
+          if (issue.fChunk) {
+            TextUnformatted(ToString(issue.fChunk->fX) + u8" " + ToString(issue.fChunk->fZ));
+          }
+          im::TableNextColumn();
+          TextUnformatted(issue.fMessage);
+        }
+      }
+      im::EndTable();
+    }
+  }
+  im::End();
+}
+
+} // namespace nbte
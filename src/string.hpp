@@ -23,4 +23,21 @@ static String ToString(T v) {
   return ReinterpretAsU8String(std::to_string(v));
 }
 
+static String FormatBytes(uint64_t bytes) {
+  static char const *const sUnits[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+  double v = (double)bytes;
+  int unit = 0;
+  while (v >= 1024 && unit + 1 < (int)(sizeof(sUnits) / sizeof(sUnits[0]))) {
+    v /= 1024;
+    unit++;
+  }
+  char buffer[32];
+  if (unit == 0) {
+    snprintf(buffer, sizeof(buffer), "%d %s", (int)bytes, sUnits[unit]);
+  } else {
+    snprintf(buffer, sizeof(buffer), "%.1f %s", v, sUnits[unit]);
+  }
+  return ReinterpretAsU8String(buffer);
+}
+
 } // namespace nbte
@@ -0,0 +1,403 @@
+#pragma once
+
+namespace nbte {
+
+enum class TaskPriority : int {
+  // Visible in the tree, or requested by the user.
+  High = 0,
+  Normal,
+  // Off-screen, or prefetching.
+  Low,
+};
+
+// Checked by a background task between units of work. Once cancelled, the task gives up and returns as early as it can.
+class CancellationToken {
+public:
+  CancellationToken() : fCancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+  bool cancelled() const {
+    return fCancelled->load(std::memory_order_relaxed);
+  }
+
+private:
+  friend class CancellationSource;
+  std::shared_ptr<std::atomic<bool>> fCancelled;
+};
+
+// Held by the owner of a background task. Copies share the token, which is cancelled explicitly or when the last copy
+// has gone, so that a task nobody waits for anymore doesn't run to completion.
+class CancellationSource {
+public:
+  CancellationSource() : fShared(std::make_shared<Shared>()) {}
+
+  CancellationToken token() const {
+    return fShared->fToken;
+  }
+
+  void cancel() {
+    fShared->cancel();
+  }
+
+  bool cancelled() const {
+    return fShared->fToken.cancelled();
+  }
+
+private:
+  struct Shared {
+    ~Shared() {
+      cancel();
+    }
+
+    void cancel() {
+      fToken.fCancelled->store(true, std::memory_order_relaxed);
+    }
+
+    CancellationToken fToken;
+  };
+
+  std::shared_ptr<Shared> fShared;
+};
+
+// Time from enqueueing to completion of the tasks of the queues it is set to, by queue and task name.
+class TaskLatencies {
+public:
+  void add(char const *queue, char const *name, double seconds) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fSeconds[std::string(queue) + "/" + name].push_back(seconds);
+  }
+
+  std::map<std::string, std::vector<double>> take() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto ret = std::move(fSeconds);
+    fSeconds.clear();
+    return ret;
+  }
+
+private:
+  std::mutex fMutex;
+  std::map<std::string, std::vector<double>> fSeconds;
+};
+
+// Thread pool running tasks in priority order. Tasks of the same priority run in the order they were enqueued, and the
+// priority of a queued task can be changed through its Handle. A running task can split its work with parallelFor: the
+// pieces go to the worker's own deque, and idle workers steal them from there. Tasks still queued when the queue is
+// destroyed are run before it returns, so every future gets its result.
+class TaskQueue {
+  struct Job {
+    std::function<void()> fRun;
+    std::atomic<TaskPriority> fPriority;
+  };
+
+  struct Worker {
+    TaskQueue *fOwner;
+    size_t fIndex;
+    std::mutex fMutex;
+    std::deque<std::shared_ptr<Job>> fJobs;
+    std::thread fThread;
+  };
+
+public:
+  class Handle {
+  public:
+    Handle() = default;
+
+    // Does nothing once the task has started.
+    void setPriority(TaskPriority priority) {
+      if (auto job = fJob.lock(); job && fQueue && job->fPriority.load(std::memory_order_relaxed) != priority) {
+        fQueue->reprioritize(job, priority);
+      }
+    }
+
+  private:
+    friend class TaskQueue;
+    Handle(TaskQueue *queue, std::weak_ptr<Job> const &job) : fQueue(queue), fJob(job) {}
+
+    TaskQueue *fQueue = nullptr;
+    std::weak_ptr<Job> fJob;
+  };
+
+  template <class R>
+  struct Task {
+    std::future<R> fFuture;
+    Handle fHandle;
+  };
+
+  static constexpr size_t kPriorityCount = 3;
+
+  TaskQueue(char const *name, size_t numThreads) : fName(name) {
+    numThreads = std::max<size_t>(numThreads, 1);
+    for (size_t i = 0; i < numThreads; i++) {
+      auto worker = std::make_unique<Worker>();
+      worker->fOwner = this;
+      worker->fIndex = i;
+      fWorkers.push_back(std::move(worker));
+    }
+    for (auto &worker : fWorkers) {
+      worker->fThread = std::thread([this, w = worker.get()]() { work(*w); });
+    }
+  }
+
+  TaskQueue(TaskQueue const &) = delete;
+  TaskQueue &operator=(TaskQueue const &) = delete;
+
+  // Waits for the queued tasks as well. Their owners cancel them first when the results are not wanted anymore.
+  ~TaskQueue() {
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fStop = true;
+    }
+    fCondition.notify_all();
+    for (auto &worker : fWorkers) {
+      worker->fThread.join();
+    }
+  }
+
+  void setTracer(Tracer *tracer) {
+    fTracer = tracer;
+  }
+
+  // Must be set before any task is enqueued.
+  void setLatencies(TaskLatencies *latencies) {
+    fLatencies = latencies;
+  }
+
+  // name must be a string literal, it is recorded as is by the tracer.
+  template <class F, class... Args>
+  auto enqueue(char const *name, TaskPriority priority, F &&f, Args &&...args) {
+    using namespace std;
+    fQueued++;
+    uint64_t flow = 0;
+    if (fTracer && fTracer->enabled()) {
+      flow = fTracer->nextId();
+      uint64_t trace = fTracer->begin("enqueue", fName, "UI");
+      fTracer->flowStart(name, fName, "UI", flow);
+      fTracer->end("enqueue", fName, "UI", trace);
+    }
+    chrono::steady_clock::time_point enqueued;
+    if (fLatencies) {
+      enqueued = chrono::steady_clock::now();
+    }
+    auto fn = [this, name, flow, enqueued, f = forward<F>(f), ... args = forward<Args>(args)]() mutable {
+      Running running(*this, name, flow, enqueued);
+      return invoke(f, args...);
+    };
+    using R = invoke_result_t<decltype(fn) &>;
+    auto task = make_shared<packaged_task<R()>>(std::move(fn));
+    auto job = make_shared<Job>();
+    job->fRun = [task]() { (*task)(); };
+    job->fPriority = priority;
+    Task<R> ret{task->get_future(), Handle(this, job)};
+    {
+      lock_guard<mutex> lock(fMutex);
+      fQueues[(int)priority].push_back(job);
+      fGeneration++;
+    }
+    fCondition.notify_one();
+    return ret;
+  }
+
+  // Runs f(i) for i in [0, count), and returns once all of them have finished. Called from a worker of this queue, the
+  // calling worker runs the pieces as well, together with the workers stealing them.
+  template <class F>
+  void parallelFor(size_t count, F const &f) {
+    using namespace std;
+    Worker *self = sWorker && sWorker->fOwner == this ? sWorker : nullptr;
+    if (!self || fWorkers.size() < 2 || count < 2) {
+      for (size_t i = 0; i < count; i++) {
+        f(i);
+      }
+      return;
+    }
+    size_t grain = max<size_t>(1, count / (fWorkers.size() * 4));
+    size_t pieces = (count + grain - 1) / grain;
+    auto done = make_shared<Pieces>();
+    done->fRemaining = pieces;
+    {
+      lock_guard<mutex> lock(self->fMutex);
+      for (size_t begin = 0; begin < count; begin += grain) {
+        size_t end = min(count, begin + grain);
+        auto job = make_shared<Job>();
+        job->fRun = [&f, begin, end, done]() {
+          for (size_t i = begin; i < end; i++) {
+            f(i);
+          }
+          if (done->fRemaining.fetch_sub(1) == 1) {
+            lock_guard<mutex> lock(done->fMutex);
+            done->fCondition.notify_all();
+          }
+        };
+        self->fJobs.push_back(job);
+      }
+    }
+    {
+      lock_guard<mutex> lock(fMutex);
+      fGeneration++;
+    }
+    fCondition.notify_all();
+    // Only pieces are taken while waiting. A whole task from the queue may take much longer than the rest of this one.
+    while (done->fRemaining.load() > 0) {
+      if (auto job = popLocal(*self); job) {
+        job->fRun();
+      } else if (auto job = steal(self); job) {
+        job->fRun();
+      } else {
+        // The rest of the pieces are running on other workers.
+        unique_lock<mutex> lock(done->fMutex);
+        done->fCondition.wait(lock, [&done]() { return done->fRemaining.load() == 0; });
+      }
+    }
+  }
+
+  size_t queued() const {
+    return fQueued.load(std::memory_order_relaxed);
+  }
+
+  size_t running() const {
+    return fRunning.load(std::memory_order_relaxed);
+  }
+
+private:
+  // Pieces of one parallelFor call. The last one to finish wakes the caller.
+  struct Pieces {
+    std::atomic<size_t> fRemaining;
+    std::mutex fMutex;
+    std::condition_variable fCondition;
+  };
+
+  struct Running {
+    Running(TaskQueue &queue, char const *name, uint64_t flow, std::chrono::steady_clock::time_point enqueued) : fQueue(queue), fName(name), fEnqueued(enqueued) {
+      fQueue.fQueued--;
+      fQueue.fRunning++;
+      if (fQueue.fTracer && fQueue.fTracer->enabled()) {
+        fTrace = fQueue.fTracer->begin(fName, fQueue.fName, fQueue.fName);
+        if (flow != 0) {
+          fQueue.fTracer->flowEnd(fName, fQueue.fName, fQueue.fName, flow);
+        }
+      }
+    }
+
+    ~Running() {
+      if (fQueue.fTracer) {
+        fQueue.fTracer->end(fName, fQueue.fName, fQueue.fName, fTrace);
+      }
+      if (fQueue.fLatencies) {
+        fQueue.fLatencies->add(fQueue.fName, fName, std::chrono::duration<double>(std::chrono::steady_clock::now() - fEnqueued).count());
+      }
+      fQueue.fRunning--;
+    }
+
+    TaskQueue &fQueue;
+    char const *const fName;
+    std::chrono::steady_clock::time_point const fEnqueued;
+    uint64_t fTrace = 0;
+  };
+
+  void work(Worker &self) {
+    using namespace std;
+    sWorker = &self;
+    while (true) {
+      // Read before looking for a job, so that one queued after that wakes the worker up.
+      uint64_t generation = fGeneration.load();
+      if (auto job = take(self); job) {
+        job->fRun();
+        continue;
+      }
+      unique_lock<mutex> lock(fMutex);
+      if (fStop) {
+        // Nothing is left to take. Pieces still in a deque are run by the worker waiting for them.
+        break;
+      }
+      fCondition.wait(lock, [this, generation]() { return fStop || fGeneration.load() != generation; });
+    }
+    sWorker = nullptr;
+  }
+
+  std::shared_ptr<Job> take(Worker &self) {
+    // Pieces in the own deque belong to a task already running, but a High priority task is not kept waiting for them.
+    if (auto job = popGlobal(TaskPriority::High); job) {
+      return job;
+    }
+    if (auto job = popLocal(self); job) {
+      return job;
+    }
+    if (auto job = popGlobal(TaskPriority::Low); job) {
+      return job;
+    }
+    return steal(&self);
+  }
+
+  // Takes the oldest task with a priority of lowest or higher.
+  std::shared_ptr<Job> popGlobal(TaskPriority lowest) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (int p = 0; p <= (int)lowest; p++) {
+      auto &queue = fQueues[p];
+      if (!queue.empty()) {
+        auto job = queue.front();
+        queue.pop_front();
+        return job;
+      }
+    }
+    return nullptr;
+  }
+
+  // The newest piece is the most likely to be in cache.
+  std::shared_ptr<Job> popLocal(Worker &self) {
+    std::lock_guard<std::mutex> lock(self.fMutex);
+    if (self.fJobs.empty()) {
+      return nullptr;
+    }
+    auto job = self.fJobs.back();
+    self.fJobs.pop_back();
+    return job;
+  }
+
+  std::shared_ptr<Job> steal(Worker *self) {
+    size_t count = fWorkers.size();
+    size_t start = self ? self->fIndex + 1 : 0;
+    for (size_t i = 0; i < count; i++) {
+      Worker &victim = *fWorkers[(start + i) % count];
+      if (&victim == self) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(victim.fMutex);
+      if (!victim.fJobs.empty()) {
+        auto job = victim.fJobs.front();
+        victim.fJobs.pop_front();
+        return job;
+      }
+    }
+    return nullptr;
+  }
+
+  void reprioritize(std::shared_ptr<Job> const &job, TaskPriority priority) {
+    using namespace std;
+    lock_guard<mutex> lock(fMutex);
+    auto &from = fQueues[(int)job->fPriority.load()];
+    auto found = find(from.begin(), from.end(), job);
+    if (found == from.end()) {
+      return;
+    }
+    from.erase(found);
+    fQueues[(int)priority].push_back(job);
+    job->fPriority = priority;
+  }
+
+  static inline thread_local Worker *sWorker = nullptr;
+
+  char const *const fName;
+  Tracer *fTracer = nullptr;
+  TaskLatencies *fLatencies = nullptr;
+  std::atomic<size_t> fQueued = 0;
+  std::atomic<size_t> fRunning = 0;
+
+  std::mutex fMutex;
+  std::condition_variable fCondition;
+  std::array<std::deque<std::shared_ptr<Job>>, kPriorityCount> fQueues;
+  // Increased with fMutex held whenever tasks or pieces have been queued, so that a worker which found nothing to take
+  // can wait for a change without missing one.
+  std::atomic<uint64_t> fGeneration = 0;
+  bool fStop = false;
+  std::vector<std::unique_ptr<Worker>> fWorkers;
+};
+
+} // namespace nbte
@@ -2,6 +2,8 @@
 
 namespace nbte {
 
+// Icons are packed into the font atlas as custom rects, so tree rows made of icons and text are drawn from a single texture
+// and ImGui can merge them into a few draw commands.
 struct TextureSet {
   std::optional<Texture> fIconDocumentAttributeB;
   std::optional<Texture> fIconDocumentAttributeD;
@@ -18,22 +20,72 @@ struct TextureSet {
   std::optional<Texture> fIconDocumentExclamation;
   std::optional<Texture> fIconEditCode;
 
-  void loadTextures(void *device) {
-    fIconDocumentAttributeB = LoadTexture("document_attribute_b.png", device);
-    fIconDocumentAttributeD = LoadTexture("document_attribute_d.png", device);
-    fIconDocumentAttributeF = LoadTexture("document_attribute_f.png", device);
-    fIconDocumentAttributeI = LoadTexture("document_attribute_i.png", device);
-    fIconDocumentAttributeL = LoadTexture("document_attribute_l.png", device);
-    fIconDocumentAttributeS = LoadTexture("document_attribute_s.png", device);
-    fIconEditSmallCaps = LoadTexture("edit_small_caps.png", device);
-    fIconBox = LoadTexture("box.png", device);
-    fIconEditList = LoadTexture("edit_list.png", device);
-    fIconFolder = LoadTexture("folder.png", device);
-    fIconBlock = LoadTexture("block.png", device);
-    fIconDocument = LoadTexture("document.png", device);
-    fIconDocumentExclamation = LoadTexture("document_exclamation.png", device);
-    fIconEditCode = LoadTexture("edit_code.png", device);
+  void loadTextures() {
+    fImages.clear();
+    load(&TextureSet::fIconDocumentAttributeB, "document_attribute_b.png");
+    load(&TextureSet::fIconDocumentAttributeD, "document_attribute_d.png");
+    load(&TextureSet::fIconDocumentAttributeF, "document_attribute_f.png");
+    load(&TextureSet::fIconDocumentAttributeI, "document_attribute_i.png");
+    load(&TextureSet::fIconDocumentAttributeL, "document_attribute_l.png");
+    load(&TextureSet::fIconDocumentAttributeS, "document_attribute_s.png");
+    load(&TextureSet::fIconEditSmallCaps, "edit_small_caps.png");
+    load(&TextureSet::fIconBox, "box.png");
+    load(&TextureSet::fIconEditList, "edit_list.png");
+    load(&TextureSet::fIconFolder, "folder.png");
+    load(&TextureSet::fIconBlock, "block.png");
+    load(&TextureSet::fIconDocument, "document.png");
+    load(&TextureSet::fIconDocumentExclamation, "document_exclamation.png");
+    load(&TextureSet::fIconEditCode, "edit_code.png");
   }
+
+  // Must be called before ImFontAtlas::Build.
+  void addCustomRects(ImFontAtlas &atlas) {
+    for (auto &entry : fImages) {
+      entry.fRect = atlas.AddCustomRectRegular(entry.fImage.fWidth, entry.fImage.fHeight);
+    }
+  }
+
+  // Must be called after ImFontAtlas::Build, and before the renderer backend uploads the atlas texture.
+  void copyCustomRects(ImFontAtlas &atlas) {
+    unsigned char *pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    atlas.GetTexDataAsRGBA32(&pixels, &width, &height);
+    for (auto const &entry : fImages) {
+      ImFontAtlasCustomRect const *rect = atlas.GetCustomRectByIndex(entry.fRect);
+      if (!rect || !rect->IsPacked()) {
+        this->*entry.fTarget = std::nullopt;
+        continue;
+      }
+      size_t stride = (size_t)entry.fImage.fWidth * 4;
+      for (int y = 0; y < entry.fImage.fHeight; y++) {
+        memcpy(pixels + ((size_t)(rect->Y + y) * width + rect->X) * 4, entry.fImage.fPixels.data() + y * stride, stride);
+      }
+      Texture texture;
+      atlas.CalcCustomRectUV(rect, &texture.fUv0, &texture.fUv1);
+      texture.fWidth = entry.fImage.fWidth;
+      texture.fHeight = entry.fImage.fHeight;
+      this->*entry.fTarget = texture;
+    }
+  }
+
+private:
+  void load(std::optional<Texture> TextureSet::*target, char const *name) {
+    this->*target = std::nullopt;
+    if (auto image = LoadRgbaImage(name); image) {
+      Entry entry;
+      entry.fTarget = target;
+      entry.fImage = std::move(*image);
+      fImages.push_back(std::move(entry));
+    }
+  }
+
+  struct Entry {
+    std::optional<Texture> TextureSet::*fTarget;
+    Image fImage;
+    int fRect = -1;
+  };
+  std::vector<Entry> fImages;
 };
 
 } // namespace nbte
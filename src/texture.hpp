@@ -2,16 +2,12 @@
 
 namespace nbte {
 
+// A sub-rectangle of the font atlas texture, see TextureSet.
 struct Texture {
-#if defined(__APPLE__)
-  id<MTLTexture> fTexture;
-#else
-  ImTextureID fTexture;
-#endif
+  ImVec2 fUv0;
+  ImVec2 fUv1;
   int fWidth;
   int fHeight;
 };
 
-std::optional<Texture> LoadTexture(char const *name, void *devicePtr);
-
 } // namespace nbte
@@ -0,0 +1,180 @@
+#pragma once
+
+namespace nbte {
+
+// Records Chrome trace events (https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU).
+// Names, categories and thread names must be string literals, the tracer keeps pointers to them. The end of a slice is
+// recorded whenever its begin was, even when tracing has stopped or is full in between, so that no slice is left open.
+class Tracer {
+public:
+  static constexpr size_t kMaxEvents = 4 * 1024 * 1024;
+
+  class Scope {
+  public:
+    Scope(Tracer &tracer, char const *name, char const *category, char const *thread) : fTracer(tracer), fName(name), fCategory(category), fThread(thread) {
+      if (fTracer.enabled()) {
+        fTrace = fTracer.begin(fName, fCategory, fThread);
+      }
+    }
+
+    Scope(Scope const &) = delete;
+    Scope &operator=(Scope const &) = delete;
+
+    ~Scope() {
+      fTracer.end(fName, fCategory, fThread, fTrace);
+    }
+
+  private:
+    Tracer &fTracer;
+    char const *const fName;
+    char const *const fCategory;
+    char const *const fThread;
+    uint64_t fTrace = 0;
+  };
+
+  bool enabled() const {
+    return fEnabled.load(std::memory_order_relaxed);
+  }
+
+  void start() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fEvents.clear();
+    fThreads.clear();
+    fOrigin = std::chrono::steady_clock::now();
+    fTrace++;
+    fEnabled.store(true, std::memory_order_relaxed);
+  }
+
+  void stop() {
+    fEnabled.store(false, std::memory_order_relaxed);
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fEvents.size();
+  }
+
+  // Returns the trace the begin was recorded in, or 0 when it wasn't. It is passed to end.
+  uint64_t begin(char const *name, char const *category, char const *thread) {
+    return add('B', name, category, thread);
+  }
+
+  // Does nothing when trace is 0, or tracing has started again since.
+  void end(char const *name, char const *category, char const *thread, uint64_t trace) {
+    if (trace != 0) {
+      add('E', name, category, thread, 0, trace);
+    }
+  }
+
+  void instant(char const *name, char const *category, char const *thread) {
+    add('i', name, category, thread);
+  }
+
+  // Flow events draw an arrow from the slice enclosing flowStart to the slice beginning right after flowEnd.
+  void flowStart(char const *name, char const *category, char const *thread, uint64_t id) {
+    add('s', name, category, thread, id);
+  }
+
+  void flowEnd(char const *name, char const *category, char const *thread, uint64_t id) {
+    add('f', name, category, thread, id);
+  }
+
+  uint64_t nextId() {
+    return fNextId.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  bool write(Path const &file) {
+    using namespace std;
+    lock_guard<mutex> lock(fMutex);
+    ofstream stream(file, ios::binary);
+    if (!stream) {
+      return false;
+    }
+    stream.setf(ios::fixed);
+    stream.precision(3);
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (auto const &it : fThreads) {
+      if (!first) {
+        stream << ",\n";
+      }
+      first = false;
+      stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << it.second.first << ",\"args\":{\"name\":\"" << it.second.second << " #" << it.second.first << "\"}}";
+    }
+    for (auto const &e : fEvents) {
+      if (!first) {
+        stream << ",\n";
+      }
+      first = false;
+      stream << "{\"name\":\"" << e.fName << "\",\"cat\":\"" << e.fCategory << "\",\"ph\":\"" << e.fPhase << "\",\"pid\":1,\"tid\":" << e.fThread << ",\"ts\":" << e.fTimestamp;
+      switch (e.fPhase) {
+      case 'i':
+        stream << ",\"s\":\"t\"";
+        break;
+      case 's':
+        stream << ",\"id\":" << e.fId;
+        break;
+      case 'f':
+        stream << ",\"id\":" << e.fId << ",\"bp\":\"e\"";
+        break;
+      }
+      stream << "}";
+    }
+    stream << "\n]}\n";
+    return stream.good();
+  }
+
+private:
+  struct Event {
+    char const *fName;
+    char const *fCategory;
+    double fTimestamp;
+    uint64_t fId;
+    uint32_t fThread;
+    char fPhase;
+  };
+
+  // An end of trace is recorded as long as the trace is the current one, beyond kMaxEvents if needed. Returns the trace
+  // the event was recorded in, or 0.
+  uint64_t add(char phase, char const *name, char const *category, char const *thread, uint64_t id = 0, uint64_t trace = 0) {
+    using namespace std;
+    if (trace == 0 && !enabled()) {
+      return 0;
+    }
+    auto now = chrono::steady_clock::now();
+    lock_guard<mutex> lock(fMutex);
+    if (trace != 0) {
+      if (trace != fTrace) {
+        return 0;
+      }
+    } else if (fEvents.size() >= kMaxEvents) {
+      fEnabled.store(false, memory_order_relaxed);
+      return 0;
+    }
+    auto found = fThreads.find(this_thread::get_id());
+    if (found == fThreads.end()) {
+      uint32_t tid = (uint32_t)fThreads.size() + 1;
+      found = fThreads.insert(make_pair(this_thread::get_id(), make_pair(tid, thread))).first;
+    }
+    Event e;
+    e.fName = name;
+    e.fCategory = category;
+    e.fTimestamp = chrono::duration<double, micro>(now - fOrigin).count();
+    e.fId = id;
+    e.fThread = found->second.first;
+    e.fPhase = phase;
+    fEvents.push_back(e);
+    return fTrace;
+  }
+
+  std::atomic<bool> fEnabled = false;
+  std::atomic<uint64_t> fNextId = 1;
+  std::mutex fMutex;
+  std::vector<Event> fEvents;
+  std::map<std::thread::id, std::pair<uint32_t, char const *>> fThreads;
+  std::chrono::steady_clock::time_point fOrigin;
+  // Counts the calls to start.
+  uint64_t fTrace = 0;
+};
+
+} // namespace nbte